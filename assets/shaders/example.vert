@@ -2,13 +2,15 @@
 
 layout(location = 0) in vec3 position;
 
-uniform mat4 Projection;
-uniform mat4 ViewMatrix;
+#include "include/frame_data.glsl"
+
 uniform mat4 ModelMatrix;
 
+#include "include/vertex_decode.glsl"
+
 out vec3 color;
 
 void main() {
-  gl_Position = Projection * ViewMatrix * ModelMatrix * vec4(position, 1.0);
+  gl_Position = frame.projection * frame.view * ModelMatrix * vec4(decodePosition(position), 1.0);
   color = vec3(1.0, 0.0, 1.0);
 }
@@ -3,13 +3,19 @@
 in vec2 TexCoord;                       // qIۦ⾹ǻz
 in vec3 FragPos;                        // @ɧ
 in vec3 Normal;                         // kVq
+in vec4 Tangent;                        // world space tangent, w bitangent sign
 
 out vec4 FragColor;                     // XC
 
 uniform sampler2D diffuseTexture;       // ӪC⯾z
+uniform sampler2D normalTexture;        // tangent space normal map
 uniform vec3 lightPos;                  // m
-uniform vec3 viewPos;                   // ۾m
-uniform vec3 lightColor;                // C
+
+#include "include/frame_data.glsl"
+
+#ifdef SHADOWS
+#include "include/shadows.glsl"
+#endif
 
 void main() {
     // zC
@@ -17,22 +23,31 @@ void main() {
 
     // p
     vec3 normal = normalize(Normal);
+    vec3 tangent = normalize(Tangent.xyz - normal * dot(normal, Tangent.xyz));
+    vec3 bitangent = cross(normal, tangent) * Tangent.w;
+    // Only xy is trusted so two channel (BC5) maps work, z is rebuilt
+    vec3 mapped = vec3(texture(normalTexture, TexCoord).rg * 2.0 - 1.0, 0.0);
+    mapped.z = sqrt(max(1.0 - dot(mapped.xy, mapped.xy), 0.0));
+    normal = normalize(mat3(tangent, bitangent, normal) * mapped);
     vec3 lightDir = normalize(lightPos - FragPos);
 
     // Ϯg
     float diff = max(dot(normal, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * frame.sunColor.rgb;
 
     // V
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(frame.viewPosition.xyz - FragPos);
 
     // Ϯg
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = spec * lightColor;
+    vec3 specular = spec * frame.sunColor.rgb;
 
     // XCMzC
     vec3 resultColor = (diffuse + specular) * textureColor;
+#ifdef SHADOWS
+    resultColor *= mix(0.6, 1.0, sunVisibility(FragPos));
+#endif
 
     // ]mqC
     FragColor = vec4(resultColor, 1.0);
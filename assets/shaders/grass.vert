@@ -3,30 +3,36 @@
 layout(location = 0) in vec3 position;    // Im
 layout(location = 1) in vec3 normal;      // kVq
 layout(location = 2) in vec2 texcoord;    // z
+layout(location = 3) in vec4 tangent;     // xyz tangent, w bitangent sign
 
 out vec2 TexCoord;                       // ǻqۦ⾹z
 out vec3 FragPos;                        // @ɧ
 out vec3 Normal;                         // kVq
+out vec4 Tangent;                        // world space tangent, w bitangent sign
 
 uniform mat4 ModelMatrix;                // ҫx}
-uniform mat4 ViewMatrix;                 // ϯx}
-uniform mat4 Projection;                 // vx}
-uniform float time;                      // ʵeɶ
+uniform mat3 NormalMatrix;               // inverse transpose of ModelMatrix
+
+#include "include/frame_data.glsl"
+
+#include "include/vertex_decode.glsl"
 
 void main() {
     TexCoord = texcoord;
 
     // jĪGGb x M z bWL\
-    vec3 displacedPosition = position;
-    displacedPosition.x += 0.05 * sin(5.0 * position.y + time); // H۰ܤ
-    displacedPosition.z += 0.05 * cos(5.0 * position.y + time);
+    vec3 localPos = decodePosition(position);
+    vec3 displacedPosition = localPos;
+    displacedPosition.x += 0.05 * sin(5.0 * localPos.y + frame.time); // H۰ܤ
+    displacedPosition.z += 0.05 * cos(5.0 * localPos.y + frame.time);
 
     // @ɧ
     FragPos = vec3(ModelMatrix * vec4(displacedPosition, 1.0));
 
     // kVq
-    Normal = mat3(transpose(inverse(ModelMatrix))) * normal;
+    Normal = NormalMatrix * decodeNormal(normal);
+    Tangent = vec4(mat3(ModelMatrix) * tangent.xyz, tangent.w);
 
     // pŪŶm
-    gl_Position = Projection * ViewMatrix * vec4(FragPos, 1.0);
+    gl_Position = frame.projection * frame.view * vec4(FragPos, 1.0);
 }
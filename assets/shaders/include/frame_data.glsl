@@ -0,0 +1,15 @@
+// Per frame values shared by every program, see frame_uniforms.h
+#ifndef FRAME_DATA_GLSL
+#define FRAME_DATA_GLSL
+
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPosition;
+    vec4 sunDirection;
+    vec4 sunColor;
+    vec4 ambientColor;
+    float time;
+} frame;
+
+#endif
@@ -0,0 +1,33 @@
+// Sun shadows, see shadow_cascades.h
+#ifndef SHADOWS_GLSL
+#define SHADOWS_GLSL
+
+#include "frame_data.glsl"
+
+uniform sampler2DArrayShadow ShadowMap;
+uniform mat4 ShadowMatrices[3];
+// View distances where cascades 0 and 1 end
+uniform vec2 ShadowSplits;
+uniform bool ShadowEnabled;
+
+// Fraction of the sun reaching p, from 2x2 filtered taps of the nearest cascade covering it
+float sunVisibility(vec3 p) {
+    if (!ShadowEnabled) return 1.0;
+    float depth = -(frame.view * vec4(p, 1.0)).z;
+    int first = depth < ShadowSplits.x ? 0 : (depth < ShadowSplits.y ? 1 : 2);
+    vec2 texel = 1.0 / vec2(textureSize(ShadowMap, 0).xy);
+    for (int i = first; i < 3; i++) {
+        vec3 coord = (ShadowMatrices[i] * vec4(p, 1.0)).xyz * 0.5 + 0.5;
+        // Outside this cascade, try the next larger one
+        if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0)))) continue;
+        float lit = 0.0;
+        for (int t = 0; t < 4; t++) {
+            vec2 offset = (vec2(t & 1, t >> 1) - 0.5) * texel;
+            lit += texture(ShadowMap, vec4(coord.xy + offset, float(i), coord.z));
+        }
+        return lit * 0.25;
+    }
+    return 1.0;
+}
+
+#endif
@@ -0,0 +1,20 @@
+// Decode quantized vertex formats (see vertex_format.h)
+#ifndef VERTEX_DECODE_GLSL
+#define VERTEX_DECODE_GLSL
+
+uniform vec3 PositionScale;
+uniform vec3 PositionOffset;
+uniform bool OctNormals;
+
+vec3 decodePosition(vec3 p) {
+    return p * PositionScale + PositionOffset;
+}
+
+vec3 decodeNormal(vec3 n) {
+    if (!OctNormals) return n;
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+#endif
@@ -8,7 +8,7 @@ out vec4 color;
 
 uniform sampler2D ourTexture;
 
-uniform vec3 viewPos;
+#include "include/frame_data.glsl"
 
 struct Material {
     vec3 ambient;
@@ -56,7 +56,7 @@ uniform Spotlight sl;
 void main() {
     
     vec3 norm = normalize(Normal);
-	vec3 viewDir = normalize(viewPos - FragPos);
+	vec3 viewDir = normalize(frame.viewPosition.xyz - FragPos);
     vec3 result = vec3(0.0);
     // ambient= La * Ka
     // diffuse = Ld * Kd * max(dot(N, L), 0)
@@ -4,10 +4,12 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoord;
 
-uniform mat4 Projection;
-uniform mat4 ViewMatrix;
+#include "include/frame_data.glsl"
+
 uniform mat4 ModelMatrix;
-uniform mat4 TIModelMatrix;
+uniform mat3 NormalMatrix;
+
+#include "include/vertex_decode.glsl"
 
 out vec2 TexCoord;
 // Normal of vertex in world space
@@ -36,13 +38,13 @@ out vec3 FragPos;
 //              in light.cpp rather than in shaders
 
 void main() {
-	
+	vec3 localPos = decodePosition(position);
 	// Calculate normal in world space
-	Normal = normalize(mat3(TIModelMatrix) * normal);
+	Normal = normalize(NormalMatrix * decodeNormal(normal));
 	// Calculate position in world space
-	FragPos = vec3(ModelMatrix * vec4(position, 1.0));
+	FragPos = vec3(ModelMatrix * vec4(localPos, 1.0));
 	// Calculate gl_Position
-	gl_Position = Projection * ViewMatrix * ModelMatrix * vec4(position, 1.0);
+	gl_Position = frame.projection * frame.view * ModelMatrix * vec4(localPos, 1.0);
 	// Pass texCoord to fragment shader
 	TexCoord = texCoord;
 	
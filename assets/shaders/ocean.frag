@@ -7,10 +7,9 @@ in vec2 TexCoord;
 uniform sampler2D ourTexture;
 uniform sampler2D displacementMap;
 uniform vec3 lightColor;
-uniform vec3 lightDir;
-uniform vec3 ambientColor;
 uniform vec3 waterColor;
-uniform float time;
+
+#include "include/frame_data.glsl"
 
 out vec4 FragColor;
 
@@ -20,19 +19,19 @@ float rand(vec2 co){
 
 void main() {
     vec3 perturbedNormal = normalize(Normal + vec3(
-        sin(rand(TexCoord + time)) * 0.1,
+        sin(rand(TexCoord + frame.time)) * 0.1,
         0.0,
-        cos(rand(TexCoord + time)) * 0.1));
-    vec3 lightDirNorm = normalize(lightDir) * dot(Normal, -lightDir);
+        cos(rand(TexCoord + frame.time)) * 0.1));
+    vec3 lightDirNorm = normalize(frame.sunDirection.xyz) * dot(Normal, -frame.sunDirection.xyz);
 
     float diff = max(dot(perturbedNormal, lightDirNorm), 0.0);
     vec3 diffuse = diff * lightColor;
 
-    vec3 ambient = ambientColor;
+    vec3 ambient = frame.ambientColor.rgb;
 
     vec3 lighting = (ambient * 0.5 + diffuse * 1.5) / 2;
 
-    vec3 lightPos = lightDir * 75.0;
+    vec3 lightPos = frame.sunDirection.xyz * 75.0;
     vec3 lightDist = FragPos - lightPos;
     float dist = length(lightDist);
     float attenuation = 75.0 / dist * 2;
@@ -51,7 +50,7 @@ void main() {
     vec3 textblend = mix(textureColor, blend, 0.5) * lighting;
     vec3 finalColor = mix(textblend, displacementColor, 0.4);
 
-    float lightness = (dot(Normal, lightDir) + 1) / 2 + 0.5;
+    float lightness = (dot(Normal, frame.sunDirection.xyz) + 1) / 2 + 0.5;
     finalColor = lightness * finalColor;
 
     float alpha = clamp(dot(lightDirNorm, perturbedNormal) * 0.5 + 0.5, 0.8, 0.9);
@@ -5,25 +5,29 @@ layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
 uniform mat4 ModelMatrix;
-uniform mat4 ViewMatrix;
-uniform mat4 Projection;
-uniform float time;
+// Inverse transpose of ModelMatrix, computed on the CPU
+uniform mat3 NormalMatrix;
+
+#include "include/frame_data.glsl"
+
 uniform sampler2D displacementMap;
 uniform float amplitude;
 
+#include "include/vertex_decode.glsl"
+
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
 
 void main() {
-    vec3 modifiedPos = aPos;
+    vec3 modifiedPos = decodePosition(aPos);
     float height = texture(displacementMap, aTexCoord).r * amplitude;
 
     modifiedPos.y += height;
 
     FragPos = vec3(ModelMatrix * vec4(modifiedPos, 1.0));
-    Normal = mat3(transpose(inverse(ModelMatrix))) * aNormal;
+    Normal = NormalMatrix * decodeNormal(aNormal);
     TexCoord = aTexCoord;
 
-    gl_Position = Projection * ViewMatrix * vec4(FragPos, 1.0);
+    gl_Position = frame.projection * frame.view * vec4(FragPos, 1.0);
 }
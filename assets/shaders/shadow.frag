@@ -0,0 +1,5 @@
+#version 330 core
+
+// Depth only, the shadow framebuffer has no color attachment
+void main() {
+}
@@ -0,0 +1,13 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+
+// Light view projection of the cascade being rendered, see shadow_cascades.h
+uniform mat4 LightMatrix;
+uniform mat4 ModelMatrix;
+
+#include "include/vertex_decode.glsl"
+
+void main() {
+    gl_Position = LightMatrix * ModelMatrix * vec4(decodePosition(aPos), 1.0);
+}
@@ -1,23 +1,45 @@
 #version 330 core
 
 in vec3 TexCoords;
+in vec3 WorldDirection;
 
 out vec4 FragColor;
 
 uniform samplerCube skybox;
-uniform vec3 lightDir;
-uniform vec3 lightColor;
-uniform vec3 horizonColor;
-uniform vec3 zenithColor;
+// Precomputed sky radiance, see atmosphere.h. x is the azimuth relative to
+// the sun, y the view elevation, one layer per sun elevation.
+uniform sampler2DArray skyView;
+// Fractional layer of the current sun elevation
+uniform float skyViewLayer;
 
-void main() {
-    float intensity = max(dot(normalize(TexCoords), normalize(lightDir)), 0.0);
-    intensity = pow(intensity, 1.5);
+#include "include/frame_data.glsl"
+
+const float PI = 3.14159265;
+const float kExposure = 30.0;
 
-    vec3 dynamicSkyColor = mix(horizonColor, zenithColor, TexCoords.y * 0.5 + 0.5);
+vec3 skyRadiance(vec3 direction, vec3 sunDirection) {
+    float elevation = asin(clamp(direction.y, -1.0, 1.0));
+    // Looking straight up or a sun at the zenith has no azimuth, any works there
+    vec2 view = length(direction.xz) > 1e-4 ? normalize(direction.xz) : vec2(1.0, 0.0);
+    vec2 sun = length(sunDirection.xz) > 1e-4 ? normalize(sunDirection.xz) : vec2(1.0, 0.0);
+    float azimuth = acos(clamp(dot(view, sun), -1.0, 1.0));
+    // Same horizon weighted spacing of elevations as the table
+    vec2 uv = vec2(azimuth / PI, 0.5 + 0.5 * sign(elevation) * sqrt(abs(elevation) / (0.5 * PI)));
+    float layer = floor(skyViewLayer);
+    vec3 below = texture(skyView, vec3(uv, layer)).rgb;
+    vec3 above = texture(skyView, vec3(uv, layer + 1.0)).rgb;
+    return mix(below, above, skyViewLayer - layer);
+}
 
-    dynamicSkyColor = mix(dynamicSkyColor, lightColor, intensity);
+void main() {
+    vec3 direction = normalize(WorldDirection);
+    vec3 sunDirection = normalize(frame.sunDirection.xyz);
+    vec3 radiance = skyRadiance(direction, sunDirection);
+    // Sun disk, in the color the atmosphere leaves of it
+    radiance += frame.sunColor.rgb * smoothstep(0.9997, 0.9999, dot(direction, sunDirection));
+    vec3 sky = 1.0 - exp(-radiance * kExposure);
 
+    // The cube map only adds its detail on top of the scattered light
     vec4 skyboxColor = texture(skybox, TexCoords);
-    FragColor = vec4(dynamicSkyColor * skyboxColor.rgb, skyboxColor.a);
+    FragColor = vec4(sky * mix(vec3(1.0), skyboxColor.rgb, 0.5), skyboxColor.a);
 }
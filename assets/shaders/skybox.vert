@@ -2,12 +2,18 @@
 layout(location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
+out vec3 WorldDirection;
 
+// Camera rotation only, the sky stays centered on the camera
 uniform mat4 view;
-uniform mat4 projection;
+// World to cube map directions, turns the clouds slowly
+uniform mat3 cloudRotation;
+
+#include "include/frame_data.glsl"
 
 void main() {
-    TexCoords = aPos;
-    gl_Position = projection * view * vec4(aPos, 1.0);
+    WorldDirection = aPos;
+    TexCoords = cloudRotation * aPos;
+    gl_Position = frame.projection * view * vec4(aPos, 1.0);
     gl_Position = gl_Position.xyww;
 }
\ No newline at end of file
@@ -3,58 +3,57 @@
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+in vec2 SplatCoord;
 
 out vec4 FragColor;
 
-uniform sampler2D lowTex;
-uniform sampler2D highTex;
-uniform sampler2D Water;
+// Terrain layers and their baked blend weights, one per channel (see terrain_material.h)
+uniform sampler2DArray layers;
+uniform sampler2D splatMap;
 uniform sampler2D displacementMap;
+// Drawn under the water line, never splatted
+const float kWaterLayer = 2.0;
 
-// Directional light
-uniform vec3 lightDir;
-uniform vec3 lightColor;
-uniform vec3 ambientColor;
+#include "include/frame_data.glsl"
 
+#ifdef SHADOWS
+#include "include/shadows.glsl"
+#endif
 
-void main() {
-    vec4 lowColor = texture(lowTex, TexCoords);
-    vec4 highColor = texture(highTex, TexCoords);
-    vec4 waterColor = mix(texture(Water, TexCoords), vec4(0.3f, 0.8f, 1.0f, 1.0f), 0.5f) * vec4(lightColor, 1.0f);
-    float waterlevel = FragPos.y + texture(displacementMap, TexCoords).r * 10.0f;
-
-    float height = FragPos.y;
-
-    float noise = fract(sin(dot(TexCoords.xy, vec2(12.9898, 78.233))) * 43758.5453);
-    noise = mix(-0.2, 0.2, noise);
-    height += noise;
 
-    float slopeFactor = dot(normalize(Normal), vec3(0.0, 1.0, 0.0));
-    slopeFactor = clamp(slopeFactor, 0.8, 1.5);
-
-    float mixFactor = smoothstep(0.6, 1.5, height);
-    if(height<2.5){
-        mixFactor = mixFactor * slopeFactor;
+void main() {
+    // Explicit gradients, the layer fetches sit in non-uniform branches
+    vec2 dx = dFdx(TexCoords);
+    vec2 dy = dFdy(TexCoords);
+
+    vec4 weights = texture(splatMap, SplatCoord);
+    vec4 baseColor = vec4(0.0);
+    for (int i = 0; i < 4; i++) {
+        if (weights[i] > 0.0) baseColor += textureGrad(layers, vec3(TexCoords, float(i)), dx, dy) * weights[i];
     }
-
-    vec4 baseColor = mix(lowColor, highColor, mixFactor);
+    float waterlevel = FragPos.y + texture(displacementMap, TexCoords).r * 10.0f;
 
     vec3 norm = normalize(Normal);
-    vec3 lightDirection = normalize(-lightDir);
+    vec3 lightDirection = normalize(-frame.sunDirection.xyz);
 
     float diff = max(dot(norm, lightDirection), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * frame.sunColor.rgb;
 
-    vec3 ambient = ambientColor;
+    vec3 ambient = frame.ambientColor.rgb;
 
     vec3 result = (ambient + diffuse) * baseColor.rgb;
 
     FragColor = vec4(result, baseColor.a);
 
-    float lightness = (dot(vec3(0.0, 1.0, 0.0), lightDir) + 1) / 2 + 0.5;
+    float lightness = (dot(vec3(0.0, 1.0, 0.0), frame.sunDirection.xyz) + 1) / 2 + 0.5;
     FragColor = vec4(FragColor.rgb * lightness, FragColor.a);
+#ifdef SHADOWS
+    FragColor.rgb *= mix(0.6, 1.0, sunVisibility(FragPos));
+#endif
 
     if(waterlevel<0.1){
+        vec4 water = textureGrad(layers, vec3(TexCoords, kWaterLayer), dx, dy);
+        vec4 waterColor = mix(water, vec4(0.3f, 0.8f, 1.0f, 1.0f), 0.5f) * vec4(frame.sunColor.rgb, 1.0f);
         FragColor = mix(FragColor, waterColor, 0.5);
     }
 }
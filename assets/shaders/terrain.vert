@@ -7,18 +7,28 @@ layout(location = 2) in vec2 aTexCoords;
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out vec2 SplatCoord;
 
 // Uniforms
 uniform mat4 ModelMatrix;
-uniform mat4 ViewMatrix;
-uniform mat4 Projection;
+// Inverse transpose of ModelMatrix, computed on the CPU
+uniform mat3 NormalMatrix;
+
+#include "include/frame_data.glsl"
+
+// World xz to splat map coordinates: xy scale, zw offset
+uniform vec4 SplatTransform;
+
+#include "include/vertex_decode.glsl"
 
 void main() {
-    gl_Position = Projection * ViewMatrix * ModelMatrix * vec4(aPos, 1.0);
+    vec3 localPos = decodePosition(aPos);
+    gl_Position = frame.projection * frame.view * ModelMatrix * vec4(localPos, 1.0);
 
-    FragPos = vec3(ModelMatrix * vec4(aPos, 1.0));
+    FragPos = vec3(ModelMatrix * vec4(localPos, 1.0));
 
-    Normal = mat3(transpose(inverse(ModelMatrix))) * aNormal;
+    Normal = NormalMatrix * decodeNormal(aNormal);
 
     TexCoords = aTexCoords;
+    SplatCoord = FragPos.xz * SplatTransform.xy + SplatTransform.zw;
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+#include <glad/gl.h>
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utils.h"
+
+// Earth like atmosphere, lengths in kilometers and coefficients per kilometer
+struct AtmosphereParameters {
+  float groundRadius = 6360.0f;
+  float topRadius = 6460.0f;
+  glm::vec3 rayleighScattering = glm::vec3(5.802e-3f, 13.558e-3f, 33.1e-3f);
+  float rayleighScaleHeight = 8.0f;
+  float mieScattering = 3.996e-3f;
+  float mieExtinction = 4.440e-3f;
+  float mieScaleHeight = 1.2f;
+  // Henyey-Greenstein asymmetry of the Mie phase function
+  float mieAnisotropy = 0.8f;
+  // Ozone absorbs in a layer peaking at ozoneCenter, falling to 0 at +-ozoneHalfWidth
+  glm::vec3 ozoneAbsorption = glm::vec3(0.650e-3f, 1.881e-3f, 0.085e-3f);
+  float ozoneCenter = 25.0f;
+  float ozoneHalfWidth = 15.0f;
+  // Height of the viewer above the ground
+  float viewerHeight = 0.2f;
+};
+
+// Sun and ambient light reaching the ground for one sun direction
+struct AtmosphereLight {
+  glm::vec3 sunColor;
+  glm::vec3 ambientColor;
+};
+
+// Precomputed single scattering sky. At startup the transmittance of the
+// atmosphere and the sky seen from the viewer for a range of sun elevations
+// are integrated on the CPU in parallel, or read back from a cache file keyed
+// by the parameters. The sky is then a texture fetch for the skybox, and sun
+// and ambient colors a table lookup for the FrameData block.
+class Atmosphere {
+ public:
+  DELETE_COPY(Atmosphere)
+  DELETE_MOVE(Atmosphere)
+  // Transmittance table: heights x cosines of the zenith angle
+  static constexpr int kTransmittanceHeights = 32;
+  static constexpr int kTransmittanceAngles = 256;
+  // Sky view table: relative azimuth x view elevation x sun elevation
+  static constexpr int kSkyAzimuths = 64;
+  static constexpr int kSkyElevations = 64;
+  static constexpr int kSunElevations = 32;
+  // Sun elevations covered by the sky view table, in degrees
+  static constexpr float kMinSunElevation = -15.0f;
+  static constexpr float kMaxSunElevation = 90.0f;
+
+  explicit Atmosphere(const AtmosphereParameters& parameters = AtmosphereParameters());
+  ~Atmosphere();
+
+  // Load the tables from cacheDirectory or compute them in the background
+  void start(const std::string& cacheDirectory);
+  // Wait for start and upload the sky view table, call on the GL thread
+  void finish();
+
+  // Sun color and sky irradiance for a world space direction towards the sun
+  AtmosphereLight light(const glm::vec3& sunDirection) const;
+  // Sky view table as a 2D array texture, one layer per sun elevation
+  GLuint getSkyViewTexture() const { return skyViewTexture; }
+  // Fractional layer of getSkyViewTexture for a direction towards the sun
+  float skyViewLayer(const glm::vec3& sunDirection) const;
+
+ private:
+  // Fraction of light left after the path from radius r to the top at cosine mu
+  glm::vec3 transmittance(float r, float mu) const;
+  glm::vec3 integrateTransmittance(float r, float mu) const;
+  // Radiance reaching the viewer from direction (elevation, relative azimuth)
+  glm::vec3 integrateSky(float elevation, float azimuth, const glm::vec3& sunDirection) const;
+  void compute();
+  void computeSkyLayer(int layer);
+  bool loadCache(const std::string& path);
+  void saveCache(const std::string& path) const;
+  std::string cacheKey() const;
+
+  AtmosphereParameters parameters;
+  std::vector<glm::vec3> transmittanceTable;
+  std::vector<glm::vec3> skyViewTable;
+  // Sky irradiance of every sun elevation layer, on a horizontal surface
+  std::vector<glm::vec3> irradianceTable;
+  std::future<void> pending;
+  GLuint skyViewTexture = 0;
+};
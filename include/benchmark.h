@@ -0,0 +1,88 @@
+#pragma once
+#include <glad/gl.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "render_target.h"
+#include "utils.h"
+
+// Command line of a benchmark run, e.g.
+//   hw2 --benchmark --frames 600 --camera path.txt --size 1920x1080 --checksums out --checksum-every 60
+struct BenchmarkOptions {
+  bool enabled = false;
+  int frames = 600;
+  // Simulated seconds per frame, so animation does not depend on how fast frames render
+  double timestep = 1.0 / 60.0;
+  int width = 1280;
+  int height = 720;
+  // Empty orbits the island once over the run
+  std::string cameraPath;
+  std::string statsPath = "benchmark.json";
+  // Directory for checksum images, empty writes none
+  std::string checksumDir;
+  // Checksum every Nth frame, 0 for none
+  int checksumEvery = 0;
+  // Seed of the scene layout so runs place the plants identically
+  unsigned int seed = 1;
+
+  // @return false on a malformed command line, after printing why
+  bool parse(int argc, char** argv);
+};
+
+// Camera keyframes, one per line as "time px py pz tx ty tz" where p is the
+// camera position and t the point it looks at. '#' starts a comment.
+class CameraPath {
+ public:
+  bool load(const std::string& filename);
+  bool empty() const { return keys.empty(); }
+  // Linear between the neighbouring keys, clamped to the first and last
+  void sample(float time, glm::vec3& position, glm::vec3& target) const;
+
+ private:
+  struct Key {
+    float time;
+    glm::vec3 position;
+    glm::vec3 target;
+  };
+  std::vector<Key> keys;
+};
+
+// Renders a fixed number of frames into an offscreen framebuffer with a fixed
+// timestep, following a scripted camera, and records how long each one took.
+class Benchmark {
+ public:
+  DELETE_COPY(Benchmark)
+  DELETE_MOVE(Benchmark)
+  explicit Benchmark(const BenchmarkOptions& options);
+
+  // Create the framebuffer and load the camera path, @return false on failure
+  bool initialize();
+  bool finished() const { return frame >= options.frames; }
+  float getAspectRatio() const { return (float)options.width / options.height; }
+  // Where the frames end up, scenes rendered at a lower resolution are scaled onto it
+  const RenderTarget& getTarget() const { return target; }
+
+  // Pose the camera for simulated time seconds
+  void beginFrame(Camera& camera, float time);
+  // Wait for the GPU, record the frame time and checksum the image if due
+  void endFrame();
+  // Frame time statistics and checksums as JSON, @return false on failure
+  bool writeStats() const;
+
+ private:
+  uint64_t checksumFrame(const std::string& imagePath);
+
+  BenchmarkOptions options;
+  CameraPath path;
+  RenderTarget target;
+  int frame = 0;
+  double frameStart = 0.0;
+  std::vector<double> frameMs;
+  std::vector<std::pair<int, uint64_t>> checksums;
+  std::vector<uint8_t> pixels;
+};
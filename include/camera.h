@@ -11,6 +11,8 @@ class Camera {
   void move(GLFWwindow* window);
   void updateViewMatrix();
   void updateProjectionMatrix(float aspectRatio);
+  // Place the camera at position looking at target, keeping the world up
+  void setPose(const glm::vec3& _position, const glm::vec3& target);
 
   const float* getProjectionMatrix() const { return glm::value_ptr(projectionMatrix); }
   const float* getViewMatrix() const { return glm::value_ptr(viewMatrix); }
@@ -6,8 +6,22 @@
 #include <glm/vec3.hpp>
 
 #include "model.h"
+#include "atmosphere.h"
 #include "camera.h"
+#include "frame_clock.h"
+#include "frame_uniforms.h"
+#include "geometry_arena.h"
+#include "occlusion_culler.h"
 #include "program.h"
+#include "program_cache.h"
+#include "quality_governor.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "shadow_cascades.h"
+#include "terrain_material.h"
+#include "texture_cache.h"
+#include "texture_loader.h"
+#include "texture_streamer.h"
 
 extern GLuint displacementMap;
 extern const int oceanWidth;
@@ -21,11 +35,24 @@ class Context {
   int terrainProgramIndex = 1;
   int OceanProgramIndex = 2;
   int plantsProgramIndex = 3;
+  // Index of models in Context::models, the terrain is split into chunks
+  int oceanModelIndex = 0;
+  int plantsModelIndex = 1;
+  int terrainModelBegin = 2;
+  int terrainModelCount = 0;
+  // Largest screen space error (in pixels) allowed when picking a LOD
+  float lodErrorThreshold = 1.0f;
+  // Fraction of the plants drawn, thinned evenly
+  float plantDensity = 1.0f;
+  // Height in pixels of what the scene is rendered into, for screen space errors
+  int renderHeight = 720;
 
  public:
+  // Owned, freed by main on exit
   std::vector<Program* > programs;
   std::vector<Model* > models;
-  std::vector<Object* > objects;
+  // Objects drawing the models above
+  Scene scene{models};
 
  public:
   // Parameter of lights use in light shader (TODO#2)
@@ -53,4 +80,30 @@ class Context {
  public:
   Camera *camera = 0;
   GLFWwindow *window = 0;
+  // Shared vertex and index storage of every model
+  GeometryArena *geometryArena = 0;
+  // Decodes and uploads every texture in the background
+  TextureLoader *textureLoader = 0;
+  // Shares textures loaded from the same file, use this instead of textureLoader
+  TextureCache *textureCache = 0;
+  // Streams mip levels of large textures by distance, fed by the draw loops
+  TextureStreamer *textureStreamer = 0;
+  // Layer array and baked splat map of the island chunks
+  TerrainMaterial *terrainMaterial = 0;
+  // Scales the knobs above to keep the frame time in budget
+  QualityGovernor *qualityGovernor = 0;
+  // Linked programs kept on disk between runs, used by Program::link
+  ProgramCache *programCache = 0;
+  // Sky, sun and ambient colors for a sun direction
+  Atmosphere *atmosphere = 0;
+  // Time snapshot of the current frame, read instead of glfwGetTime
+  FrameClock *frameClock = 0;
+  // Camera and sun of the current frame, read by every program through its FrameData block
+  FrameUniforms *frameUniforms = 0;
+  // Sorted draws of the frame, filled and executed by LightProgram
+  RenderQueue *renderQueue = 0;
+  // Depth of the terrain on the CPU, LightProgram skips what it hides
+  OcclusionCuller *occlusionCuller = 0;
+  // Sun shadow maps, rendered by ShadowProgram and sampled by the terrain and plants
+  ShadowCascades *shadowCascades = 0;
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include "utils.h"
+
+// Snapshot of the clock taken once at the start of a frame. Every system reads
+// this instead of sampling glfwGetTime, so they all agree on the time.
+struct FrameTime {
+  // Frames ticked so far, 0 for the first one
+  uint64_t frame = 0;
+  // Simulated seconds at the last fixed step
+  double simulationTime = 0.0;
+  // Simulated seconds to render, simulationTime plus alpha fixed steps
+  double time = 0.0;
+  // Simulated seconds since the previous frame, 0 while paused
+  double deltaTime = 0.0;
+  // Wall clock seconds since the previous frame, unaffected by pause and scale
+  double realDeltaTime = 0.0;
+  // Fixed steps to simulate this frame
+  int steps = 0;
+  // How far time is between the last fixed step and the next one, in [0, 1)
+  float alpha = 0.0f;
+};
+
+// Turns wall clock time into simulated time. Simulation advances in fixed
+// steps from an accumulator, so its rate does not depend on the frame rate,
+// and rendering interpolates between steps with alpha. Time can be paused,
+// scaled and moved. Time is kept as integer nanoseconds so a fixed delta per
+// frame, as in benchmark runs, always gives the same number of steps.
+class FrameClock {
+ public:
+  DELETE_COPY(FrameClock)
+  DELETE_MOVE(FrameClock)
+  // Longest frame accounted for, longer ones (breakpoints, loading) are
+  // clamped instead of simulating many steps at once
+  static constexpr double kMaxFrameDelta = 0.25;
+
+  explicit FrameClock(double fixedStep = 1.0 / 60.0);
+
+  // Advance by realDeltaTime wall clock seconds and take the snapshot of the frame
+  void tick(double realDeltaTime);
+  const FrameTime& now() const { return snapshot; }
+  double getFixedStep() const { return fixedStepNs * 1e-9; }
+
+  void setPaused(bool paused) { this->paused = paused; }
+  bool isPaused() const { return paused; }
+  // Simulated seconds per wall clock second
+  void setScale(double scale) { this->scale = scale < 0.0 ? 0.0 : scale; }
+  double getScale() const { return scale; }
+  // Jump to simulated time seconds, taking effect at the next tick
+  void seek(double seconds);
+
+ private:
+  int64_t fixedStepNs;
+  int64_t simulationNs = 0;
+  int64_t accumulatorNs = 0;
+  uint64_t ticks = 0;
+  double scale = 1.0;
+  bool paused = false;
+  FrameTime snapshot;
+};
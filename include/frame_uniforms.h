@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include "utils.h"
+
+// CPU side of the std140 "FrameData" block the shaders declare. Only vec4 and
+// mat4 members, so the C++ layout already matches std140.
+struct FrameData {
+  glm::mat4 projection;
+  glm::mat4 view;
+  // xyz camera position
+  glm::vec4 viewPosition;
+  // xyz direction of the sun as the lighting shaders expect it, y is its height
+  glm::vec4 sunDirection;
+  glm::vec4 sunColor;
+  glm::vec4 ambientColor;
+  // Simulated seconds, FrameTime::time of the frame
+  float time;
+  float padding[3];
+};
+static_assert(sizeof(FrameData) == 208, "FrameData must match the std140 layout of the shader block");
+
+// Uniform buffer holding the camera and sun of the frame. It is written once
+// per frame and every program reads it through its FrameData block, so no
+// program sets those uniforms itself.
+class FrameUniforms {
+ public:
+  DELETE_COPY(FrameUniforms)
+  DELETE_MOVE(FrameUniforms)
+  // Binding point of the buffer, Program::link binds every FrameData block to it
+  static constexpr GLuint kBindingPoint = 0;
+
+  FrameUniforms();
+  ~FrameUniforms();
+
+  // Upload the values of this frame
+  void update(const FrameData& frame);
+  // Values of the last update
+  const FrameData& getData() const { return data; }
+
+ private:
+  GLuint buffer = 0;
+  FrameData data{};
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <map>
+#include <vector>
+
+#include "utils.h"
+#include "vertex_format.h"
+
+class Model;
+
+// Location of a model's vertex and index data inside the GeometryArena
+struct GeometryAllocation {
+  // Index of the arena page holding the data, -1 if not uploaded
+  int page = -1;
+  GLsizeiptr vertexOffset = 0;
+  GLsizeiptr vertexSize = 0;
+  GLsizeiptr indexOffset = 0;
+  GLsizeiptr indexSize = 0;
+  // Offsets to pass to glDrawElementsBaseVertex
+  GLint baseVertex = 0;
+  GLuint firstIndex = 0;
+
+  bool valid() const { return page >= 0; }
+};
+
+// First-fit free list over a byte range, adjacent free blocks are coalesced
+class FreeListAllocator {
+ public:
+  explicit FreeListAllocator(GLsizeiptr capacity);
+  // @return Offset of the block, or -1 if there is no space left
+  GLsizeiptr allocate(GLsizeiptr size, GLsizeiptr alignment);
+  void free(GLsizeiptr offset, GLsizeiptr size);
+
+  GLsizeiptr getCapacity() const { return capacity; }
+  GLsizeiptr getUsed() const { return used; }
+
+ private:
+  GLsizeiptr capacity;
+  GLsizeiptr used = 0;
+  // Offset -> size of every free block
+  std::map<GLsizeiptr, GLsizeiptr> freeBlocks;
+};
+
+// Suballocates the vertex and index data of every model from a few large GL
+// buffers. Each model is uploaded once and shared by all programs; draws use
+// the base vertex / first index of the model's allocation.
+class GeometryArena {
+ public:
+  DELETE_COPY(GeometryArena)
+  DELETE_MOVE(GeometryArena)
+  GeometryArena() = default;
+  ~GeometryArena();
+
+  // Upload the model's vertices (in model->vertexFormat) and indices,
+  // filling model->geometry
+  void upload(Model* model);
+  // Return the model's space to the arena
+  void release(Model* model);
+  // VAO that describes the model's page and vertex format
+  GLuint vertexArray(const Model* model) const;
+  // Bind the VAO that describes the model's page and vertex format
+  void bind(const Model* model);
+  // Bind and draw one level of detail of the model
+  void draw(const Model* model, int lod = 0);
+  // Draw one level of detail of the model with its VAO already bound
+  void drawBound(const Model* model, int lod = 0);
+
+  void printStats() const;
+
+ private:
+  struct Page {
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    FreeListAllocator vertexAllocator;
+    FreeListAllocator indexAllocator;
+    // One VAO per vertex format stored in this page
+    std::map<VertexFormat, GLuint> vaos;
+  };
+  int createPage(GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity);
+
+  // Default size of a page, larger meshes get a dedicated page
+  static constexpr GLsizeiptr kVertexPageSize = 8 << 20;
+  static constexpr GLsizeiptr kIndexPageSize = 4 << 20;
+  std::vector<Page> pages;
+};
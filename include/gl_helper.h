@@ -2,10 +2,19 @@
 
 #include <glad/gl.h>
 
+#include <string>
+
 GLuint quickCreateProgram(const char* vert_shader_filename, const char* frag_shader_filename);
 
 GLuint createShader(const char* filename, GLenum type);
 
-GLuint createProgram(GLuint vert, GLuint frag);
+// Read a whole shader file into source. @return false if it cannot be opened
+bool readShaderFile(const char* filename, std::string& source);
+
+// Compile GLSL source, name is only used in error messages. @return 0 on failure
+GLuint compileShader(const char* source, GLenum type, const char* name);
+
+// retrievable lets glGetProgramBinary read the linked program back
+GLuint createProgram(GLuint vert, GLuint frag, bool retrievable = false);
 
 GLuint createTexture(const char* filename);
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utils.h"
+
+// Work done through GLState during one frame
+struct GLFrameStats {
+  uint64_t drawCalls = 0;
+  uint64_t triangles = 0;
+  uint64_t programBinds = 0;
+  uint64_t vertexArrayBinds = 0;
+  uint64_t textureBinds = 0;
+  uint64_t bufferBinds = 0;
+  // glEnable / glDisable / glBlendFunc / glDepthFunc / glActiveTexture
+  uint64_t stateChanges = 0;
+  uint64_t uploads = 0;
+  uint64_t uploadBytes = 0;
+  // Calls dropped because the state was already set
+  uint64_t elidedCalls = 0;
+};
+
+// Shadows the GL binding and fixed function state the renderer touches and
+// drops calls that would not change it, counting the work of every frame.
+// All code on the GL thread has to go through here for the state it shadows
+// (programs, VAOs, 2D / array / cube textures per unit, buffers, blend, depth
+// and cull state), or call invalidate() after changing it directly.
+class GLState final {
+ public:
+  DELETE_COPY(GLState)
+  DELETE_MOVE(GLState)
+  // Texture units shadowed, binds to higher units always go through
+  static constexpr int kTextureUnits = 16;
+  // Seconds between two log lines of endFrame
+  static constexpr double kLogInterval = 5.0;
+
+  static void useProgram(GLuint program);
+  static void bindVertexArray(GLuint vertexArray);
+  // Make unit active and bind texture to target on it
+  static void bindTexture(int unit, GLenum target, GLuint texture);
+  // Bind texture to target on whatever unit is active, for creating and uploading
+  static void bindTexture(GLenum target, GLuint texture);
+  static void bindBuffer(GLenum target, GLuint buffer);
+  static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+  // glEnable / glDisable
+  static void setEnabled(GLenum capability, bool enabled);
+  static void blendFunc(GLenum source, GLenum destination);
+  static void depthFunc(GLenum function);
+
+  // Delete and forget the objects wherever they are bound
+  static void deleteTextures(GLsizei count, const GLuint* textures);
+  static void deleteBuffers(GLsizei count, const GLuint* buffers);
+  static void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+
+  // Indexed draw with 32-bit indices starting at firstIndex
+  static void drawElementsBaseVertex(GLenum mode, GLsizei count, GLuint firstIndex, GLint baseVertex);
+  // Record a texture or buffer upload
+  static void countUpload(size_t bytes);
+
+  // Forget every shadowed value, the next call of each kind always goes through
+  static void invalidate();
+  // Close the counters of the frame, every kLogInterval seconds they are
+  // averaged and printed
+  static void endFrame();
+  static const GLFrameStats& getFrameStats() { return current; }
+  static const GLFrameStats& getLastFrameStats() { return last; }
+
+ private:
+  GLState() = default;
+  // Index of target in the per unit texture shadow, -1 if it is not shadowed
+  static int textureSlot(GLenum target);
+  // Index of target in the buffer shadow, -1 if it is not shadowed
+  static int bufferSlot(GLenum target);
+  // Shadow value of an unknown binding
+  static constexpr GLuint kUnknown = 0xFFFFFFFFu;
+  static constexpr int kTextureTargets = 3;
+  static constexpr int kBufferTargets = 4;
+
+  static GLuint program;
+  static GLuint vertexArray;
+  static GLuint activeUnit;
+  static GLuint textures[kTextureUnits][kTextureTargets];
+  static GLuint buffers[kBufferTargets];
+  // -1 unknown, else 0 / 1 for GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE
+  static int enabled[3];
+  static GLenum blendSource, blendDestination;
+  static GLenum depthFunction;
+
+  static GLFrameStats current, last, interval;
+  static uint64_t intervalFrames;
+  static double intervalStart;
+};
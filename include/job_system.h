@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils.h"
+
+// Persistent worker threads for the parallel passes of a frame. Threads are
+// started once, a pass only wakes them, so splitting work costs a wake up
+// instead of a thread creation per slice and frame. One pass runs at a time.
+class JobSystem {
+ public:
+  DELETE_COPY(JobSystem)
+  DELETE_MOVE(JobSystem)
+  // workers = 0 uses one thread per core, leaving one for the calling thread
+  explicit JobSystem(int workers = 0);
+  ~JobSystem();
+
+  // Call fn(begin, end) for `slices` contiguous slices of [0, count) on the
+  // workers and the calling thread, and return once all of them are done
+  void parallelFor(size_t count, size_t slices, const std::function<void(size_t, size_t)>& fn);
+  // Threads a pass can use, the workers and the calling thread
+  int getThreadCount() const { return (int)workers.size() + 1; }
+
+ private:
+  void workerLoop();
+  // Take slices of the current pass until none are left
+  void runSlices();
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  bool stopping = false;
+  // Bumped for every pass, workers join the passes they have not seen yet
+  uint64_t pass = 0;
+  // Workers inside runSlices, a new pass waits for them to leave
+  int active = 0;
+
+  // The current pass, only changed while no worker is active
+  const std::function<void(size_t, size_t)>* job = nullptr;
+  size_t count = 0;
+  size_t slices = 0;
+  std::atomic<size_t> nextSlice{0};
+  size_t slicesDone = 0;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+class Model;
+
+// How the face normals around a vertex contribute to its smooth normal
+enum class NormalWeighting {
+  // Larger triangles count more
+  Area,
+  // Each face counts by the angle of its corner at the vertex, independent of tessellation
+  Angle,
+};
+
+// Fill model->normals with smooth normals. Vertices with identical positions
+// share a normal, so UV seams stay invisible. Works on model->indices, or on
+// the vertex list as a triangle list if the model has no indices.
+void computeNormals(Model* model, NormalWeighting weighting = NormalWeighting::Angle);
+
+// Fill model->tangents with MikkTSpace style tangents (xyz tangent, w sign of
+// the bitangent, bitangent = cross(normal, tangent) * w). Needs normals and
+// texcoords.
+void computeTangents(Model* model);
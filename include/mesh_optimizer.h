@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <vector>
+
+class Model;
+
+// Size of the FIFO post-transform vertex cache simulated by the optimizer
+constexpr int kVertexCacheSize = 16;
+
+// Convert the model's drawMode (GL_TRIANGLES, GL_QUADS, GL_TRIANGLE_STRIP or
+// GL_TRIANGLE_FAN) into an indexed triangle list, one index per input vertex
+void triangulateModel(Model* model);
+
+// Merge vertices whose position, normal, texcoord and tangent are bit-identical and
+// rewrite model->indices to reference the unique vertices
+void deduplicateVertices(Model* model);
+
+// Reorder triangles for post-transform cache locality (Tipsify).
+// If clusters is given, it receives the first triangle of every cluster.
+void optimizeVertexCache(std::vector<GLuint>& indices, int numVertex, int cacheSize = kVertexCacheSize,
+                         std::vector<GLuint>* clusters = nullptr);
+
+// Reorder the clusters produced by optimizeVertexCache so that outward facing
+// clusters are drawn first, which reduces overdraw for convex-ish meshes
+void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<GLuint>& clusters,
+                      const std::vector<float>& positions);
+
+// Reorder vertex data in the order the index buffer first references it
+void optimizeVertexFetch(Model* model);
+
+// Average cache miss ratio: transformed vertices per triangle with a FIFO cache
+float computeACMR(const std::vector<GLuint>& indices, int numVertex, int cacheSize = kVertexCacheSize);
+
+// Run the full pipeline on a model, update its bounds and print the ACMR
+// before and after
+void optimizeModel(Model* model, const char* name);
+
+// Split an indexed model into a grid of chunks on the XZ plane by triangle
+// centroid. Chunks copy the model's matrix, textures and vertex format.
+std::vector<Model*> splitModel(const Model* model, int chunksX, int chunksZ);
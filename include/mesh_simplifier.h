@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+class Model;
+
+// One level of detail of a model, stored as a range of Model::indices
+struct ModelLod {
+  // Offset of the first index in Model::indices
+  GLuint firstIndex = 0;
+  int numIndex = 0;
+  // Geometric error of this level in model space units
+  float error = 0.0f;
+};
+
+// Simplify a triangle list with quadric error metrics by collapsing edges
+// onto existing vertices. UV seams are never collapsed, border vertices may
+// only slide along their border, or never move if lockBorders. Meshes cut
+// from a larger one need lockBorders so neighbours keep matching edges.
+// Stops at targetIndexCount or maxError.
+// @return The simplified index list, resultError receives its error
+std::vector<GLuint> simplifyMesh(const std::vector<float>& positions, const std::vector<GLuint>& indices,
+                                 size_t targetIndexCount, float maxError, float* resultError,
+                                 bool lockBorders = false);
+
+// Append up to `levels` simplified levels (each about half the triangles of
+// the previous one) to model->indices and fill model->lods, level 0 being
+// the original mesh
+void generateLods(Model* model, int levels, bool lockBorders = false);
+
+// generateLods for many models at once, one worker thread per model. Models
+// in [lockedBegin, lockedEnd) keep their borders, see simplifyMesh.
+void generateLodsParallel(const std::vector<Model*>& models, int levels, size_t lockedBegin = 0,
+                          size_t lockedEnd = 0);
+
+// Pick the coarsest level whose error projects to at most thresholdPixels.
+// projectionScale is the screen height in pixels divided by 2 tan(fovy / 2).
+int selectLod(const Model* model, const glm::mat4& worldMatrix, const glm::vec3& cameraPosition,
+              float projectionScale, float thresholdPixels);
@@ -5,6 +5,11 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <vector>
 
+#include "geometry_arena.h"
+#include "mesh_simplifier.h"
+#include "texture_cache.h"
+#include "vertex_format.h"
+
 struct Material {
   glm::vec3 ambient = glm::vec3(0.2f, 0.2f, 0.2f);
   glm::vec3 diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
@@ -25,32 +30,35 @@ class Model {
   std::vector<float> normals; 
    // Or uv coordinates, VBO data for the 2D texture mapping of the vertex
   std::vector<float> texcoords;
+  // Optional, xyz tangent and w the sign of the bitangent (see mesh_normals.h)
+  std::vector<float> tangents;
+
+  // Index buffer data, filled by optimizeModel (see mesh_optimizer.h)
+  std::vector<GLuint> indices;
 
   // Total number of vertex 
   int numVertex = 0; 
-  // Mode parameter for glDrawArrays
+  // Total number of index, 0 if the model is drawn with glDrawArrays
+  int numIndex = 0;
+  // Mode parameter for glDrawArrays / glDrawElements
   GLenum drawMode = GL_TRIANGLES; 
+  // Levels of detail, each a range of indices. Level 0 is the full mesh.
+  std::vector<ModelLod> lods;
+  // Axis aligned bounding box in model local space
+  glm::vec3 boundsMin = glm::vec3(0.0f);
+  glm::vec3 boundsMax = glm::vec3(0.0f);
+
+  // Layout of the vertex buffer, chosen per model before upload
+  VertexFormat vertexFormat = VertexFormat::Float;
+  // Decode quantized positions: position = stored * positionScale + positionOffset
+  glm::vec3 positionScale = glm::vec3(1.0f);
+  glm::vec3 positionOffset = glm::vec3(0.0f);
+  // Where the model lives in the shared GeometryArena, filled by GeometryArena::upload
+  GeometryAllocation geometry;
 
-  // Ids for texture of this model
-  std::vector<GLuint> textures; 
+  // Textures of this model, shared through the TextureCache
+  std::vector<TextureHandle> textures; 
 
   static Model* fromObjectFile(const char* obj_file);
 
 };
-
-// Represent an object in the scene
-struct Object {
- public:
-  Material material;
-  // Index of model for this object in model vector
-  int modelIndex = 0;
-  // Index of texture id for this object in the model::textures vector in model for this object
-  int textureIndex = 0;
-  // Index of program id in Context::programs vector
-  // which is currently use to render this object
-  int programId = 0;
-  // Matrix for translate, rotate and scaling in world space
-  glm::mat4 transformMatrix;
-
-  Object(int modelIndex, glm::mat4 transformMatrix) : modelIndex(modelIndex), transformMatrix(transformMatrix) {}
-};
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "utils.h"
+
+class Model;
+
+// Software occlusion culling. Every frame the occluders (the terrain chunks)
+// are rasterized into a small depth buffer on the CPU, split into horizontal
+// bands that worker threads fill in parallel. Objects are then tested by
+// their bounding box against that buffer, through a per tile farthest depth
+// first. Each occluder is shrunk by one texel before testing, so the coarse
+// resolution can only keep hidden objects, never cull visible ones.
+class OcclusionCuller {
+ public:
+  DELETE_COPY(OcclusionCuller)
+  DELETE_MOVE(OcclusionCuller)
+  static constexpr int kWidth = 256;
+  static constexpr int kHeight = 144;
+  static constexpr int kTileSize = 16;
+
+  // The bands of rasterize are split over the workers of jobs, it has to outlive the culler
+  explicit OcclusionCuller(JobSystem* jobs);
+
+  // Start a frame seen through viewProjection, drops the occluders of the last one
+  void begin(const glm::mat4& viewProjection);
+  // Draw the full detail of model at worldMatrix into the depth buffer at rasterize
+  void addOccluder(const Model* model, const glm::mat4& worldMatrix);
+  void rasterize();
+  // Whether any part of the box may be seen, false if it is hidden or outside the view
+  bool isVisible(const glm::mat4& worldMatrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+  void setEnabled(bool enabled) { this->enabled = enabled; }
+  bool isEnabled() const { return enabled; }
+  // Counts of the current frame and the CPU time spent on it
+  int getTested() const { return tested; }
+  int getCulled() const { return culled; }
+  double getMilliseconds() const { return milliseconds; }
+
+ private:
+  // Vertex in buffer pixels, z is NDC depth; w <= 0 marks a vertex behind the camera
+  struct ScreenVertex {
+    float x, y, z, w;
+  };
+  struct Occluder {
+    const Model* model;
+    size_t firstVertex;
+  };
+  void rasterizeBand(int rowBegin, int rowEnd);
+  void rasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, int rowBegin,
+                         int rowEnd);
+  // Keep the farthest depth of every 3x3 neighbourhood and build the tile maxima
+  void erode();
+
+  JobSystem* jobs;
+  bool enabled = true;
+  glm::mat4 viewProjection = glm::mat4(1.0f);
+  std::vector<Occluder> occluders;
+  std::vector<ScreenVertex> vertices;
+  std::vector<float> depth;
+  std::vector<float> scratch;
+  std::vector<float> tileMax;
+  int tested = 0;
+  int culled = 0;
+  double milliseconds = 0.0;
+};
@@ -18,9 +18,11 @@ class OpenGLContext final {
    * @param GLversion Minimal version of OpenGL context, (pass 41 if you want OpenGL 4.1 context)
    * @param profile OpenGL profile, can be one of GLFW_OPENGL_CORE_PROFILE, GLFW_OPENGL_ANY_PROFILE or
    * GLFW_OPENGL_COMPAT_PROFILE. Note that for GLversion < 32, you should always use GLFW_OPENGL_ANY_PROFILE
+   * @param headless Keep the window hidden and, without a display, create the context offscreen through
+   * OSMesa (e.g. llvmpipe) so rendering works on machines without a window system
    *
    */
-  static void createContext(int GLversion, int profile);
+  static void createContext(int GLversion, int profile, bool headless = false);
   /// @return Current window handle.
   static GLFWwindow* getWindow() { return window; }
   /// @return Refresh rate of the primary monitor.
@@ -43,6 +45,7 @@ class OpenGLContext final {
   OpenGLContext();
   static int major_version, minor_version;
   static int profile;
+  static bool headless;
   // Cached data
   static GLFWwindow* window;
   static int refresh_rate;
@@ -0,0 +1,107 @@
+#pragma once
+
+// Frame profiler: CPU scopes from any thread, GPU scopes timed with
+// GL_TIME_ELAPSED queries, rolling p50 / p95 / p99 frame times and Chrome
+// trace-event export (load the file in chrome://tracing or Perfetto).
+// Built with HW2_PROFILER=0 every macro below expands to nothing.
+#ifndef HW2_PROFILER
+#define HW2_PROFILER 1
+#endif
+
+#if HW2_PROFILER
+
+#include <glad/gl.h>
+
+#include <cstdint>
+#include <string>
+
+#include "utils.h"
+
+class Profiler final {
+ public:
+  DELETE_COPY(Profiler)
+  DELETE_MOVE(Profiler)
+  // Frames kept for the percentiles
+  static constexpr int kWindowFrames = 600;
+  // Seconds between two log lines of endFrame
+  static constexpr double kLogInterval = 5.0;
+
+  // Nanoseconds on the steady clock
+  static uint64_t now();
+  // Append a finished CPU scope to the ring of the calling thread, never blocks
+  static void record(const char* name, uint64_t begin, uint64_t end);
+  // Start a GL_TIME_ELAPSED query, @return its slot or -1 if GPU timing is
+  // unavailable or another GPU scope is open (the queries cannot nest)
+  static int beginGpu(const char* name);
+  static void endGpu(int slot);
+
+  // Call on the GL thread around each frame. endFrame collects the events of
+  // every thread and the GPU times of the previous frame, whose queries had a
+  // frame to finish, so it never waits for the GPU.
+  static void beginFrame();
+  static void endFrame();
+  // Sum of the GPU scopes of the last frame whose queries were resolved, 0 without timer queries
+  static double getGpuFrameMs();
+
+  // Keep every event from now on for writeChromeTrace
+  static void startCapture();
+  // Write the captured events as trace-event JSON. @return false on failure
+  static bool writeChromeTrace(const std::string& path);
+  static void printReport();
+
+ private:
+  Profiler() = default;
+};
+
+// Times the enclosing block on the CPU
+class ProfileScope {
+ public:
+  DELETE_COPY(ProfileScope)
+  DELETE_MOVE(ProfileScope)
+  explicit ProfileScope(const char* name) : name(name), begin(Profiler::now()) {}
+  ~ProfileScope() { Profiler::record(name, begin, Profiler::now()); }
+
+ private:
+  const char* name;
+  uint64_t begin;
+};
+
+// Times the GL commands issued in the enclosing block
+class GpuProfileScope {
+ public:
+  DELETE_COPY(GpuProfileScope)
+  DELETE_MOVE(GpuProfileScope)
+  explicit GpuProfileScope(const char* name) : slot(Profiler::beginGpu(name)) {}
+  ~GpuProfileScope() { Profiler::endGpu(slot); }
+
+ private:
+  int slot;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// name must be a string literal or otherwise outlive the profiler
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __COUNTER__)(name)
+// CPU and GPU time of the block, GPU scopes must not nest
+#define PROFILE_GPU_SCOPE(name)                                    \
+  ProfileScope PROFILE_CONCAT(profileScope, __COUNTER__)(name);       \
+  GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __COUNTER__)(name)
+#define PROFILE_BEGIN_FRAME() Profiler::beginFrame()
+#define PROFILE_END_FRAME() Profiler::endFrame()
+#define PROFILE_START_CAPTURE() Profiler::startCapture()
+#define PROFILE_WRITE_TRACE(path) Profiler::writeChromeTrace(path)
+#define PROFILE_REPORT() Profiler::printReport()
+#define PROFILE_GPU_FRAME_MS() Profiler::getGpuFrameMs()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_FRAME()
+#define PROFILE_START_CAPTURE()
+#define PROFILE_WRITE_TRACE(path)
+#define PROFILE_REPORT()
+#define PROFILE_GPU_FRAME_MS() 0.0
+
+#endif
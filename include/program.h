@@ -2,8 +2,14 @@
 
 #include <glad/gl.h>
 #include "gl_helper.h"
+#include "gl_state.h"
+#include "program_cache.h"
+#include "shader_reflection.h"
+#include "texture_cache.h"
+#include "vertex_format.h"
 
 class Context;
+class Model;
 
 class Program {
  public:
@@ -15,14 +21,35 @@ class Program {
     vertProgramFile = "../assets/shaders/example.vert";
     fragProgramFIle = "../assets/shaders/example.frag";
   }
+  virtual ~Program() = default;
 
+  // Start building the program and load its resources. @return false on failure
   virtual bool load() = 0;
   virtual void doMainLoop() = 0;
+  // Finish the program started by load once the driver has compiled it, or
+  // block until then if wait. @return true once it can be drawn with
+  bool poll(bool wait = false);
+  bool isReady() const { return ready; }
+  bool hasFailed() const { return build.status == ProgramBuild::Status::kFailed; }
+  // Location of a uniform of this program, -1 if it is not used
+  GLint uniform(const std::string &name) const { return reflection.location(name); }
   GLuint programId = -1;
-  GLuint *VAO = 0;
+  // Permutation of the shader files to build, set before load
+  ShaderDefines defines;
+  // Uniforms set for every object drawn with this program, resolved by link()
+  GLint modelMatrixLocation = -1;
+  GLint normalMatrixLocation = -1;
+  DequantizeUniforms dequantize;
 
  protected:
+  // Submit the shader files to ctx->programCache, poll then reflects the
+  // uniforms and binds the FrameData block to FrameUniforms. @return false on failure
+  bool link();
+
   const Context *ctx;
+  ShaderReflection reflection;
+  ProgramBuild build;
+  bool ready = false;
 };
 
 class ExampleProgram : public Program {
@@ -43,6 +70,11 @@ class LightProgram : public Program {
   }
   bool load() override;
   void doMainLoop() override;
+
+ private:
+  // Per object results of the parallel pass over the scene, kept between frames
+  std::vector<int> lods;
+  std::vector<float> depths;
 };
 
 class SkyboxProgram : public Program {
@@ -53,4 +85,20 @@ class SkyboxProgram : public Program {
   }
   bool load() override;
   void doMainLoop() override;
+
+ private:
+  // Unit cube drawn around the camera, stored in the geometry arena
+  Model *cube = 0;
+  TextureHandle cubemap;
+};
+
+class ShadowProgram : public Program {
+ public:
+  ShadowProgram(Context *ctx) : Program(ctx) {
+    vertProgramFile = "../assets/shaders/shadow.vert";
+    fragProgramFIle = "../assets/shaders/shadow.frag";
+  }
+  bool load() override;
+  // Render the shadow cascades that are due this frame, see shadow_cascades.h
+  void doMainLoop() override;
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+#include <glad/gl.h>
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader_preprocessor.h"
+#include "utils.h"
+
+// One program between ProgramCache::submit and the poll that finishes it
+struct ProgramBuild {
+  enum class Status { kCompiling, kReady, kFailed };
+  Status status = Status::kFailed;
+  // Usable once status is kReady
+  GLuint program = 0;
+
+ private:
+  friend class ProgramCache;
+  std::string name;
+  std::string path;
+  std::chrono::steady_clock::time_point begin;
+};
+
+// Keeps linked programs on disk as glGetProgramBinary blobs, so a warm start
+// skips compiling and linking. Files are keyed by the preprocessed shader
+// sources, the defines and the driver vendor, renderer and version; a binary
+// the driver rejects is compiled again and replaced. Programs built or still
+// compiling this run are shared by every request for the same permutation,
+// each is compiled once. Programs are submitted as a batch:
+// every shader is handed to the driver before any status is read, so with
+// GL_KHR_parallel_shader_compile they compile on driver threads while
+// poll() checks GL_COMPLETION_STATUS_KHR without blocking.
+class ProgramCache {
+ public:
+  DELETE_COPY(ProgramCache)
+  DELETE_MOVE(ProgramCache)
+  // Needs the GL context, program binaries are checked for here
+  explicit ProgramCache(const std::string& directory);
+
+  // Start building the permutation of two shader files selected by defines,
+  // see preprocessShader. A cached binary is ready right away, anything else
+  // is compiling until poll() finishes it.
+  ProgramBuild submit(const char* vertFile, const char* fragFile, const ShaderDefines& defines = ShaderDefines());
+  // Finish build if the driver is done with it, or block until it is if wait.
+  // @return the new status of build
+  ProgramBuild::Status poll(ProgramBuild& build, bool wait = false);
+  // submit and wait in one call. @return 0 on failure
+  GLuint build(const char* vertFile, const char* fragFile, const ShaderDefines& defines = ShaderDefines());
+  bool isParallel() const { return parallel; }
+  void printReport() const;
+
+ private:
+  // A permutation from its submit on, the first poll that sees it done finishes it for every build
+  struct Variant {
+    GLuint program = 0;
+    // Deleted once the program is finished
+    GLuint vert = 0;
+    GLuint frag = 0;
+    // Files of each shader by #line source string number, for compile errors
+    std::vector<std::string> vertFiles;
+    std::vector<std::string> fragFiles;
+    ProgramBuild::Status status = ProgramBuild::Status::kCompiling;
+  };
+
+  std::string cachePath(const std::string& vertSource, const std::string& fragSource,
+                        const std::string& defines) const;
+  GLuint load(const std::string& path) const;
+  void save(const std::string& path, GLuint program) const;
+  // Finish the compiling variant build submitted once the driver is done, or
+  // block until it is if wait: save the binary and delete the shaders.
+  // @return false while it is still compiling
+  bool finish(const ProgramBuild& build, Variant& variant, bool wait);
+
+  std::string directory;
+  // Vendor, renderer and version, a driver update invalidates every binary
+  std::string driver;
+  bool supported = false;
+  // GL_KHR_parallel_shader_compile is available
+  bool parallel = false;
+  // Programs by cache path, one per permutation
+  std::unordered_map<std::string, Variant> variants;
+  int loaded = 0;
+  int compiled = 0;
+  double loadMs = 0.0;
+  // Wall time from the first compile submitted to the last one finished
+  std::chrono::steady_clock::time_point firstCompile, lastCompile;
+};
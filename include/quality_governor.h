@@ -0,0 +1,64 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+// Keeps the frame time near a budget by trading detail for speed. Subsystems
+// register knobs, a list of settings from best to cheapest with an estimate of
+// the frame time one step saves. The governor averages frame times over a
+// window and, with a dead band and a settle time after every change, steps
+// the knob with the largest saving down when over budget, and the cheapest
+// one back up when its cost fits in the headroom. Every decision is logged.
+class QualityGovernor {
+ public:
+  DELETE_COPY(QualityGovernor)
+  DELETE_MOVE(QualityGovernor)
+  // Frames averaged for each decision
+  static constexpr int kWindow = 60;
+  // Frames ignored after a change while its effect settles
+  static constexpr int kSettleFrames = 30;
+  // Step down when the average is above budget * kOverBudget
+  static constexpr double kOverBudget = 1.1;
+  // Step up when the average plus the cost of the step stays below budget * kUnderBudget
+  static constexpr double kUnderBudget = 0.85;
+
+  explicit QualityGovernor(double budgetMs);
+
+  // values from best to cheapest, apply is called with values[0] right away
+  void addKnob(const std::string& name, const std::vector<float>& values, double stepCostMs,
+               std::function<void(float)> apply);
+  // Record the time of a frame, may change one knob. frameMs should include
+  // GPU time, the larger knobs mostly save work on the GPU.
+  void addFrame(double frameMs);
+
+  void setEnabled(bool enabled);
+  bool isEnabled() const { return enabled; }
+  double getBudget() const { return budgetMs; }
+  // Current value of the knob, 0 if there is none by that name
+  float getValue(const std::string& name) const;
+
+ private:
+  struct Knob {
+    std::string name;
+    std::vector<float> values;
+    int level = 0;
+    // Estimated ms saved by one step down, refined by what each change measured
+    double stepCostMs;
+    std::function<void(float)> apply;
+  };
+  void change(int knob, int level, double averageMs);
+  void resetWindow(int settle);
+
+  double budgetMs;
+  bool enabled = true;
+  std::vector<Knob> knobs;
+  std::vector<double> frameMs;
+  int settleFrames = 0;
+  // Last change, compared with the next average to measure its real cost
+  int changedKnob = -1;
+  bool steppedDown = false;
+  double averageBeforeChange = 0.0;
+};
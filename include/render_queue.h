@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.h"
+
+class GeometryArena;
+class Model;
+class Program;
+
+// Everything the backend needs to issue one draw
+struct DrawItem {
+  static constexpr int kTextureUnits = 2;
+
+  const Program* program = nullptr;
+  const Model* model = nullptr;
+  int lod = 0;
+  glm::mat4 worldMatrix = glm::mat4(1.0f);
+  // Inverse transpose of worldMatrix, for programs that use NormalMatrix
+  glm::mat3 normalMatrix = glm::mat3(1.0f);
+  // GL_TEXTURE_2D bound to units 0 and 1, 0 leaves the unit alone
+  GLuint textures[kTextureUnits] = {0, 0};
+  bool blend = false;
+};
+
+// Draws of a frame ordered by a packed 64-bit key, from the most significant bit:
+//   opaque:      pass (2) | 0 | program (6) | material (16) | vertex array (8) | depth (24) | unused (7)
+//   transparent: pass (2) | 1 | inverted depth (24) | program (6) | material (16) | vertex array (8) | unused (7)
+// Opaque draws are grouped by state and drawn front to back inside a group,
+// transparent ones are drawn back to front after every opaque draw of their
+// pass. execute() goes through GLState, which drops the binds that match the
+// previous draw, so state changes scale with the number of distinct states,
+// not objects.
+class RenderQueue {
+ public:
+  DELETE_COPY(RenderQueue)
+  DELETE_MOVE(RenderQueue)
+  RenderQueue() = default;
+
+  // Pack a sort key. depth is the distance to the camera over the far plane,
+  // clamped to [0, 1]; the other fields are truncated to their bit width.
+  static uint64_t makeKey(int pass, bool transparent, int program, int material, GLuint vertexArray, float depth);
+  // Small dense id of a texture set, stable across frames
+  int materialId(const GLuint (&textures)[DrawItem::kTextureUnits]);
+
+  void submit(uint64_t key, const DrawItem& item);
+  // Radix sort the submitted draws, then draw them in key order.
+  // onProgramChange runs right after a program is made current and sets its
+  // per-program uniforms and textures; it may bind any texture unit.
+  void execute(GeometryArena* arena, const std::function<void(const Program*)>& onProgramChange);
+  // Drop the draws of the frame
+  void clear();
+
+  size_t size() const { return items.size(); }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    uint32_t index;
+  };
+  void sort();
+
+  std::vector<DrawItem> items;
+  // Sorted in place, scratch is the second buffer of the radix sort
+  std::vector<Entry> entries;
+  std::vector<Entry> scratch;
+  std::unordered_map<uint64_t, int> materials;
+};
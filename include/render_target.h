@@ -0,0 +1,33 @@
+#pragma once
+#include <glad/gl.h>
+
+#include "utils.h"
+
+// Offscreen framebuffer with an RGBA8 color and a 24-bit depth renderbuffer
+class RenderTarget {
+ public:
+  DELETE_COPY(RenderTarget)
+  DELETE_MOVE(RenderTarget)
+  RenderTarget() = default;
+  ~RenderTarget();
+
+  // (Re)create the buffers unless they already have this size, @return false if incomplete
+  bool resize(int width, int height);
+  // Draw into the target over its whole size
+  void bind() const;
+  // Scale the color buffer onto framebuffer, a width x height area at the origin
+  void blitTo(GLuint framebuffer, int width, int height) const;
+
+  GLuint getFramebuffer() const { return framebuffer; }
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+ private:
+  void release();
+
+  GLuint framebuffer = 0;
+  GLuint colorBuffer = 0;
+  GLuint depthBuffer = 0;
+  int width = 0;
+  int height = 0;
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "model.h"
+#include "utils.h"
+
+// Names an object of a Scene. A handle goes stale when its object is
+// destroyed, even if the slot is later reused by another object.
+struct ObjectHandle {
+  uint32_t slot = 0;
+  // 0 is never issued, so a default handle is always stale
+  uint32_t generation = 0;
+
+  bool operator==(const ObjectHandle& other) const { return slot == other.slot && generation == other.generation; }
+  bool operator!=(const ObjectHandle& other) const { return !(*this == other); }
+};
+
+// Every object of the scene, stored as dense parallel arrays (one per field)
+// instead of one heap allocation per object. Passes over the scene read only
+// the arrays they need, front to back. Destroying an object moves the last
+// one into its place, so dense indices change and handles are what stays
+// valid; indexOf maps one to the other through the slot table.
+//
+// Objects form a hierarchy: a transform is relative to the object's parent.
+// Setting a transform or parent only marks the object and its descendants
+// dirty, updateTransforms then recomputes the world and normal matrices and
+// bounds of the dirty ones in one batch, so still objects cost nothing.
+class Scene {
+ public:
+  DELETE_COPY(Scene)
+  DELETE_MOVE(Scene)
+  // models is what the model indices of objects refer to, it has to outlive the scene
+  explicit Scene(const std::vector<Model*>& models);
+
+  // Add an object drawing models[modelIndex] with programIndex at transform,
+  // relative to parent or to the world if parent is not a valid handle
+  ObjectHandle create(int modelIndex, int programIndex, const glm::mat4& transform, ObjectHandle parent = {});
+  // Destroy the object and all of its descendants
+  void destroy(ObjectHandle handle);
+  bool isValid(ObjectHandle handle) const;
+  // Position of the object in the arrays below, until an object is destroyed. The handle has to be valid.
+  size_t indexOf(ObjectHandle handle) const {
+    assert(isValid(handle));
+    return slots[handle.slot].index;
+  }
+  size_t size() const { return worldMatrices.size(); }
+
+  // The setters ignore stale handles, like destroy
+  void setTransform(ObjectHandle handle, const glm::mat4& transform);
+  // Attach to parent, or to the world if it is not valid. The transform is kept, so it becomes relative to parent.
+  void setParent(ObjectHandle handle, ObjectHandle parent);
+  void setMaterial(ObjectHandle handle, int materialIndex);
+  void setTexture(ObjectHandle handle, int textureIndex);
+  // @return Index to pass to setMaterial, 0 is the default material
+  int addMaterial(const Material& material);
+  const Material& getMaterial(int materialIndex) const { return materials[materialIndex]; }
+
+  // Recompute what depends on the transforms of dirty objects, once per frame
+  // before the passes that read the world space arrays below
+  void updateTransforms();
+
+  // One entry per object, in dense order. The transform is relative to the parent, as set
+  const std::vector<glm::mat4>& getTransforms() const { return localTransforms; }
+  // Transform times the model's modelMatrix, what the object is drawn with
+  const std::vector<glm::mat4>& getWorldMatrices() const { return worldMatrices; }
+  // Inverse transpose of the world matrix, turns model normals into world space
+  const std::vector<glm::mat3>& getNormalMatrices() const { return normalMatrices; }
+  // World space bounding box of the model at its world matrix
+  const std::vector<glm::vec3>& getBoundsMin() const { return boundsMin; }
+  const std::vector<glm::vec3>& getBoundsMax() const { return boundsMax; }
+  const std::vector<int>& getModelIndices() const { return modelIndices; }
+  // Index in Context::programs
+  const std::vector<int>& getProgramIndices() const { return programIndices; }
+  const std::vector<int>& getMaterialIndices() const { return materialIndices; }
+  // Index in Model::textures of the object's model
+  const std::vector<int>& getTextureIndices() const { return textureIndices; }
+
+  // Workers for parallelFor, without them every pass runs on the calling thread
+  void setJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+  // Call fn(begin, end) for contiguous slices of [0, size()). Slices run on
+  // the job workers only when each gets enough objects to pay for the wake up.
+  template <typename Fn>
+  void parallelFor(Fn fn) const;
+
+ private:
+  static constexpr uint32_t kNoSlot = 0xFFFFFFFF;
+  struct Slot {
+    // Dense index of the object, or the next free slot while unused
+    uint32_t index = 0;
+    uint32_t generation = 0;
+    // The hierarchy, as slots: children are a singly linked list
+    uint32_t parent = kNoSlot;
+    uint32_t firstChild = kNoSlot;
+    uint32_t nextSibling = kNoSlot;
+  };
+  // States of an entry of dirty, updateTransforms moves every dirty object to clean
+  enum : uint8_t { kClean, kDirty, kGlobalResolved };
+  // Below this many objects per slice handing it to a worker costs more than it saves
+  static constexpr size_t kMinObjectsPerWorker = 4096;
+
+  void markDirty(uint32_t slot);
+  void link(uint32_t slot, uint32_t parent);
+  void unlink(uint32_t slot);
+  // Global transform of the object at index, after those of its ancestors
+  void resolveGlobal(size_t index);
+
+  const std::vector<Model*>& models;
+  JobSystem* jobs = nullptr;
+  std::vector<Slot> slots;
+  uint32_t freeSlot = kNoSlot;
+  bool anyDirty = false;
+
+  std::vector<glm::mat4> localTransforms;
+  // Product of the local transforms from the root down, without modelMatrix
+  std::vector<glm::mat4> globalTransforms;
+  std::vector<glm::mat4> worldMatrices;
+  std::vector<glm::mat3> normalMatrices;
+  std::vector<glm::vec3> boundsMin;
+  std::vector<glm::vec3> boundsMax;
+  std::vector<int> modelIndices;
+  std::vector<int> programIndices;
+  std::vector<int> materialIndices;
+  std::vector<int> textureIndices;
+  std::vector<uint8_t> dirty;
+  // Slot of every dense index, to fix the slot table when objects move
+  std::vector<uint32_t> slotOf;
+
+  std::vector<Material> materials;
+};
+
+template <typename Fn>
+void Scene::parallelFor(Fn fn) const {
+  size_t count = size();
+  size_t threads = jobs ? (size_t)jobs->getThreadCount() : 1;
+  size_t slices = std::clamp(count / kMinObjectsPerWorker, (size_t)1, threads);
+  if (slices == 1) {
+    fn((size_t)0, count);
+    return;
+  }
+  jobs->parallelFor(count, slices, fn);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// #defines selecting one permutation of a shader, e.g. SHADOWS
+class ShaderDefines {
+ public:
+  ShaderDefines& set(const std::string& name, const std::string& value = "1");
+  bool empty() const { return values.empty(); }
+  // One "#define NAME VALUE" line per define in name order, so the same set
+  // always gives the same text and the same program cache key
+  std::string str() const;
+
+ private:
+  std::map<std::string, std::string> values;
+};
+
+// Read a shader, insert defines after its #version line and expand every
+// #include "file" line, relative to the including file. Include files guard
+// themselves against being pasted twice. #line directives number the files
+// in the order of files, so "2(14)" in a driver log is line 14 of files[2].
+// @return false if a file cannot be read or includes itself
+bool preprocessShader(const std::string& filename, const ShaderDefines& defines, std::string& source,
+                      std::vector<std::string>* files = nullptr);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <string>
+#include <unordered_map>
+
+// Active uniforms and uniform blocks of a linked program, queried once after
+// linking so draw loops never look a location up by name
+class ShaderReflection {
+ public:
+  // Forget the previous program and query every active uniform and block of program
+  void reflect(GLuint program);
+
+  // Location of a uniform, -1 if the program does not use it. Arrays are found
+  // both by their name and by "name[0]".
+  GLint location(const std::string& name) const;
+  // Index of a uniform block, GL_INVALID_INDEX if the program does not use it
+  GLuint blockIndex(const std::string& name) const;
+
+  int uniformCount() const { return (int)locations.size(); }
+  int blockCount() const { return (int)blocks.size(); }
+
+ private:
+  std::unordered_map<std::string, GLint> locations;
+  std::unordered_map<std::string, GLuint> blocks;
+};
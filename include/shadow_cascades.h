@@ -0,0 +1,71 @@
+#pragma once
+#include <glad/gl.h>
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "utils.h"
+
+class Program;
+
+// Cascaded shadow maps of the sun, layers of one depth array texture.
+// Cascade 0 follows the camera every frame, cascade 1 every kMiddleInterval
+// frames, and cascade 2 covers the whole island, so it only depends on the
+// sun and is rendered again once the sun has moved kFarSunThreshold degrees
+// or after invalidate(). Each cascade keeps the matrix it was rendered with,
+// so one that is not rendered this frame is still sampled correctly.
+class ShadowCascades {
+ public:
+  DELETE_COPY(ShadowCascades)
+  DELETE_MOVE(ShadowCascades)
+  static constexpr int kCascades = 3;
+  static constexpr int kResolution = 1024;
+  // View distances where cascades 0 and 1 end
+  static constexpr float kSplit0 = 8.0f;
+  static constexpr float kSplit1 = 25.0f;
+  static constexpr int kMiddleInterval = 2;
+  static constexpr float kFarSunThreshold = 1.0f;
+  // No shadows while the sun is this low, its light is gone anyway
+  static constexpr float kMinSunHeight = 0.05f;
+
+  // sceneMin and sceneMax bound every shadow caster
+  ShadowCascades(const glm::vec3& sceneMin, const glm::vec3& sceneMax);
+  ~ShadowCascades();
+
+  // Decide which cascades to render this frame and place them
+  void update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& sunDirection, uint64_t frame);
+  bool isEnabled() const { return enabled; }
+  bool isDue(int cascade) const { return due[cascade]; }
+  // Bind the layer of cascade for drawing and clear it
+  void beginCascade(int cascade) const;
+  const glm::mat4& getMatrix(int cascade) const { return matrices[cascade]; }
+  // Render every cascade again at the next update, e.g. after the terrain changed
+  void invalidate() { valid = false; }
+
+  // Bind the maps to unit and set the shadow uniforms of program, see terrain.frag
+  void bind(const Program* program, int unit) const;
+  void printReport() const;
+
+ private:
+  // Light view projection covering a sphere, snapped to whole texels so the
+  // shadows of a moving camera do not shimmer
+  glm::mat4 fitSphere(const glm::vec3& center, float radius) const;
+  // Bounding sphere of the view frustum between two view distances
+  void frustumSphere(const glm::mat4& view, const glm::mat4& projection, float from, float to, glm::vec3& center,
+                     float& radius) const;
+
+  GLuint texture = 0;
+  GLuint framebuffer = 0;
+  glm::vec3 sceneCenter;
+  float sceneRadius;
+  glm::vec3 sunDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+  // Sun direction the far cascade was rendered for
+  glm::vec3 farSunDirection = glm::vec3(0.0f);
+  bool valid = false;
+  bool enabled = false;
+  bool due[kCascades] = {};
+  glm::mat4 matrices[kCascades];
+  uint64_t frames = 0;
+  uint64_t renders[kCascades] = {};
+};
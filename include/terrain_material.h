@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "texture_cache.h"
+#include "utils.h"
+
+class Model;
+
+// Layered terrain texturing: every layer lives in one GL_TEXTURE_2D_ARRAY and
+// the per layer blend weights are baked into an RGBA splat map covering the
+// terrain in world XZ, one channel per layer. The fragment shader then costs
+// one splat fetch plus the layers with a non zero weight, and the whole
+// terrain binds two textures no matter how many chunks or layers it has.
+class TerrainMaterial {
+ public:
+  DELETE_COPY(TerrainMaterial)
+  DELETE_MOVE(TerrainMaterial)
+  // One RGBA8 splat texel holds the weights of this many layers
+  static constexpr int kMaxLayers = 4;
+  static constexpr int kDefaultLayerSize = 1024;
+
+  // Blend weights of the layers at a world space point of the terrain surface,
+  // they are normalized when baked
+  using WeightFunction = std::function<glm::vec4(const glm::vec3& position, const glm::vec3& normal)>;
+
+  // Layers beyond kMaxLayers can be sampled explicitly but never splatted
+  TerrainMaterial(TextureCache* cache, const std::vector<std::string>& layers, int layerSize = kDefaultLayerSize);
+  ~TerrainMaterial();
+
+  // Allocate the splat map covering world XZ in [boundsMin, boundsMax]
+  void createSplatMap(glm::vec2 boundsMin, glm::vec2 boundsMax, int resolution);
+  // Bake the weights of the texels under chunk. Only its rectangle of the
+  // splat map is uploaded, call again for chunks whose surface changed.
+  // The mip levels are left stale until finishBakes.
+  void bakeChunk(const Model* chunk, const glm::mat4& worldMatrix, const WeightFunction& weights);
+  // Rebuild the splat map mip levels once after a batch of bakeChunk calls
+  void finishBakes();
+
+  // Bind the layer array to firstUnit and the splat map to firstUnit + 1 and
+  // set the "layers", "splatMap" and "SplatTransform" uniforms of programId
+  void bind(GLuint programId, int firstUnit) const;
+
+  void printStats() const;
+
+  GLuint getLayers() const { return layers; }
+  GLuint getSplatMap() const { return splatMap; }
+
+ private:
+  TextureHandle layers;
+  GLuint splatMap = 0;
+  int resolution = 0;
+  glm::vec2 boundsMin = glm::vec2(0.0f);
+  glm::vec2 boundsMax = glm::vec2(0.0f);
+  // CPU copy, chunks sharing edge texels blend into the same values
+  std::vector<unsigned char> weights;
+  int chunksBaked = 0;
+  // Level 0 changed since the mip levels were last built
+  bool mipsStale = false;
+  double bakeMs = 0.0;
+};
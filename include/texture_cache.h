@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.h"
+
+class TextureCache;
+class TextureLoader;
+
+// Counted reference to a texture owned by a TextureCache. Converts to the GL
+// texture name, so it can be passed to glBindTexture directly.
+class TextureHandle {
+ public:
+  TextureHandle() = default;
+  TextureHandle(const TextureHandle& other);
+  TextureHandle(TextureHandle&& other) noexcept;
+  TextureHandle& operator=(TextureHandle other) noexcept;
+  ~TextureHandle();
+
+  GLuint id() const;
+  operator GLuint() const { return id(); }
+  explicit operator bool() const { return cache != nullptr; }
+
+ private:
+  friend class TextureCache;
+  TextureHandle(TextureCache* cache, int entry);
+
+  TextureCache* cache = nullptr;
+  int entry = -1;
+};
+
+// Shares textures between everything that loads the same file. Entries are
+// keyed by canonical path, so "a/../b.png" and "b.png" decode once. Textures
+// nobody references stay cached until the resident total exceeds the budget,
+// then the least recently released ones are deleted.
+class TextureCache {
+ public:
+  DELETE_COPY(TextureCache)
+  DELETE_MOVE(TextureCache)
+  static constexpr size_t kDefaultBudgetBytes = 512u << 20;
+
+  explicit TextureCache(TextureLoader* loader, size_t budgetBytes = kDefaultBudgetBytes);
+  ~TextureCache();
+
+  // 2D texture, see TextureLoader::load for the placeholder
+  TextureHandle get(const std::string& filename, glm::vec4 placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+  // Cube map from six faces, see TextureLoader::loadCubemap
+  TextureHandle getCubemap(const std::vector<std::string>& faces);
+  // 2D array with one layer per file, see TextureLoader::loadArray
+  TextureHandle getArray(const std::vector<std::string>& layers, int layerSize);
+
+  size_t getResidentBytes() const { return residentBytes; }
+  // Print every cached texture with its references and GPU size
+  void printReport() const;
+
+ private:
+  friend class TextureHandle;
+  struct Entry {
+    std::string key;
+    GLuint id = 0;
+    int references = 0;
+    // Estimated GPU size, 0 until the loader made the texture resident
+    size_t bytes = 0;
+    // Tick of the last release, orders unreferenced entries for eviction
+    uint64_t releasedAt = 0;
+  };
+
+  // Return the entry for key, calling create to start loading it on a miss
+  TextureHandle acquire(const std::string& key, const std::function<GLuint()>& create);
+  void addReference(int entry);
+  void release(int entry);
+  void onResident(GLuint id, size_t bytes);
+  void evict();
+
+  TextureLoader* loader;
+  size_t budgetBytes;
+  size_t residentBytes = 0;
+  uint64_t tick = 0;
+  int hits = 0;
+  // Evicted entries keep their slot with id 0 so handle indices stay stable
+  std::vector<Entry> entries;
+  std::unordered_map<std::string, int> entryByKey;
+  std::unordered_map<GLuint, int> entryById;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+// Pre-mipped, optionally block compressed texture file written by the
+// texconv tool (tools/texconv.cpp). Layout: TextureFileHeader, one
+// TextureFileLevel per mip level (level 0 first), then the data of every
+// level, each starting on a 16 byte boundary. All fields are little endian.
+constexpr char kTextureFileMagic[8] = {'H', 'W', '2', 'T', 'E', 'X', '\r', '\n'};
+constexpr uint32_t kTextureFileVersion = 1;
+// The loader prefers "name.tex" over "name.jpg" / "name.png" when it exists
+constexpr const char* kTextureFileExtension = ".tex";
+
+enum class TextureFileFormat : uint32_t {
+  R8,
+  RG8,
+  RGB8,
+  RGBA8,
+  // 4x4 blocks of 8 bytes, RGB
+  BC1,
+  // 4x4 blocks of 16 bytes, RGBA
+  BC3,
+  // 4x4 blocks of 16 bytes, two independent channels (normal map xy)
+  BC5,
+};
+
+// Color data is sRGB encoded, sample it through an sRGB internal format
+constexpr uint32_t kTextureFileSrgb = 1u << 0;
+
+struct TextureFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t format;
+  uint32_t flags;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levels;
+};
+
+struct TextureFileLevel {
+  // Byte offset from the start of the file
+  uint64_t offset;
+  uint64_t size;
+};
+
+bool isCompressed(TextureFileFormat format);
+// Bytes needed by one level; block formats round up to whole 4x4 blocks
+size_t textureLevelSize(TextureFileFormat format, uint32_t width, uint32_t height);
+// Sized GL internal format, the sRGB variant if srgb is set and one exists
+GLenum textureInternalFormat(TextureFileFormat format, bool srgb);
+// Pixel transfer format of uncompressed formats
+GLenum texturePixelFormat(TextureFileFormat format);
+
+// Read-only memory map of a whole file, mmap on POSIX and a file mapping on Windows
+class MappedFile {
+ public:
+  DELETE_COPY(MappedFile)
+  DELETE_MOVE(MappedFile)
+  MappedFile() = default;
+  ~MappedFile();
+
+  // @return false if the file does not exist or cannot be mapped
+  bool open(const std::string& path);
+  void close();
+
+  const unsigned char* data() const { return bytes; }
+  size_t size() const { return length; }
+
+ private:
+  const unsigned char* bytes = nullptr;
+  size_t length = 0;
+#ifdef _WIN32
+  void* file = nullptr;
+  void* mapping = nullptr;
+#endif
+};
+
+// Header and level table of a mapped texture file
+struct TextureFileView {
+  const TextureFileHeader* header = nullptr;
+  const TextureFileLevel* levels = nullptr;
+};
+
+// Validate the header and that every level lies inside the file
+bool parseTextureFile(const MappedFile& file, TextureFileView* view);
+
+// Write a texture file, levels[i] holding the data of mip level i
+bool writeTextureFile(const std::string& path, TextureFileFormat format, uint32_t flags, uint32_t width,
+                      uint32_t height, const std::vector<std::vector<unsigned char>>& levels);
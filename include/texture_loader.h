@@ -0,0 +1,189 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "texture_container.h"
+#include "utils.h"
+
+// Decodes images on a pool of worker threads and uploads them on the GL
+// thread through pixel buffer objects. Every texture is created immediately
+// with a 1x1 placeholder and keeps its GL name when the real image becomes
+// resident, so callers can store the id right away. When "name.tex" exists
+// next to "name.png" (see texture_container.h) it is memory mapped instead of
+// decoded and its stored, possibly block compressed, mip levels are uploaded.
+class TextureLoader {
+ public:
+  DELETE_COPY(TextureLoader)
+  DELETE_MOVE(TextureLoader)
+  // workers = 0 uses one thread per core, leaving one for the GL thread
+  explicit TextureLoader(int workers = 0);
+  ~TextureLoader();
+
+  // Queue a 2D texture, mipmapped and repeating
+  GLuint load(const std::string& filename, glm::vec4 placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+  // Queue a cube map, faces ordered as GL_TEXTURE_CUBE_MAP_POSITIVE_X + i
+  GLuint loadCubemap(const std::vector<std::string>& faces);
+  // Queue a mipmapped, repeating 2D array texture with one layer per file.
+  // Every layer is resampled to layerSize x layerSize RGBA8.
+  GLuint loadArray(const std::vector<std::string>& layers, int layerSize);
+
+  // Call once per frame on the GL thread. Copies decoded pixels into PBOs and
+  // makes finished textures resident until budgetMs is spent.
+  void update(double budgetMs);
+  // Block until every queued texture is resident
+  void finish();
+  // True when nothing is waiting to be decoded or uploaded
+  bool idle() const;
+
+  void printReport() const;
+
+  // A texture file kept mapped after a partial load so its finer levels can be
+  // uploaded later, see setStreamingTail
+  struct StreamedTexture {
+    std::shared_ptr<MappedFile> file;
+    TextureFileView view;
+    // Base level the texture was first loaded with, the coarsest it goes back to
+    int tailLevel = 0;
+    // Finest level allocated on the GPU, GL_TEXTURE_BASE_LEVEL
+    int baseLevel = 0;
+    // A streamIn is in flight
+    bool loading = false;
+
+    int levels() const { return (int)view.header->levels; }
+    // Estimated GPU size of levels [level, levels())
+    size_t bytesFrom(int level) const;
+  };
+
+  // Load texture files only from the first level at most tailSize pixels wide
+  // and high, keeping them mapped for streamIn. 0, the default, loads every
+  // level. Applies to textures queued afterwards.
+  void setStreamingTail(int tailSize) { streamingTail = tailSize; }
+  // nullptr unless id was loaded partially from a texture file
+  const StreamedTexture* findStreamed(GLuint id) const;
+  // Upload the levels [level, baseLevel) in the background; BASE_LEVEL moves
+  // once all of them are resident, so sampling never sees a missing level
+  void streamIn(GLuint id, int level);
+  // Move BASE_LEVEL to level and free the finer levels right away
+  void streamOut(GLuint id, int level);
+  // Drop the mapping of a texture that is about to be deleted
+  void forget(GLuint id);
+
+  // Upload texture files flagged as sRGB with an sRGB internal format. Off by
+  // default because the shaders light in gamma space.
+  void setSrgbDecode(bool enabled) { srgbDecode = enabled; }
+
+  // Called on the GL thread when a texture becomes resident or its resident
+  // size changes through streaming, with its estimated GPU size including mipmaps
+  void setResidentCallback(std::function<void(GLuint id, size_t bytes)> callback) {
+    onResident = std::move(callback);
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct DecodeJob {
+    // Key of the texture in pending
+    int texture;
+    int face;
+    std::string filename;
+    // Load jobs: levels larger than this are left for streaming, 0 loads all
+    int tailSize = 0;
+    // Array layers: resample to layerSize x layerSize RGBA8
+    int layerSize = 0;
+    // Stream jobs: levels [firstLevel, endLevel) of an already mapped file
+    std::shared_ptr<MappedFile> file{};
+    TextureFileView view{};
+    int firstLevel = 0, endLevel = 0;
+  };
+  struct DecodedImage {
+    int texture;
+    int face;
+    int width = 0, height = 0, channels = 0;
+    std::unique_ptr<unsigned char, void (*)(void*)> pixels{nullptr, nullptr};
+    // Set instead of pixels when a texture file was mapped
+    std::shared_ptr<MappedFile> file{};
+    TextureFileView view{};
+    // Levels of the texture file in the PBO
+    int firstLevel = 0, endLevel = 0;
+    // Bytes copied into the PBO; for texture files every level from firstLevel on
+    const unsigned char* source = nullptr;
+    size_t size = 0;
+  };
+  // A decoded face being copied into its pixel buffer, possibly over several frames
+  struct StagedFace {
+    DecodedImage image;
+    GLuint pixelBuffer = 0;
+    unsigned char* mapped = nullptr;
+    size_t copied = 0;
+  };
+  struct PendingTexture {
+    GLuint id;
+    GLenum target;
+    std::vector<StagedFace> faces;
+    int facesStaged = 0;
+    // Adds finer levels to a resident streamed texture
+    bool streaming = false;
+    // Set by forget, the GL name may already belong to another texture
+    bool cancelled = false;
+  };
+
+  GLuint createPlaceholder(GLenum target, glm::vec4 color, int layers = 1);
+  void enqueue(GLuint id, GLenum target, const std::vector<std::string>& files, int layerSize = 0);
+  // Upload the texture file levels of image from the bound PBO, @return their GPU size
+  size_t uploadLevels(GLenum target, const DecodedImage& image);
+  // Whether the driver can take the container's format, else the source image is decoded
+  bool canUpload(const TextureFileHeader* header) const;
+  void workerLoop();
+  // Copy part of a face into its PBO, @return true once the face is complete
+  bool stage(StagedFace& face, const Clock::time_point& deadline);
+  void makeResident(PendingTexture& texture);
+
+  std::vector<std::thread> workers;
+  mutable std::mutex mutex;
+  std::condition_variable jobReady;
+  std::condition_variable imageReady;
+  std::deque<DecodeJob> jobs;
+  std::deque<DecodedImage> decoded;
+  bool stopping = false;
+  // Whether the driver takes BC1 / BC3 data, set before the workers start
+  bool s3tcSupported = false;
+
+  // Only touched on the GL thread
+  std::function<void(GLuint, size_t)> onResident;
+  bool srgbDecode = false;
+  int streamingTail = 0;
+  std::unordered_map<GLuint, StreamedTexture> streamed;
+  // Textures being loaded or streamed in, erased once resident or cancelled
+  std::unordered_map<int, PendingTexture> pending;
+  int nextPending = 0;
+  // (texture, face) pairs waiting for their PBO copy, in decode order
+  std::deque<std::pair<int, int>> staging;
+  int texturesLeft = 0;
+
+  // Statistics for printReport
+  Clock::time_point startTime = Clock::now();
+  Clock::time_point lastDecodeTime;
+  double decodeMs = 0.0;
+  double uploadMs = 0.0;
+  double blockedMs = 0.0;
+  size_t decodedBytes = 0;
+  int imagesDecoded = 0;
+  int filesMapped = 0;
+  int texturesResident = 0;
+  int framesUploading = 0;
+  int levelsStreamedIn = 0;
+  int levelsStreamedOut = 0;
+  bool reported = false;
+};
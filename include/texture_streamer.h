@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "utils.h"
+
+class Model;
+class TextureLoader;
+
+// Decides how many mip levels of every streamed texture (see
+// TextureLoader::setStreamingTail) should be resident. Draw code reports the
+// textures it samples with request(); update() then streams finer levels in
+// for close objects and drops them for distant or unused ones. When the wanted
+// levels do not fit the budget every texture is coarsened by the same number
+// of levels.
+class TextureStreamer {
+ public:
+  DELETE_COPY(TextureStreamer)
+  DELETE_MOVE(TextureStreamer)
+  static constexpr size_t kDefaultBudgetBytes = 256u << 20;
+  // Levels up to this size load with the texture, finer ones are streamed
+  static constexpr int kDefaultTailSize = 256;
+  // Textures not requested for this many frames fall back to their tail
+  static constexpr uint64_t kIdleFrames = 300;
+
+  explicit TextureStreamer(TextureLoader* loader, size_t budgetBytes = kDefaultBudgetBytes,
+                           int tailSize = kDefaultTailSize);
+
+  // Record that texture is sampled through the texcoords of model, drawn with
+  // worldMatrix. projectionScale as for selectLod (see mesh_simplifier.h).
+  void request(GLuint texture, const Model* model, const glm::mat4& worldMatrix, const glm::vec3& cameraPosition,
+               float projectionScale);
+  // Call once per frame on the GL thread, after the requests of the frame
+  void update();
+
+  // GPU size of the resident levels of every streamed texture
+  size_t getStreamedBytes() const { return streamedBytes; }
+  void printReport() const;
+
+ private:
+  struct Entry {
+    // Finest level requested during the frame of lastRequested
+    float wantedLevel = 0.0f;
+    uint64_t lastRequested = 0;
+  };
+
+  // Texcoord units per model space unit, the square root of the texcoord area
+  // over the surface area of the full detail mesh. 0 if it has no texcoords.
+  float texcoordDensity(const Model* model);
+
+  TextureLoader* loader;
+  size_t budgetBytes;
+  size_t streamedBytes = 0;
+  // Requests made before the next update belong to this frame
+  uint64_t frame = 1;
+  // Levels added to every wanted level to stay inside the budget
+  int bias = 0;
+  std::unordered_map<GLuint, Entry> entries;
+  std::unordered_map<const Model*, float> densities;
+};
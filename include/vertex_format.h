@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <vector>
+
+class Model;
+
+// Interleaved vertex layout used when a model is uploaded to the GPU.
+// Attribute locations are always 0 = position, 1 = normal, 2 = texcoord,
+// 3 = tangent. Models without tangents get (1, 0, 0, 1).
+enum class VertexFormat {
+  // vec3 position, vec3 normal, vec2 texcoord, vec4 tangent as floats: 48 bytes
+  Float,
+  // 16-bit unorm position relative to the mesh bounds, octahedral normal in
+  // 2x16-bit snorm, half float texcoord and 2_10_10_10 snorm tangent: 20 bytes
+  Quantized,
+};
+
+// Size in bytes of one vertex in the given format
+GLsizei vertexStride(VertexFormat format);
+
+// Interleave the model's vertex data in model->vertexFormat. For quantized
+// formats this also updates model->positionScale and model->positionOffset,
+// which the vertex shaders use to decode positions.
+std::vector<unsigned char> packVertices(Model* model);
+
+// Describe the layout to the currently bound VAO, reading from the currently
+// bound GL_ARRAY_BUFFER starting at byte offset
+void setupVertexAttributes(VertexFormat format, size_t offset = 0);
+
+// Locations of the decode uniforms shared by all vertex shaders, -1 when a
+// program does not use one
+struct DequantizeUniforms {
+  GLint positionScale = -1;
+  GLint positionOffset = -1;
+  GLint octNormals = -1;
+};
+
+// Upload the decode parameters of the model to the uniforms of the current
+// program (PositionScale, PositionOffset and OctNormals)
+void setDequantizeUniforms(const DequantizeUniforms& uniforms, const Model* model);
@@ -3,52 +3,20 @@
 #include "context.h"
 #include "program.h"
 
-bool ExampleProgram::load() {
-  programId = quickCreateProgram(vertProgramFile, fragProgramFIle);
-
-  int num_model = (int)ctx->models.size();
-  VAO = new GLuint[num_model];
-
-  glGenVertexArrays(num_model, VAO);
-
-  for (int i = 0; i < num_model; i++) {
-    glBindVertexArray(VAO[i]);
-    Model* model = ctx->models[i];
-
-    GLuint VBO[1];
-    glGenBuffers(1, VBO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * model->positions.size(), model->positions.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-  }
-
-  return programId != 0;
-}
+bool ExampleProgram::load() { return link(); }
 
 void ExampleProgram::doMainLoop() {
-  glUseProgram(programId);
-  int obj_num = (int)ctx->objects.size();
+  GLState::useProgram(programId);
+  glUniform1i(uniform("ourTexture"), 0);
+  const std::vector<glm::mat4>& worldMatrices = ctx->scene.getWorldMatrices();
+  const std::vector<int>& modelIndices = ctx->scene.getModelIndices();
+  int obj_num = (int)ctx->scene.size();
   for (int i = 0; i < obj_num; i++) {
-    int modelIndex = ctx->objects[i]->modelIndex;
-    glBindVertexArray(VAO[modelIndex]);
-
-    Model* model = ctx->models[modelIndex];
-    const float* p = ctx->camera->getProjectionMatrix();
-    GLint pmatLoc = glGetUniformLocation(programId, "Projection");
-    glUniformMatrix4fv(pmatLoc, 1, GL_FALSE, p);
-
-    const float* v = ctx->camera->getViewMatrix();
-    GLint vmatLoc = glGetUniformLocation(programId, "ViewMatrix");
-    glUniformMatrix4fv(vmatLoc, 1, GL_FALSE, v);
-
-    const float* m = glm::value_ptr(ctx->objects[i]->transformMatrix * model->modelMatrix);
-    GLint mmatLoc = glGetUniformLocation(programId, "ModelMatrix");
-    glUniformMatrix4fv(mmatLoc, 1, GL_FALSE, m);
-
-    glUniform1i(glGetUniformLocation(programId, "ourTexture"), 0);
-    glDrawArrays(model->drawMode, 0, model->numVertex);
+    Model* model = ctx->models[modelIndices[i]];
+    glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(worldMatrices[i]));
+    setDequantizeUniforms(dequantize, model);
+    ctx->geometryArena->draw(model);
   }
-  glUseProgram(0);
-}
\ No newline at end of file
+  GLState::bindVertexArray(0);
+  GLState::useProgram(0);
+}
@@ -2,137 +2,114 @@
 #include "context.h"
 #include "program.h"
 
-bool LightProgram::load() {
-  programId = quickCreateProgram(vertProgramFile, fragProgramFIle);
-  int num_model = (int)ctx->models.size();
-  VAO = new GLuint[num_model];
+namespace {
+// Height of the ocean displacement, see ocean.vert
+constexpr float kOceanAmplitude = 10.0f;
+}  // namespace
 
-  glGenVertexArrays(num_model, VAO);
-  for (int i = 0; i < num_model; i++) {
-    glBindVertexArray(VAO[i]);
-    Model* model = ctx->models[i];
-
-    GLuint VBO[3];
-    glGenBuffers(3, VBO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * model->positions.size(), model->positions.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * model->normals.size(), model->normals.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * model->texcoords.size(), model->texcoords.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-  }
-  return programId != 0;
-}
+bool LightProgram::load() { return link(); }
 
 void LightProgram::doMainLoop() {
-  // add sunlight
-  float speed = 10.0f;
-  float sunAngle = glfwGetTime() * speed;
-
-  glm::vec3 lightDir =
-      glm::normalize(glm::vec3(cos(glm::radians(sunAngle)) * 10.0f, sin(glm::radians(sunAngle)) * 10.0f, 0.0f));
-  float heightFactor = sin(glm::radians(sunAngle));
-  glm::vec3 lightColor = glm::mix(glm::vec3(0.5f, 0.3f, 0.15f), glm::vec3(0.5f, 0.5f, 0.5f), heightFactor);
-  glm::vec3 ambientColor = glm::mix(glm::vec3(0.8f, 0.8f, 0.8f), glm::vec3(1.0f, 1.0f, 1.0f), heightFactor);
+  // Camera and sun come from the FrameData block, only per program and per object uniforms are set here
+  const FrameData& frame = ctx->frameUniforms->getData();
+
+  // Converts a world space error at distance 1 into pixels
+  float projectionScale = frame.projection[1][1] * ctx->renderHeight * 0.5f;
+  glm::vec3 cameraPosition = glm::vec3(frame.viewPosition);
+  float farPlane = frame.projection[3][2] / (frame.projection[2][2] + 1.0f);
+
+  // The terrain chunks are the occluders, everything is tested against them
+  const Scene& scene = ctx->scene;
+  const std::vector<glm::mat4>& worldMatrices = scene.getWorldMatrices();
+  const std::vector<int>& modelIndices = scene.getModelIndices();
+  const std::vector<int>& programIndices = scene.getProgramIndices();
+  OcclusionCuller* culler = ctx->occlusionCuller;
+  culler->begin(frame.projection * frame.view);
+  for (size_t i = 0; i < scene.size(); i++) {
+    if (programIndices[i] != ctx->terrainProgramIndex) continue;
+    culler->addOccluder(ctx->models[modelIndices[i]], worldMatrices[i]);
+  }
+  culler->rasterize();
+
+  // LOD and sort depth of every object only read the scene, so they run as one parallel pass
+  lods.resize(scene.size());
+  depths.resize(scene.size());
+  scene.parallelFor([&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const Model* model = ctx->models[modelIndices[i]];
+      lods[i] = selectLod(model, worldMatrices[i], cameraPosition, projectionScale, ctx->lodErrorThreshold);
+      glm::vec3 center = (scene.getBoundsMin()[i] + scene.getBoundsMax()[i]) * 0.5f;
+      depths[i] = glm::length(center - cameraPosition) / farPlane;
+    }
+  });
 
-  int obj_num = (int)ctx->objects.size();
+  RenderQueue* queue = ctx->renderQueue;
+  queue->clear();
+  // Each plant adds plantDensity, one is drawn whenever a whole one has accumulated
+  float plantBudget = 0.0f;
+  int obj_num = (int)scene.size();
   for (int i = 0; i < obj_num; i++) {
-    int modelIndex = ctx->objects[i]->modelIndex;
-    GLint programId = ctx->programs[ctx->objects[i]->programId]->programId;
-    glUseProgram(programId);
-    glBindVertexArray(VAO[modelIndex]);
-
-    Model* model = ctx->models[modelIndex];
-    const float* p = ctx->camera->getProjectionMatrix();
-    GLint pmatLoc = glGetUniformLocation(programId, "Projection");
-    glUniformMatrix4fv(pmatLoc, 1, GL_FALSE, p);
-
-    const float* v = ctx->camera->getViewMatrix();
-    GLint vmatLoc = glGetUniformLocation(programId, "ViewMatrix");
-    glUniformMatrix4fv(vmatLoc, 1, GL_FALSE, v);
-
-    const float* m = glm::value_ptr(ctx->objects[i]->transformMatrix * model->modelMatrix);
-    GLint mmatLoc = glGetUniformLocation(programId, "ModelMatrix");
-    glUniformMatrix4fv(mmatLoc, 1, GL_FALSE, m);
-
-    glm::mat4 TIMatrix = glm::transpose(glm::inverse(model->modelMatrix));
-    const float* ti = glm::value_ptr(TIMatrix);
-    mmatLoc = glGetUniformLocation(programId, "TIModelMatrix");
-    glUniformMatrix4fv(mmatLoc, 1, GL_FALSE, ti);
-
-    const float* vp = ctx->camera->getPosition();
-    mmatLoc = glGetUniformLocation(programId, "viewPos");
-    glUniform3fv(mmatLoc, 1, vp);
-
-    // sunlight
-    glUniform3fv(glGetUniformLocation(programId, "lightDir"), 1, glm::value_ptr(lightDir));
-    glUniform3fv(glGetUniformLocation(programId, "lightColor"), 1, glm::value_ptr(lightColor));
-    glUniform3fv(glGetUniformLocation(programId, "ambientColor"), 1, glm::value_ptr(ambientColor));
-
-    if (ctx->objects[i]->programId == ctx->terrainProgramIndex) {
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, model->textures[0]);  // CaK
-      glUniform1i(glGetUniformLocation(programId, "lowTex"), 0);
-
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, model->textures[1]);  // aK
-      glUniform1i(glGetUniformLocation(programId, "highTex"), 1);
-
-      glActiveTexture(GL_TEXTURE2);
-      glBindTexture(GL_TEXTURE_2D, model->textures[2]);  // K
-      glUniform1i(glGetUniformLocation(programId, "Water"), 2);
-
-      glActiveTexture(GL_TEXTURE3);
-      glBindTexture(GL_TEXTURE_2D, displacementMap);  // ׹
-      glUniform1i(glGetUniformLocation(programId, "displacementMap"), 3);
-
-    } else if (ctx->objects[i]->programId == ctx->OceanProgramIndex) {
-      glEnable(GL_BLEND);
-      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-      glUniform1f(glGetUniformLocation(programId, "time"), glfwGetTime());
+    Model* model = ctx->models[modelIndices[i]];
+    bool isTerrain = programIndices[i] == ctx->terrainProgramIndex;
+    bool isOcean = programIndices[i] == ctx->OceanProgramIndex;
+    bool isPlants = programIndices[i] == ctx->plantsProgramIndex;
+    if (isPlants) {
+      plantBudget += ctx->plantDensity;
+      if (plantBudget < 1.0f) continue;
+      plantBudget -= 1.0f;
+    }
 
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, model->textures[ctx->objects[i]->textureIndex]);
-      glUniform1i(glGetUniformLocation(programId, "ourTexture"), 0);
+    // Drawn with ExampleProgram while its own program is still compiling
+    int programIndex = ctx->programs[programIndices[i]]->isReady() ? programIndices[i] : 0;
+    DrawItem item;
+    item.program = ctx->programs[programIndex];
+    item.model = model;
+    item.worldMatrix = worldMatrices[i];
+    item.normalMatrix = scene.getNormalMatrices()[i];
+    // Waves move the ocean up to the displacement amplitude off its flat mesh
+    glm::vec3 lift(0.0f, isOcean ? kOceanAmplitude : 0.0f, 0.0f);
+    if (!culler->isVisible(item.worldMatrix, model->boundsMin - lift, model->boundsMax + lift)) continue;
+    // Terrain textures are bound once per program by its material
+    if (!isTerrain) item.textures[0] = model->textures[scene.getTextureIndices()[i]];
+    if (isOcean || isPlants) item.textures[1] = model->textures[1];
+    item.blend = isOcean;
+    // Every texture of the model may be sampled, let the streamer pick their mip levels
+    for (const TextureHandle& texture : model->textures) {
+      ctx->textureStreamer->request(texture, model, item.worldMatrix, cameraPosition, projectionScale);
+    }
+    item.lod = lods[i];
 
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, model->textures[1]);
-      glUniform1i(glGetUniformLocation(programId, "mossTexture"), 1);
+    uint64_t key = RenderQueue::makeKey(0, item.blend, programIndex, queue->materialId(item.textures),
+                                        ctx->geometryArena->vertexArray(model), depths[i]);
+    queue->submit(key, item);
+  }
 
-      glActiveTexture(GL_TEXTURE2);
-      glBindTexture(GL_TEXTURE_2D, displacementMap);
-      glUniform1i(glGetUniformLocation(programId, "displacementMap"), 2);
-      GLint location = glGetUniformLocation(programId, "displacementMap");
-      lightColor = glm::mix(glm::vec3(0.5f, 0.3f, 0.15f), glm::vec3(0.5f, 0.5f, 0.5f), std::abs(heightFactor));
-      glUniform3fv(glGetUniformLocation(programId, "lightColor"), 1, glm::value_ptr(lightColor));
-      glUniform1f(glGetUniformLocation(programId, "amplitude"), 10.0f);
-      glUniform3f(glGetUniformLocation(programId, "waterColor"), 0.3f, 0.8f, 1.0f);
-      glUniform3f(glGetUniformLocation(programId, "lightPos"), ctx->directionLightDirection.x,
-                  ctx->directionLightDirection.y, ctx->directionLightDirection.z);
-      glBindVertexArray(VAO[ctx->objects[i]->modelIndex]);
-    } 
-    else if (ctx->objects[i]->programId == ctx->plantsProgramIndex) {
-      glUniform1f(glGetUniformLocation(programId, "time"), glfwGetTime());
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, model->textures[ctx->objects[i]->textureIndex]);
-      glUniform1i(glGetUniformLocation(programId, "ourTexture"), 0);
-    } 
-    else {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, model->textures[ctx->objects[i]->textureIndex]);
-        glUniform1i(glGetUniformLocation(programId, "ourTexture"), 0);
-        glBindVertexArray(VAO[ctx->objects[i]->modelIndex]);
+  queue->execute(ctx->geometryArena, [&](const Program* program) {
+    GLuint programId = program->programId;
+    if (program == ctx->programs[ctx->terrainProgramIndex]) {
+      // Chunks share the layer array, splat map and displacement map
+      ctx->terrainMaterial->bind(programId, 0);
+      GLState::bindTexture(2, GL_TEXTURE_2D, displacementMap);  // ׹
+      glUniform1i(program->uniform("displacementMap"), 2);
+      ctx->shadowCascades->bind(program, 3);
+    } else if (program == ctx->programs[ctx->OceanProgramIndex]) {
+      glUniform1i(program->uniform("ourTexture"), 0);
+      glUniform1i(program->uniform("mossTexture"), 1);
+      GLState::bindTexture(2, GL_TEXTURE_2D, displacementMap);
+      glUniform1i(program->uniform("displacementMap"), 2);
+      // The water keeps the sun color when it is below the horizon
+      glm::vec3 sunDirection = glm::vec3(frame.sunDirection);
+      sunDirection.y = std::abs(sunDirection.y);
+      glm::vec3 lightColor = ctx->atmosphere->light(sunDirection).sunColor;
+      glUniform3fv(program->uniform("lightColor"), 1, glm::value_ptr(lightColor));
+      glUniform1f(program->uniform("amplitude"), kOceanAmplitude);
+      glUniform3f(program->uniform("waterColor"), 0.3f, 0.8f, 1.0f);
+    } else if (program == ctx->programs[ctx->plantsProgramIndex]) {
+      glUniform1i(program->uniform("ourTexture"), 0);
+      glUniform1i(program->uniform("normalTexture"), 1);
+      ctx->shadowCascades->bind(program, 3);
+    } else {
+      glUniform1i(program->uniform("ourTexture"), 0);
     }
-    glDrawArrays(model->drawMode, 0, model->numVertex);
-  }
-  glUseProgram(0);
+  });
 }
@@ -0,0 +1,26 @@
+#include "program.h"
+
+#include "context.h"
+#include "frame_uniforms.h"
+
+bool Program::link() {
+  build = ctx->programCache->submit(vertProgramFile, fragProgramFIle, defines);
+  return !hasFailed();
+}
+
+bool Program::poll(bool wait) {
+  if (ready) return true;
+  if (ctx->programCache->poll(build, wait) != ProgramBuild::Status::kReady) return false;
+  programId = build.program;
+  reflection.reflect(programId);
+  GLuint frameBlock = reflection.blockIndex("FrameData");
+  if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(programId, frameBlock, FrameUniforms::kBindingPoint);
+
+  modelMatrixLocation = uniform("ModelMatrix");
+  normalMatrixLocation = uniform("NormalMatrix");
+  dequantize.positionScale = uniform("PositionScale");
+  dequantize.positionOffset = uniform("PositionOffset");
+  dequantize.octNormals = uniform("OctNormals");
+  ready = true;
+  return true;
+}
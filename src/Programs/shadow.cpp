@@ -0,0 +1,76 @@
+#include <iostream>
+
+#include "context.h"
+#include "program.h"
+
+namespace {
+// Whether the world space box may cover part of the cascade drawn with matrix
+bool overlapsCascade(const glm::mat4& matrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+  glm::vec2 lower(1e30f), upper(-1e30f);
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 corner(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y,
+                     i & 4 ? boundsMax.z : boundsMin.z);
+    glm::vec4 clip = matrix * glm::vec4(corner, 1.0f);
+    lower = glm::vec2(std::min(lower.x, clip.x), std::min(lower.y, clip.y));
+    upper = glm::vec2(std::max(upper.x, clip.x), std::max(upper.y, clip.y));
+  }
+  return lower.x <= 1.0f && upper.x >= -1.0f && lower.y <= 1.0f && upper.y >= -1.0f;
+}
+}  // namespace
+
+bool ShadowProgram::load() { return link(); }
+
+void ShadowProgram::doMainLoop() {
+  // Nothing is shadowed until the program is ready
+  if (!isReady()) return;
+  const FrameData& frame = ctx->frameUniforms->getData();
+  ShadowCascades* shadows = ctx->shadowCascades;
+  shadows->update(frame.view, frame.projection, glm::vec3(frame.sunDirection), ctx->frameClock->now().frame);
+  if (!shadows->isEnabled()) return;
+
+  // Near cascades draw the LODs the camera sees, as in LightProgram
+  float projectionScale = frame.projection[1][1] * ctx->renderHeight * 0.5f;
+  glm::vec3 cameraPosition = glm::vec3(frame.viewPosition);
+  int farCascade = ShadowCascades::kCascades - 1;
+  const Scene& scene = ctx->scene;
+  const std::vector<int>& programIndices = scene.getProgramIndices();
+
+  GLState::useProgram(programId);
+  GLState::setEnabled(GL_DEPTH_TEST, true);
+  GLState::depthFunc(GL_LEQUAL);
+  // Plants are single sided cards, and slope scaled bias keeps the terrain from shadowing itself
+  GLState::setEnabled(GL_CULL_FACE, false);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(2.0f, 4.0f);
+  for (int cascade = 0; cascade < ShadowCascades::kCascades; cascade++) {
+    if (!shadows->isDue(cascade)) continue;
+    shadows->beginCascade(cascade);
+    const glm::mat4& lightMatrix = shadows->getMatrix(cascade);
+    glUniformMatrix4fv(uniform("LightMatrix"), 1, GL_FALSE, glm::value_ptr(lightMatrix));
+    // Same thinning as LightProgram so shadows match the plants drawn
+    float plantBudget = 0.0f;
+    for (size_t i = 0; i < scene.size(); i++) {
+      bool isTerrain = programIndices[i] == ctx->terrainProgramIndex;
+      bool isPlants = programIndices[i] == ctx->plantsProgramIndex;
+      if (!isTerrain && !isPlants) continue;
+      if (isPlants) {
+        plantBudget += ctx->plantDensity;
+        if (plantBudget < 1.0f) continue;
+        plantBudget -= 1.0f;
+        // The far cascade is cached, it only holds the static terrain
+        if (cascade == farCascade) continue;
+      }
+      if (!overlapsCascade(lightMatrix, scene.getBoundsMin()[i], scene.getBoundsMax()[i])) continue;
+      Model* model = ctx->models[scene.getModelIndices()[i]];
+      const glm::mat4& worldMatrix = scene.getWorldMatrices()[i];
+      int lod = cascade == farCascade
+                    ? 0
+                    : selectLod(model, worldMatrix, cameraPosition, projectionScale, ctx->lodErrorThreshold);
+      glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(worldMatrix));
+      setDequantizeUniforms(dequantize, model);
+      ctx->geometryArena->draw(model, lod);
+    }
+  }
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  GLState::setEnabled(GL_CULL_FACE, true);
+}
@@ -0,0 +1,274 @@
+#include "atmosphere.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <glm/gtc/constants.hpp>
+
+#include "gl_state.h"
+
+namespace {
+// Bump when the integration changes so stale cache files are not used
+constexpr uint32_t kCacheVersion = 1;
+constexpr int kTransmittanceSteps = 40;
+constexpr int kSkySteps = 32;
+// Sun light reaching the ground at noon is about this bright in FrameData
+constexpr float kSunColorScale = 0.55f;
+// Ambient at noon has this luminance, and never drops below kNightAmbient
+constexpr float kNoonAmbient = 1.0f;
+constexpr glm::vec3 kNightAmbient(0.2f, 0.22f, 0.3f);
+
+float luminance(const glm::vec3& color) { return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f)); }
+
+// Distance from radius r along cosine mu to a sphere of the given radius, negative if missed
+float distanceToSphere(float r, float mu, float radius) {
+  float discriminant = r * r * (mu * mu - 1.0f) + radius * radius;
+  if (discriminant < 0.0f) return -1.0f;
+  return -r * mu + std::sqrt(discriminant);
+}
+
+bool hitsGround(float r, float mu, float groundRadius) {
+  return mu < 0.0f && r * r * (mu * mu - 1.0f) + groundRadius * groundRadius >= 0.0f;
+}
+
+// Elevations are spaced more densely near the horizon, where the sky changes most.
+// skybox.frag maps them back the same way.
+float coordinateToElevation(float coordinate) {
+  float x = coordinate * 2.0f - 1.0f;
+  return (x < 0.0f ? -1.0f : 1.0f) * x * x * glm::half_pi<float>();
+}
+}  // namespace
+
+Atmosphere::Atmosphere(const AtmosphereParameters& parameters) : parameters(parameters) {}
+
+Atmosphere::~Atmosphere() {
+  if (pending.valid()) pending.wait();
+  if (skyViewTexture != 0) GLState::deleteTextures(1, &skyViewTexture);
+}
+
+void Atmosphere::start(const std::string& cacheDirectory) {
+  std::string path = cacheDirectory + "/atmosphere-" + cacheKey() + ".bin";
+  pending = std::async(std::launch::async, [this, path] {
+    if (loadCache(path)) {
+      std::cout << "Atmosphere: loaded " << path << std::endl;
+      return;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    compute();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Atmosphere: computed in " << ms << " ms" << std::endl;
+    saveCache(path);
+  });
+}
+
+void Atmosphere::finish() {
+  if (pending.valid()) pending.get();
+  glGenTextures(1, &skyViewTexture);
+  GLState::bindTexture(GL_TEXTURE_2D_ARRAY, skyViewTexture);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB16F, kSkyAzimuths, kSkyElevations, kSunElevations, 0, GL_RGB, GL_FLOAT,
+               skyViewTable.data());
+  GLState::countUpload(skyViewTable.size() * sizeof(glm::vec3));
+}
+
+glm::vec3 Atmosphere::integrateTransmittance(float r, float mu) const {
+  const AtmosphereParameters& p = parameters;
+  if (hitsGround(r, mu, p.groundRadius)) return glm::vec3(0.0f);
+  float length = distanceToSphere(r, mu, p.topRadius);
+  float dt = length / kTransmittanceSteps;
+  glm::vec3 opticalDepth(0.0f);
+  for (int i = 0; i < kTransmittanceSteps; i++) {
+    float t = (i + 0.5f) * dt;
+    float height = std::sqrt(r * r + t * t + 2.0f * r * mu * t) - p.groundRadius;
+    float rayleigh = std::exp(-height / p.rayleighScaleHeight);
+    float mie = std::exp(-height / p.mieScaleHeight);
+    float ozone = std::max(0.0f, 1.0f - std::abs(height - p.ozoneCenter) / p.ozoneHalfWidth);
+    opticalDepth +=
+        (p.rayleighScattering * rayleigh + glm::vec3(p.mieExtinction * mie) + p.ozoneAbsorption * ozone) * dt;
+  }
+  return glm::exp(-opticalDepth);
+}
+
+glm::vec3 Atmosphere::transmittance(float r, float mu) const {
+  const AtmosphereParameters& p = parameters;
+  float u = glm::clamp((mu + 1.0f) * 0.5f, 0.0f, 1.0f) * (kTransmittanceAngles - 1);
+  float height = (r - p.groundRadius) / (p.topRadius - p.groundRadius);
+  float v = glm::clamp(height, 0.0f, 1.0f) * (kTransmittanceHeights - 1);
+  int u0 = std::min((int)u, kTransmittanceAngles - 2);
+  int v0 = std::min((int)v, kTransmittanceHeights - 2);
+  float fu = u - u0, fv = v - v0;
+  auto at = [this](int x, int y) { return transmittanceTable[y * kTransmittanceAngles + x]; };
+  glm::vec3 bottom = glm::mix(at(u0, v0), at(u0 + 1, v0), fu);
+  glm::vec3 top = glm::mix(at(u0, v0 + 1), at(u0 + 1, v0 + 1), fu);
+  return glm::mix(bottom, top, fv);
+}
+
+glm::vec3 Atmosphere::integrateSky(float elevation, float azimuth, const glm::vec3& sunDirection) const {
+  const AtmosphereParameters& p = parameters;
+  // Planet centered frame, y up at the viewer, x towards the sun azimuth
+  glm::vec3 origin(0.0f, p.groundRadius + p.viewerHeight, 0.0f);
+  glm::vec3 direction(std::cos(elevation) * std::cos(azimuth), std::sin(elevation),
+                      std::cos(elevation) * std::sin(azimuth));
+  float r = origin.y, mu = direction.y;
+  float length = hitsGround(r, mu, p.groundRadius)
+                     ? -r * mu - std::sqrt(std::max(0.0f, r * r * (mu * mu - 1.0f) + p.groundRadius * p.groundRadius))
+                     : distanceToSphere(r, mu, p.topRadius);
+  float dt = length / kSkySteps;
+
+  float cosTheta = glm::dot(direction, sunDirection);
+  float rayleighPhase = 3.0f / (16.0f * glm::pi<float>()) * (1.0f + cosTheta * cosTheta);
+  float g = p.mieAnisotropy;
+  float miePhase = (1.0f - g * g) / (4.0f * glm::pi<float>() * std::pow(1.0f + g * g - 2.0f * g * cosTheta, 1.5f));
+
+  glm::vec3 radiance(0.0f), viewTransmittance(1.0f);
+  for (int i = 0; i < kSkySteps; i++) {
+    glm::vec3 position = origin + direction * ((i + 0.5f) * dt);
+    float sampleRadius = glm::length(position);
+    float height = sampleRadius - p.groundRadius;
+    float rayleigh = std::exp(-height / p.rayleighScaleHeight);
+    float mie = std::exp(-height / p.mieScaleHeight);
+    float ozone = std::max(0.0f, 1.0f - std::abs(height - p.ozoneCenter) / p.ozoneHalfWidth);
+    glm::vec3 extinction =
+        p.rayleighScattering * rayleigh + glm::vec3(p.mieExtinction * mie) + p.ozoneAbsorption * ozone;
+
+    float sunMu = glm::dot(position / sampleRadius, sunDirection);
+    glm::vec3 sunLight = transmittance(sampleRadius, sunMu);
+    glm::vec3 scattering =
+        p.rayleighScattering * (rayleigh * rayleighPhase) + glm::vec3(p.mieScattering * mie * miePhase);
+    // Light scattered over the step, attenuated on its way to the viewer
+    glm::vec3 stepTransmittance = glm::exp(-extinction * dt);
+    glm::vec3 integral = (glm::vec3(1.0f) - stepTransmittance) / glm::max(extinction, glm::vec3(1e-9f));
+    radiance += viewTransmittance * sunLight * scattering * integral;
+    viewTransmittance *= stepTransmittance;
+  }
+  return radiance;
+}
+
+void Atmosphere::computeSkyLayer(int layer) {
+  float sunElevation =
+      glm::radians(glm::mix(kMinSunElevation, kMaxSunElevation, (float)layer / (kSunElevations - 1)));
+  glm::vec3 sunDirection(std::cos(sunElevation), std::sin(sunElevation), 0.0f);
+  glm::vec3* texels = skyViewTable.data() + (size_t)layer * kSkyAzimuths * kSkyElevations;
+  glm::vec3 irradiance(0.0f);
+  for (int y = 0; y < kSkyElevations; y++) {
+    float elevation = coordinateToElevation((y + 0.5f) / kSkyElevations);
+    for (int x = 0; x < kSkyAzimuths; x++) {
+      float azimuth = (x + 0.5f) / kSkyAzimuths * glm::pi<float>();
+      glm::vec3 radiance = integrateSky(elevation, azimuth, sunDirection);
+      texels[y * kSkyAzimuths + x] = radiance;
+      if (elevation > 0.0f) {
+        // Cosine weighted solid angle, the table covers half the azimuths
+        float nextElevation = coordinateToElevation((y + 1.0f) / kSkyElevations);
+        float previousElevation = coordinateToElevation((float)y / kSkyElevations);
+        float dElevation = nextElevation - std::max(previousElevation, 0.0f);
+        float dAzimuth = glm::pi<float>() / kSkyAzimuths;
+        irradiance += radiance * (std::sin(elevation) * std::cos(elevation) * dElevation * dAzimuth * 2.0f);
+      }
+    }
+  }
+  irradianceTable[layer] = irradiance;
+}
+
+void Atmosphere::compute() {
+  transmittanceTable.resize(kTransmittanceHeights * kTransmittanceAngles);
+  const AtmosphereParameters& p = parameters;
+  std::vector<std::future<void>> jobs;
+  for (int y = 0; y < kTransmittanceHeights; y++) {
+    jobs.push_back(std::async(std::launch::async, [this, &p, y] {
+      float r = glm::mix(p.groundRadius, p.topRadius, (float)y / (kTransmittanceHeights - 1));
+      for (int x = 0; x < kTransmittanceAngles; x++) {
+        float mu = (float)x / (kTransmittanceAngles - 1) * 2.0f - 1.0f;
+        transmittanceTable[y * kTransmittanceAngles + x] = integrateTransmittance(r, mu);
+      }
+    }));
+  }
+  for (std::future<void>& job : jobs) job.get();
+
+  // Every layer reads only the finished transmittance table
+  skyViewTable.resize((size_t)kSkyAzimuths * kSkyElevations * kSunElevations);
+  irradianceTable.resize(kSunElevations);
+  jobs.clear();
+  for (int layer = 0; layer < kSunElevations; layer++) {
+    jobs.push_back(std::async(std::launch::async, &Atmosphere::computeSkyLayer, this, layer));
+  }
+  for (std::future<void>& job : jobs) job.get();
+}
+
+float Atmosphere::skyViewLayer(const glm::vec3& sunDirection) const {
+  float elevation = glm::degrees(std::asin(glm::clamp(glm::normalize(sunDirection).y, -1.0f, 1.0f)));
+  float t = (elevation - kMinSunElevation) / (kMaxSunElevation - kMinSunElevation);
+  return glm::clamp(t, 0.0f, 1.0f) * (kSunElevations - 1);
+}
+
+AtmosphereLight Atmosphere::light(const glm::vec3& sunDirection) const {
+  const AtmosphereParameters& p = parameters;
+  glm::vec3 direction = glm::normalize(sunDirection);
+  AtmosphereLight light;
+  light.sunColor = transmittance(p.groundRadius + p.viewerHeight, direction.y) * kSunColorScale;
+
+  float layer = skyViewLayer(direction);
+  int layer0 = std::min((int)layer, kSunElevations - 2);
+  glm::vec3 irradiance = glm::mix(irradianceTable[layer0], irradianceTable[layer0 + 1], layer - layer0);
+  float noon = std::max(luminance(irradianceTable.back()), 1e-6f);
+  light.ambientColor = glm::max(irradiance * (kNoonAmbient / noon), kNightAmbient);
+  return light;
+}
+
+std::string Atmosphere::cacheKey() const {
+  // FNV-1a over everything the tables depend on
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+  };
+  int sizes[] = {kTransmittanceHeights, kTransmittanceAngles, kSkyAzimuths, kSkyElevations, kSunElevations,
+                 kTransmittanceSteps,   kSkySteps,            (int)kCacheVersion};
+  float range[] = {kMinSunElevation, kMaxSunElevation};
+  add(&parameters, sizeof(parameters));
+  add(sizes, sizeof(sizes));
+  add(range, sizeof(range));
+  std::ostringstream key;
+  key << std::hex << hash;
+  return key.str();
+}
+
+bool Atmosphere::loadCache(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  uint32_t version = 0;
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  if (version != kCacheVersion) return false;
+  transmittanceTable.resize(kTransmittanceHeights * kTransmittanceAngles);
+  skyViewTable.resize((size_t)kSkyAzimuths * kSkyElevations * kSunElevations);
+  irradianceTable.resize(kSunElevations);
+  for (std::vector<glm::vec3>* table : {&transmittanceTable, &skyViewTable, &irradianceTable}) {
+    file.read(reinterpret_cast<char*>(table->data()), table->size() * sizeof(glm::vec3));
+  }
+  return (bool)file;
+}
+
+void Atmosphere::saveCache(const std::string& path) const {
+  std::error_code error;
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    std::cout << "Atmosphere: cannot write cache " << path << std::endl;
+    return;
+  }
+  file.write(reinterpret_cast<const char*>(&kCacheVersion), sizeof(kCacheVersion));
+  for (const std::vector<glm::vec3>* table : {&transmittanceTable, &skyViewTable, &irradianceTable}) {
+    file.write(reinterpret_cast<const char*>(table->data()), table->size() * sizeof(glm::vec3));
+  }
+}
@@ -0,0 +1,224 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <glm/gtc/constants.hpp>
+
+#include "frame_clock.h"
+
+namespace {
+double now() { return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+// Nearest rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0.0;
+  size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+// FNV-1a, stable across platforms so checksums of two runs can be compared
+uint64_t fnv1a(const uint8_t* data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Binary PPM of tightly packed, bottom up RGBA rows
+bool writePpm(const std::string& filename, const std::vector<uint8_t>& rgba, int width, int height) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file) return false;
+  file << "P6\n" << width << " " << height << "\n255\n";
+  std::vector<uint8_t> row(width * 3);
+  for (int y = height - 1; y >= 0; y--) {
+    const uint8_t* src = rgba.data() + (size_t)y * width * 4;
+    for (int x = 0; x < width; x++) std::memcpy(&row[x * 3], src + x * 4, 3);
+    file.write((const char*)row.data(), row.size());
+  }
+  return (bool)file;
+}
+}  // namespace
+
+bool BenchmarkOptions::parse(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--benchmark") {
+      enabled = true;
+    } else if (arg == "--frames" && hasValue) {
+      frames = std::atoi(argv[++i]);
+    } else if (arg == "--timestep" && hasValue) {
+      timestep = std::atof(argv[++i]);
+    } else if (arg == "--size" && hasValue) {
+      if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2) width = height = 0;
+    } else if (arg == "--camera" && hasValue) {
+      cameraPath = argv[++i];
+    } else if (arg == "--stats" && hasValue) {
+      statsPath = argv[++i];
+    } else if (arg == "--checksums" && hasValue) {
+      checksumDir = argv[++i];
+    } else if (arg == "--checksum-every" && hasValue) {
+      checksumEvery = std::atoi(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+    } else {
+      std::cout << "Unknown or incomplete argument " << arg << std::endl;
+      return false;
+    }
+  }
+  if (frames <= 0 || timestep <= 0.0 || width <= 0 || height <= 0 || checksumEvery < 0) {
+    std::cout << "Benchmark needs positive --frames, --timestep and --size WxH" << std::endl;
+    return false;
+  }
+  // The clock clamps longer frames, the simulation would silently run slower than asked
+  if (timestep > FrameClock::kMaxFrameDelta) {
+    std::cout << "Benchmark --timestep can be at most " << FrameClock::kMaxFrameDelta << " s" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool CameraPath::load(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file) {
+    std::cout << "Failed to open camera path " << filename << std::endl;
+    return false;
+  }
+  keys.clear();
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    std::istringstream stream(line);
+    Key key;
+    if (!(stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >>
+          key.target.z)) {
+      std::cout << filename << ":" << lineNumber << ": expected time px py pz tx ty tz" << std::endl;
+      return false;
+    }
+    if (!keys.empty() && key.time < keys.back().time) {
+      std::cout << filename << ":" << lineNumber << ": keys must be ordered by time" << std::endl;
+      return false;
+    }
+    keys.push_back(key);
+  }
+  if (keys.empty()) std::cout << "Camera path " << filename << " has no keys" << std::endl;
+  return !keys.empty();
+}
+
+void CameraPath::sample(float time, glm::vec3& position, glm::vec3& target) const {
+  auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& key) { return t < key.time; });
+  if (next == keys.begin() || next == keys.end()) {
+    const Key& key = next == keys.begin() ? keys.front() : keys.back();
+    position = key.position;
+    target = key.target;
+    return;
+  }
+  const Key& previous = *(next - 1);
+  float span = next->time - previous.time;
+  float t = span > 0.0f ? (time - previous.time) / span : 1.0f;
+  position = glm::mix(previous.position, next->position, t);
+  target = glm::mix(previous.target, next->target, t);
+}
+
+Benchmark::Benchmark(const BenchmarkOptions& options) : options(options) {}
+
+bool Benchmark::initialize() {
+  if (!options.cameraPath.empty() && !path.load(options.cameraPath)) return false;
+
+  if (!target.resize(options.width, options.height)) return false;
+  frameMs.reserve(options.frames);
+  std::cout << "Benchmark: " << options.frames << " frames at " << options.width << "x" << options.height << ", "
+            << options.timestep * 1000.0 << " ms per frame, camera "
+            << (options.cameraPath.empty() ? "orbit" : options.cameraPath) << std::endl;
+  return true;
+}
+
+void Benchmark::beginFrame(Camera& camera, float time) {
+  glm::vec3 position, lookAt;
+  if (path.empty()) {
+    // One turn around the island over the whole run
+    float angle = glm::two_pi<float>() * frame / options.frames;
+    position = glm::vec3(30.0f * glm::cos(angle), 8.0f, 30.0f * glm::sin(angle));
+    lookAt = glm::vec3(0.0f, 1.0f, 0.0f);
+  } else {
+    path.sample(time, position, lookAt);
+  }
+  camera.setPose(position, lookAt);
+  frameStart = now();
+}
+
+void Benchmark::endFrame() {
+  // Without waiting only the CPU side of the frame would be timed
+  glFinish();
+  frameMs.push_back((now() - frameStart) * 1000.0);
+
+  if (options.checksumEvery > 0 && frame % options.checksumEvery == 0) {
+    std::string imagePath;
+    if (!options.checksumDir.empty()) {
+      std::ostringstream name;
+      name << options.checksumDir << "/frame_" << std::setw(5) << std::setfill('0') << frame << ".ppm";
+      imagePath = name.str();
+    }
+    checksums.emplace_back(frame, checksumFrame(imagePath));
+  }
+  frame++;
+}
+
+uint64_t Benchmark::checksumFrame(const std::string& imagePath) {
+  pixels.resize((size_t)options.width * options.height * 4);
+  glBindFramebuffer(GL_FRAMEBUFFER, target.getFramebuffer());
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  if (!imagePath.empty() && !writePpm(imagePath, pixels, options.width, options.height)) {
+    std::cout << "Failed to write " << imagePath << std::endl;
+  }
+  return fnv1a(pixels.data(), pixels.size());
+}
+
+bool Benchmark::writeStats() const {
+  std::vector<double> sorted = frameMs;
+  std::sort(sorted.begin(), sorted.end());
+  double total = 0.0;
+  for (double ms : sorted) total += ms;
+  double mean = sorted.empty() ? 0.0 : total / sorted.size();
+
+  std::cout << std::fixed << std::setprecision(2) << "Benchmark: " << sorted.size() << " frames, mean " << mean
+            << " ms, p50 " << percentile(sorted, 50) << " ms, p95 " << percentile(sorted, 95) << " ms, p99 "
+            << percentile(sorted, 99) << " ms" << std::defaultfloat << std::endl;
+
+  std::ofstream file(options.statsPath);
+  if (!file) {
+    std::cout << "Failed to write benchmark stats to " << options.statsPath << std::endl;
+    return false;
+  }
+  file << std::fixed << std::setprecision(4);
+  file << "{\n  \"frames\": " << sorted.size() << ",\n  \"width\": " << options.width << ",\n  \"height\": "
+       << options.height << ",\n  \"timestep\": " << options.timestep << ",\n  \"camera\": \""
+       << (options.cameraPath.empty() ? "orbit" : options.cameraPath) << "\",\n  \"seed\": " << options.seed << ",\n";
+  file << "  \"frameMs\": {\"mean\": " << mean << ", \"min\": " << (sorted.empty() ? 0.0 : sorted.front())
+       << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << ", \"p50\": " << percentile(sorted, 50)
+       << ", \"p95\": " << percentile(sorted, 95) << ", \"p99\": " << percentile(sorted, 99) << "},\n";
+  file << "  \"frameTimes\": [";
+  for (size_t i = 0; i < frameMs.size(); i++) file << (i ? ", " : "") << frameMs[i];
+  file << "],\n  \"checksums\": [";
+  for (size_t i = 0; i < checksums.size(); i++) {
+    file << (i ? ", " : "") << "{\"frame\": " << checksums[i].first << ", \"fnv1a\": \"" << std::hex
+         << std::setw(16) << std::setfill('0') << checksums[i].second << std::dec << std::setfill(' ') << "\"}";
+  }
+  file << "]\n}\n";
+  std::cout << "Benchmark stats written to " << options.statsPath << std::endl;
+  return (bool)file;
+}
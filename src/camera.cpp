@@ -73,6 +73,12 @@ void Camera::updateViewMatrix() {
   viewMatrix = glm::lookAt(position, position + front, up);
 }
 
+void Camera::setPose(const glm::vec3& _position, const glm::vec3& target) {
+  position = _position;
+  rotation = glm::quatLookAt(glm::normalize(target - position), glm::vec3(0, 1, 0));
+  updateViewMatrix();
+}
+
 void Camera::updateProjectionMatrix(float aspectRatio) {
   constexpr float FOV = glm::radians(45.0f);
   constexpr float zNear = 0.1f;
@@ -0,0 +1,33 @@
+#include "frame_clock.h"
+
+#include <algorithm>
+#include <cmath>
+
+FrameClock::FrameClock(double fixedStep) : fixedStepNs(std::max<int64_t>(1, std::llround(fixedStep * 1e9))) {}
+
+void FrameClock::tick(double realDeltaTime) {
+  realDeltaTime = std::clamp(realDeltaTime, 0.0, kMaxFrameDelta);
+  int64_t deltaNs = paused ? 0 : std::llround(realDeltaTime * scale * 1e9);
+
+  accumulatorNs += deltaNs;
+  int64_t steps = accumulatorNs / fixedStepNs;
+  accumulatorNs -= steps * fixedStepNs;
+  simulationNs += steps * fixedStepNs;
+
+  double previousTime = snapshot.time;
+  snapshot.frame = ticks++;
+  snapshot.simulationTime = simulationNs * 1e-9;
+  snapshot.alpha = (float)((double)accumulatorNs / fixedStepNs);
+  snapshot.time = (simulationNs + accumulatorNs) * 1e-9;
+  snapshot.deltaTime = std::max(0.0, snapshot.time - previousTime);
+  snapshot.realDeltaTime = realDeltaTime;
+  snapshot.steps = (int)steps;
+}
+
+void FrameClock::seek(double seconds) {
+  int64_t targetNs = std::llround(std::max(0.0, seconds) * 1e9);
+  simulationNs = targetNs - targetNs % fixedStepNs;
+  accumulatorNs = targetNs - simulationNs;
+  // The jump is not a delta, the next frame starts from the new time
+  snapshot.time = targetNs * 1e-9;
+}
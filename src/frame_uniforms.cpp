@@ -0,0 +1,23 @@
+#include "frame_uniforms.h"
+
+#include "gl_state.h"
+
+FrameUniforms::FrameUniforms() {
+  glGenBuffers(1, &buffer);
+  GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+  GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+  GLState::bindBufferBase(GL_UNIFORM_BUFFER, kBindingPoint, buffer);
+}
+
+FrameUniforms::~FrameUniforms() { GLState::deleteBuffers(1, &buffer); }
+
+void FrameUniforms::update(const FrameData& frame) {
+  data = frame;
+  GLState::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+  // Orphan the storage so the previous frame may still read the old values
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+  GLState::countUpload(sizeof(FrameData));
+  GLState::bindBuffer(GL_UNIFORM_BUFFER, 0);
+}
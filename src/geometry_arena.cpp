@@ -0,0 +1,179 @@
+#include "geometry_arena.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "gl_state.h"
+#include "model.h"
+
+FreeListAllocator::FreeListAllocator(GLsizeiptr capacity) : capacity(capacity) {
+  if (capacity > 0) freeBlocks[0] = capacity;
+}
+
+GLsizeiptr FreeListAllocator::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+  for (auto iter = freeBlocks.begin(); iter != freeBlocks.end(); iter++) {
+    GLsizeiptr blockOffset = iter->first;
+    GLsizeiptr blockEnd = iter->first + iter->second;
+    GLsizeiptr offset = (blockOffset + alignment - 1) / alignment * alignment;
+    if (offset + size > blockEnd) continue;
+
+    freeBlocks.erase(iter);
+    if (offset > blockOffset) freeBlocks[blockOffset] = offset - blockOffset;
+    if (offset + size < blockEnd) freeBlocks[offset + size] = blockEnd - (offset + size);
+    used += size;
+    return offset;
+  }
+  return -1;
+}
+
+void FreeListAllocator::free(GLsizeiptr offset, GLsizeiptr size) {
+  if (size <= 0) return;
+  used -= size;
+  auto iter = freeBlocks.emplace(offset, size).first;
+  // Merge with the following block
+  auto next = std::next(iter);
+  if (next != freeBlocks.end() && iter->first + iter->second == next->first) {
+    iter->second += next->second;
+    freeBlocks.erase(next);
+  }
+  // Merge with the preceding block
+  if (iter != freeBlocks.begin()) {
+    auto prev = std::prev(iter);
+    if (prev->first + prev->second == iter->first) {
+      prev->second += iter->second;
+      freeBlocks.erase(iter);
+    }
+  }
+}
+
+GeometryArena::~GeometryArena() {
+  for (Page& page : pages) {
+    for (auto& vao : page.vaos) GLState::deleteVertexArrays(1, &vao.second);
+    GLState::deleteBuffers(1, &page.vertexBuffer);
+    GLState::deleteBuffers(1, &page.indexBuffer);
+  }
+}
+
+int GeometryArena::createPage(GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity) {
+  Page page{0, 0, FreeListAllocator(vertexCapacity), FreeListAllocator(indexCapacity), {}};
+  glGenBuffers(1, &page.vertexBuffer);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, page.vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, vertexCapacity, nullptr, GL_STATIC_DRAW);
+  GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // Element buffer binding is VAO state, make sure we don't modify a bound VAO
+  GLState::bindVertexArray(0);
+  glGenBuffers(1, &page.indexBuffer);
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW);
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  pages.push_back(std::move(page));
+  return (int)pages.size() - 1;
+}
+
+void GeometryArena::upload(Model* model) {
+  if (model->geometry.valid()) release(model);
+
+  std::vector<unsigned char> vertices = packVertices(model);
+  GLsizeiptr stride = vertexStride(model->vertexFormat);
+  GLsizeiptr vertexSize = (GLsizeiptr)vertices.size();
+  GLsizeiptr indexSize = (GLsizeiptr)(sizeof(GLuint) * model->indices.size());
+
+  // Vertex offsets must be a multiple of the stride to be addressable by base vertex
+  GeometryAllocation allocation;
+  for (int i = 0; i < (int)pages.size() && !allocation.valid(); i++) {
+    GLsizeiptr vertexOffset = pages[i].vertexAllocator.allocate(vertexSize, stride);
+    if (vertexOffset < 0) continue;
+    GLsizeiptr indexOffset = pages[i].indexAllocator.allocate(indexSize, sizeof(GLuint));
+    if (indexOffset < 0) {
+      pages[i].vertexAllocator.free(vertexOffset, vertexSize);
+      continue;
+    }
+    allocation.page = i;
+    allocation.vertexOffset = vertexOffset;
+    allocation.indexOffset = indexOffset;
+  }
+  if (!allocation.valid()) {
+    int page = createPage(std::max(kVertexPageSize, vertexSize), std::max(kIndexPageSize, indexSize));
+    allocation.page = page;
+    allocation.vertexOffset = pages[page].vertexAllocator.allocate(vertexSize, stride);
+    allocation.indexOffset = pages[page].indexAllocator.allocate(indexSize, sizeof(GLuint));
+  }
+  allocation.vertexSize = vertexSize;
+  allocation.indexSize = indexSize;
+  allocation.baseVertex = (GLint)(allocation.vertexOffset / stride);
+  allocation.firstIndex = (GLuint)(allocation.indexOffset / sizeof(GLuint));
+
+  Page& page = pages[allocation.page];
+  GLState::bindBuffer(GL_ARRAY_BUFFER, page.vertexBuffer);
+  glBufferSubData(GL_ARRAY_BUFFER, allocation.vertexOffset, vertexSize, vertices.data());
+  GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+  GLState::bindVertexArray(0);
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.indexBuffer);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, allocation.indexOffset, indexSize, model->indices.data());
+  GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  GLState::countUpload(vertexSize + indexSize);
+
+  // Every page shares one VAO per vertex format, offsets come from the draw call
+  if (page.vaos.find(model->vertexFormat) == page.vaos.end()) {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    GLState::bindVertexArray(vao);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, page.vertexBuffer);
+    setupVertexAttributes(model->vertexFormat);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.indexBuffer);
+    GLState::bindVertexArray(0);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+    page.vaos[model->vertexFormat] = vao;
+  }
+  model->geometry = allocation;
+}
+
+void GeometryArena::release(Model* model) {
+  GeometryAllocation& allocation = model->geometry;
+  if (!allocation.valid()) return;
+  pages[allocation.page].vertexAllocator.free(allocation.vertexOffset, allocation.vertexSize);
+  pages[allocation.page].indexAllocator.free(allocation.indexOffset, allocation.indexSize);
+  allocation = GeometryAllocation();
+}
+
+GLuint GeometryArena::vertexArray(const Model* model) const {
+  if (!model->geometry.valid()) return 0;
+  const std::map<VertexFormat, GLuint>& vaos = pages[model->geometry.page].vaos;
+  auto iter = vaos.find(model->vertexFormat);
+  return iter == vaos.end() ? 0 : iter->second;
+}
+
+void GeometryArena::bind(const Model* model) {
+  GLState::bindVertexArray(pages[model->geometry.page].vaos[model->vertexFormat]);
+}
+
+void GeometryArena::draw(const Model* model, int lod) {
+  if (!model->geometry.valid()) return;
+  bind(model);
+  drawBound(model, lod);
+}
+
+void GeometryArena::drawBound(const Model* model, int lod) {
+  const GeometryAllocation& allocation = model->geometry;
+  if (!allocation.valid()) return;
+  GLuint firstIndex = allocation.firstIndex;
+  GLsizei count = model->numIndex;
+  if (lod > 0 && lod < (int)model->lods.size()) {
+    firstIndex += model->lods[lod].firstIndex;
+    count = model->lods[lod].numIndex;
+  }
+  GLState::drawElementsBaseVertex(model->drawMode, count, firstIndex, allocation.baseVertex);
+}
+
+void GeometryArena::printStats() const {
+  GLsizeiptr vertexUsed = 0, indexUsed = 0, capacity = 0;
+  for (const Page& page : pages) {
+    vertexUsed += page.vertexAllocator.getUsed();
+    indexUsed += page.indexAllocator.getUsed();
+    capacity += page.vertexAllocator.getCapacity() + page.indexAllocator.getCapacity();
+  }
+  std::cout << "Geometry arena: " << pages.size() << " page(s), " << vertexUsed / 1024 << " KB vertex + "
+            << indexUsed / 1024 << " KB index data in " << capacity / 1024 << " KB of buffers" << std::endl;
+}
@@ -1,4 +1,5 @@
 #include "gl_helper.h"
+#include "gl_state.h"
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -26,50 +27,47 @@ GLuint quickCreateProgram(const char* vert_shader_filename, const char* frag_sha
 }
 
 GLuint createShader(const char* filename, GLenum type) {
-  // Read shader code
-  char* buffer = 0;
-  long length;
+  std::string source;
+  if (!readShaderFile(filename, source)) return 0;
+  return compileShader(source.c_str(), type, filename);
+}
+
+bool readShaderFile(const char* filename, std::string& source) {
   std::ifstream infile(filename, std::ios::binary);
   if (!infile.is_open()) {
     std::cout << "Open file fail: " << filename << std::endl;
-    return 0;
+    return false;
   }
   infile.seekg(0, std::ios::end);
-  length = (long)infile.tellg();
+  source.resize((size_t)infile.tellg());
   infile.seekg(0, std::ios::beg);
-  buffer = (char*)malloc(length + 1);
-  buffer[length] = 0;
-  if (buffer == NULL) {
-    std::cout << "Allocate memory fail" << std::endl;
-    infile.close();
-    return 0;
-  }
-  infile.read(buffer, length);
-  infile.close();
+  infile.read(source.data(), source.size());
+  return true;
+}
 
-  // Compile shader
+GLuint compileShader(const char* source, GLenum type, const char* name) {
   int success;
   GLuint shader = glCreateShader(type);
-  glShaderSource(shader, 1, (const GLchar**)&buffer, 0);
+  glShaderSource(shader, 1, (const GLchar**)&source, 0);
   glCompileShader(shader);
   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
   if (!success) {
     char infoLog[512];
     glGetShaderInfoLog(shader, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    std::cout << "ERROR::SHADER::COMPILATION_FAILED " << name << "\n" << infoLog << std::endl;
     glDeleteShader(shader);
     shader = 0;
   };
-
-  free(buffer);
   return shader;
 }
 
-GLuint createProgram(GLuint vert, GLuint frag) {
+GLuint createProgram(GLuint vert, GLuint frag, bool retrievable) {
   // shader Program
   GLuint prog = glCreateProgram();
   glAttachShader(prog, vert);
   glAttachShader(prog, frag);
+  // Must be set before linking for glGetProgramBinary to work
+  if (retrievable) glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glLinkProgram(prog);
   // print linking errors if any
   int success;
@@ -98,14 +96,15 @@ GLuint createTexture(const char* filename) {
   }
 
   glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
+  GLState::bindTexture(GL_TEXTURE_2D, texture);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+  GLState::countUpload((size_t)width * height * 3);
   glGenerateMipmap(GL_TEXTURE_2D);
-  glBindTexture(GL_TEXTURE_2D, 0);
+  GLState::bindTexture(GL_TEXTURE_2D, 0);
 
   stbi_image_free(data);
 
@@ -0,0 +1,242 @@
+#include "gl_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+GLuint GLState::program = GLState::kUnknown;
+GLuint GLState::vertexArray = GLState::kUnknown;
+GLuint GLState::activeUnit = GLState::kUnknown;
+GLuint GLState::textures[GLState::kTextureUnits][GLState::kTextureTargets];
+GLuint GLState::buffers[GLState::kBufferTargets];
+int GLState::enabled[3] = {-1, -1, -1};
+GLenum GLState::blendSource = GLState::kUnknown;
+GLenum GLState::blendDestination = GLState::kUnknown;
+GLenum GLState::depthFunction = GLState::kUnknown;
+GLFrameStats GLState::current;
+GLFrameStats GLState::last;
+GLFrameStats GLState::interval;
+uint64_t GLState::intervalFrames = 0;
+double GLState::intervalStart = -1.0;
+
+namespace {
+double now() { return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+int capabilitySlot(GLenum capability) {
+  switch (capability) {
+    case GL_BLEND:
+      return 0;
+    case GL_DEPTH_TEST:
+      return 1;
+    case GL_CULL_FACE:
+      return 2;
+    default:
+      return -1;
+  }
+}
+}  // namespace
+
+int GLState::textureSlot(GLenum target) {
+  switch (target) {
+    case GL_TEXTURE_2D:
+      return 0;
+    case GL_TEXTURE_2D_ARRAY:
+      return 1;
+    case GL_TEXTURE_CUBE_MAP:
+      return 2;
+    default:
+      return -1;
+  }
+}
+
+int GLState::bufferSlot(GLenum target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER:
+      return 0;
+    case GL_ELEMENT_ARRAY_BUFFER:
+      return 1;
+    case GL_PIXEL_UNPACK_BUFFER:
+      return 2;
+    case GL_UNIFORM_BUFFER:
+      return 3;
+    default:
+      return -1;
+  }
+}
+
+void GLState::useProgram(GLuint id) {
+  if (id == program) {
+    current.elidedCalls++;
+    return;
+  }
+  glUseProgram(id);
+  program = id;
+  current.programBinds++;
+}
+
+void GLState::bindVertexArray(GLuint id) {
+  if (id == vertexArray) {
+    current.elidedCalls++;
+    return;
+  }
+  glBindVertexArray(id);
+  vertexArray = id;
+  // The element array binding belongs to the VAO
+  buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = kUnknown;
+  current.vertexArrayBinds++;
+}
+
+void GLState::bindTexture(int unit, GLenum target, GLuint texture) {
+  int slot = textureSlot(target);
+  if (slot >= 0 && unit < kTextureUnits && textures[unit][slot] == texture) {
+    current.elidedCalls++;
+    return;
+  }
+  if ((GLuint)unit != activeUnit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+    current.stateChanges++;
+  }
+  glBindTexture(target, texture);
+  if (slot >= 0 && unit < kTextureUnits) textures[unit][slot] = texture;
+  current.textureBinds++;
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture) {
+  if (activeUnit == kUnknown) {
+    // Which binding changes is unknown, so nothing on any unit can be trusted
+    glBindTexture(target, texture);
+    for (auto& unit : textures) std::fill(std::begin(unit), std::end(unit), kUnknown);
+    current.textureBinds++;
+    return;
+  }
+  bindTexture((int)activeUnit, target, texture);
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+  int slot = bufferSlot(target);
+  if (slot >= 0 && buffers[slot] == buffer) {
+    current.elidedCalls++;
+    return;
+  }
+  glBindBuffer(target, buffer);
+  if (slot >= 0) buffers[slot] = buffer;
+  current.bufferBinds++;
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+  // Also binds the generic binding point of target
+  glBindBufferBase(target, index, buffer);
+  int slot = bufferSlot(target);
+  if (slot >= 0) buffers[slot] = buffer;
+  current.bufferBinds++;
+}
+
+void GLState::setEnabled(GLenum capability, bool enable) {
+  int slot = capabilitySlot(capability);
+  if (slot >= 0 && enabled[slot] == (int)enable) {
+    current.elidedCalls++;
+    return;
+  }
+  if (enable) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+  if (slot >= 0) enabled[slot] = enable;
+  current.stateChanges++;
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination) {
+  if (source == blendSource && destination == blendDestination) {
+    current.elidedCalls++;
+    return;
+  }
+  glBlendFunc(source, destination);
+  blendSource = source;
+  blendDestination = destination;
+  current.stateChanges++;
+}
+
+void GLState::depthFunc(GLenum function) {
+  if (function == depthFunction) {
+    current.elidedCalls++;
+    return;
+  }
+  glDepthFunc(function);
+  depthFunction = function;
+  current.stateChanges++;
+}
+
+void GLState::deleteTextures(GLsizei count, const GLuint* ids) {
+  glDeleteTextures(count, ids);
+  // Deleted textures are unbound from every unit, and their names may be reused
+  for (GLsizei i = 0; i < count; i++) {
+    for (auto& unit : textures) std::replace(std::begin(unit), std::end(unit), ids[i], 0u);
+  }
+}
+
+void GLState::deleteBuffers(GLsizei count, const GLuint* ids) {
+  glDeleteBuffers(count, ids);
+  for (GLsizei i = 0; i < count; i++) std::replace(std::begin(buffers), std::end(buffers), ids[i], 0u);
+}
+
+void GLState::deleteVertexArrays(GLsizei count, const GLuint* ids) {
+  glDeleteVertexArrays(count, ids);
+  for (GLsizei i = 0; i < count; i++) {
+    if (ids[i] == vertexArray) vertexArray = 0;
+  }
+}
+
+void GLState::drawElementsBaseVertex(GLenum mode, GLsizei count, GLuint firstIndex, GLint baseVertex) {
+  glDrawElementsBaseVertex(mode, count, GL_UNSIGNED_INT, (void*)(firstIndex * sizeof(GLuint)), baseVertex);
+  current.drawCalls++;
+  if (mode == GL_TRIANGLES) {
+    current.triangles += count / 3;
+  } else if (mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) {
+    current.triangles += std::max(count - 2, 0);
+  }
+}
+
+void GLState::countUpload(size_t bytes) {
+  current.uploads++;
+  current.uploadBytes += bytes;
+}
+
+void GLState::invalidate() {
+  program = vertexArray = activeUnit = kUnknown;
+  for (auto& unit : textures) std::fill(std::begin(unit), std::end(unit), kUnknown);
+  std::fill(std::begin(buffers), std::end(buffers), kUnknown);
+  std::fill(std::begin(enabled), std::end(enabled), -1);
+  blendSource = blendDestination = depthFunction = kUnknown;
+}
+
+void GLState::endFrame() {
+  last = current;
+  current = GLFrameStats();
+  interval.drawCalls += last.drawCalls;
+  interval.triangles += last.triangles;
+  interval.programBinds += last.programBinds;
+  interval.vertexArrayBinds += last.vertexArrayBinds;
+  interval.textureBinds += last.textureBinds;
+  interval.bufferBinds += last.bufferBinds;
+  interval.stateChanges += last.stateChanges;
+  interval.uploads += last.uploads;
+  interval.uploadBytes += last.uploadBytes;
+  interval.elidedCalls += last.elidedCalls;
+  intervalFrames++;
+
+  double time = now();
+  if (intervalStart < 0.0) intervalStart = time;
+  if (time - intervalStart < kLogInterval) return;
+  auto perFrame = [&](uint64_t count) { return count / intervalFrames; };
+  std::cout << "GL per frame: " << perFrame(interval.drawCalls) << " draws, " << perFrame(interval.triangles)
+            << " triangles, " << perFrame(interval.programBinds) << " program / "
+            << perFrame(interval.vertexArrayBinds) << " VAO / " << perFrame(interval.textureBinds) << " texture / "
+            << perFrame(interval.bufferBinds) << " buffer binds, " << perFrame(interval.stateChanges)
+            << " state changes, " << perFrame(interval.uploads) << " uploads (" << perFrame(interval.uploadBytes) / 1024
+            << " KB), " << perFrame(interval.elidedCalls) << " calls elided" << std::endl;
+  interval = GLFrameStats();
+  intervalFrames = 0;
+  intervalStart = time;
+}
@@ -0,0 +1,67 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(int workerCount) {
+  if (workerCount <= 0) workerCount = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+  for (int i = 0; i < workerCount; i++) workers.emplace_back(&JobSystem::workerLoop, this);
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& worker : workers) worker.join();
+}
+
+void JobSystem::parallelFor(size_t count, size_t slices, const std::function<void(size_t, size_t)>& fn) {
+  slices = std::min(slices, count);
+  if (slices <= 1 || workers.empty()) {
+    if (count > 0) fn(0, count);
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    // A worker that woke late for the last pass may still be leaving it
+    done.wait(lock, [this] { return active == 0; });
+    job = &fn;
+    this->count = count;
+    this->slices = slices;
+    nextSlice = 0;
+    slicesDone = 0;
+    pass++;
+  }
+  wake.notify_all();
+  runSlices();
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return slicesDone == this->slices; });
+  job = nullptr;
+}
+
+void JobSystem::workerLoop() {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || pass != seen; });
+      if (stopping) return;
+      seen = pass;
+      active++;
+    }
+    runSlices();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--active == 0) done.notify_all();
+  }
+}
+
+void JobSystem::runSlices() {
+  while (true) {
+    size_t slice = nextSlice.fetch_add(1);
+    if (slice >= slices) return;
+    (*job)(count * slice / slices, count * (slice + 1) / slices);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (++slicesDone == slices) done.notify_all();
+  }
+}
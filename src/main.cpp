@@ -1,6 +1,9 @@
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <GLFW/glfw3.h>
@@ -10,21 +13,34 @@
 #include <glm/glm.hpp>
 
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
+#include "benchmark.h"
 #include "camera.h"
 #include "context.h"
 #include "gl_helper.h"
+#include "gl_state.h"
+#include "mesh_normals.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
 #include "model.h"
+#include "occlusion_culler.h"
 #include "opengl_context.h"
+#include "profiler.h"
 #include "program.h"
+#include "program_cache.h"
+#include "quality_governor.h"
+#include "render_target.h"
+#include "shadow_cascades.h"
 #include "utils.h"
 
 #include <fftw3.h>
 #include <complex>
+#include <map>
 #include <glm/gtc/noise.hpp>
 #include <random>
 
-void initOpenGL();
+void initOpenGL(bool headless);
 void resizeCallback(GLFWwindow* window, int width, int height);
 void keyCallback(GLFWwindow* window, int key, int, int action, int);
 
@@ -39,10 +55,20 @@ const int oceanWidth = 128;
 const int oceanHeight = 128;
 const float gravity = 9.81f;
 std::vector<std::complex<float>> h0(oceanWidth* oceanHeight);
+// Places the plants, seeded with a fixed value by benchmark runs
+std::mt19937 sceneRandom{std::random_device{}()};
+// O shows the occlusion culling counts in the window title
+bool occlusionOverlay = false;
 
 // FFTW plan
 fftwf_plan fftPlan;
 std::vector<float> displacement(oceanWidth* oceanHeight);
+// Size of the FFT run each step, a power of two up to oceanWidth set by the quality governor
+int oceanResolution = oceanWidth;
+// Size the displacement map is allocated with
+int displacementResolution = oceanWidth;
+// Plans of the smaller FFT sizes, made when the governor first picks them
+std::map<int, fftwf_plan> reducedFftPlans;
 
 void initializeFFTResources() {
   fftPlan = fftwf_plan_dft_c2r_2d(oceanHeight, oceanWidth, reinterpret_cast<fftwf_complex*>(h0.data()),
@@ -51,7 +77,22 @@ void initializeFFTResources() {
   fftwf_execute(fftPlan);
 }
 
-void destroyFFTResources() { fftwf_destroy_plan(fftPlan); }
+void destroyFFTResources() {
+  fftwf_destroy_plan(fftPlan);
+  for (auto& entry : reducedFftPlans) fftwf_destroy_plan(entry.second);
+  reducedFftPlans.clear();
+}
+
+fftwf_plan fftPlanFor(int resolution) {
+  if (resolution == oceanWidth) return fftPlan;
+  fftwf_plan& plan = reducedFftPlans[resolution];
+  if (plan == nullptr) {
+    // FFTW_ESTIMATE plans without touching the arrays
+    plan = fftwf_plan_dft_c2r_2d(resolution, resolution, reinterpret_cast<fftwf_complex*>(h0.data()),
+                                 displacement.data(), FFTW_ESTIMATE);
+  }
+  return plan;
+}
 
 float PhillipsSpectrum(float kx, float ky) {
   glm::vec2 windDirection = glm::normalize(glm::vec2(1.0f, 0.0f));  // V
@@ -89,7 +130,7 @@ void initializeWaveSpectrum() {
 
 void createFFTDisplacementMap() {
   glGenTextures(1, &displacementMap);
-  glBindTexture(GL_TEXTURE_2D, displacementMap);
+  GLState::bindTexture(GL_TEXTURE_2D, displacementMap);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -99,24 +140,37 @@ void createFFTDisplacementMap() {
 }
 
 void updateFFTDisplacementMap(float time) {
-  std::vector<std::complex<float>> ht(oceanWidth * oceanHeight);
-
-  for (int y = 0; y < oceanHeight; ++y) {
-    for (int x = 0; x < oceanWidth; ++x) {
-      float kx = (x < oceanWidth / 2) ? (2.0f * M_PI * x / oceanWidth) : (-2.0f * M_PI * (oceanWidth - x) / oceanWidth);
-      float ky =
-          (y < oceanHeight / 2) ? (2.0f * M_PI * y / oceanHeight) : (-2.0f * M_PI * (oceanHeight - y) / oceanHeight);
+  // A smaller FFT keeps the lowest frequencies of the full spectrum, the large
+  // waves, with their full size frequencies and normalization so they look the same
+  int n = oceanResolution;
+  std::vector<std::complex<float>> ht(n * n);
+
+  for (int y = 0; y < n; ++y) {
+    for (int x = 0; x < n; ++x) {
+      int fx = (x < n / 2) ? x : oceanWidth - (n - x);
+      int fy = (y < n / 2) ? y : oceanHeight - (n - y);
+      float kx =
+          (fx < oceanWidth / 2) ? (2.0f * M_PI * fx / oceanWidth) : (-2.0f * M_PI * (oceanWidth - fx) / oceanWidth);
+      float ky = (fy < oceanHeight / 2) ? (2.0f * M_PI * fy / oceanHeight)
+                                        : (-2.0f * M_PI * (oceanHeight - fy) / oceanHeight);
 
       float omega = sqrt(gravity * glm::length(glm::vec2(kx, ky)));
-      ht[y * oceanWidth + x] = h0[y * oceanWidth + x] * exp(std::complex<float>(0, omega * time));
+      ht[y * n + x] = h0[fy * oceanWidth + fx] * exp(std::complex<float>(0, omega * time));
     }
   }
-  fftwf_execute_dft_c2r(fftPlan, (fftwf_complex*)ht.data(), displacement.data());
-  for (size_t i = 0; i < displacement.size(); ++i) {
+  fftwf_execute_dft_c2r(fftPlanFor(n), (fftwf_complex*)ht.data(), displacement.data());
+  for (int i = 0; i < n * n; ++i) {
     displacement[i] /= (oceanWidth * oceanHeight);
   }
-  glBindTexture(GL_TEXTURE_2D, displacementMap);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, oceanWidth, oceanHeight, GL_RED, GL_FLOAT, displacement.data());
+  GLState::bindTexture(GL_TEXTURE_2D, displacementMap);
+  if (n != displacementResolution) {
+    // Linear, repeating sampling covers the same area at any size
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, n, n, 0, GL_RED, GL_FLOAT, displacement.data());
+    displacementResolution = n;
+  } else {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RED, GL_FLOAT, displacement.data());
+  }
+  GLState::countUpload(n * n * sizeof(float));
 }
 
 void loadMaterial() {
@@ -141,6 +195,7 @@ void loadPrograms() {
   ctx.programs.push_back(new LightProgram(&ctx));
   ctx.programs[1]->vertProgramFile = "../assets/shaders/terrain.vert";
   ctx.programs[1]->fragProgramFIle = "../assets/shaders/terrain.frag";
+  ctx.programs[1]->defines.set("SHADOWS");
 
   ctx.programs.push_back(new LightProgram(&ctx));
   ctx.programs[2]->vertProgramFile = "../assets/shaders/ocean.vert";
@@ -149,16 +204,39 @@ void loadPrograms() {
   ctx.programs.push_back(new LightProgram(&ctx));
   ctx.programs[3]->vertProgramFile = "../assets/shaders/grass.vert";
   ctx.programs[3]->fragProgramFIle = "../assets/shaders/grass.frag";
+  ctx.programs[3]->defines.set("SHADOWS");
 
   ctx.programs.push_back(new SkyboxProgram(&ctx));
+  ctx.programs.push_back(new ShadowProgram(&ctx));
 
+  // Every program is submitted before any is waited for, so the driver can
+  // compile them in parallel. Until one is ready its objects are drawn with
+  // ExampleProgram, the only one needed before the first frame.
   for (auto iter = ctx.programs.begin(); iter != ctx.programs.end(); iter++) {
     if (!(*iter)->load()) {
       std::cout << "Load program fail, force terminate" << std::endl;
       exit(1);
     }
   }
-  glUseProgram(0);
+  if (!ctx.programs[0]->poll(true)) {
+    std::cout << "Load program fail, force terminate" << std::endl;
+    exit(1);
+  }
+  GLState::useProgram(0);
+}
+
+// Finish programs the driver is done with. @return true once all are ready
+bool pollPrograms(bool wait) {
+  bool allReady = true;
+  for (Program* program : ctx.programs) {
+    if (program->poll(wait)) continue;
+    if (program->hasFailed()) {
+      std::cout << "Load program fail, force terminate" << std::endl;
+      exit(1);
+    }
+    allReady = false;
+  }
+  return allReady;
 }
 
 std::vector<std::vector<float>> generateHeightMap(int width, int height, float scale) {
@@ -189,9 +267,7 @@ std::vector<std::vector<glm::vec3>> normalMap(77, std::vector<glm::vec3>(77, glm
 
 // HͦmVq
 glm::vec3 generateRandomPosition(float xMin, float xMax, float zMin, float zMax) {
-  // Hƥͦ
-  std::random_device rd;
-  std::mt19937 gen(rd());
+  std::mt19937& gen = sceneRandom;
   std::uniform_real_distribution<float> xDist(xMin, xMax);
   std::uniform_real_distribution<float> zDist(zMin, zMax);
   int x = xDist(gen);
@@ -208,8 +284,7 @@ glm::vec3 generateRandomPosition(float xMin, float xMax, float zMin, float zMax)
 
 // HͦҦVq
 glm::vec3 generateRandomScale(float minScale, float maxScale) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
+  std::mt19937& gen = sceneRandom;
   std::uniform_real_distribution<float> scaleDist(minScale, maxScale);
 
   // CӤqͦH
@@ -220,6 +295,18 @@ glm::vec3 generateRandomScale(float minScale, float maxScale) {
   return glm::vec3(scaleX, scaleY, scaleZ);
 }
 
+// Moss low and flat, stone high and steep. terrain.frag used to evaluate this
+// per pixel, now it is baked into the splat map.
+glm::vec4 islandLayerWeights(const glm::vec3& position, const glm::vec3& normal) {
+  float noise = glm::fract(std::sin(glm::dot(glm::vec2(position.x, position.z), glm::vec2(12.9898f, 78.233f))) *
+                           43758.5453f);
+  float height = position.y + glm::mix(-0.2f, 0.2f, noise);
+  float slopeFactor = glm::clamp(normal.y, 0.8f, 1.5f);
+  float mixFactor = glm::smoothstep(0.6f, 1.5f, height);
+  if (height < 2.5f) mixFactor *= slopeFactor;
+  return glm::vec4(1.0f - mixFactor, mixFactor, 0.0f, 0.0f);
+}
+
 Model* createIsland() {
   Model* m = new Model();
 
@@ -227,153 +314,43 @@ Model* createIsland() {
   int height = 76;
   int scale = 20;
 
-  std::vector<glm::vec3> normalsAccum((width + 1) * (height + 1), glm::vec3(0.0f));
-  std::vector<int> normalCounts((width + 1) * (height + 1), 0);
-
-  // ϥ Perlin nͦ
-  for (int z = height - 1; z >= 0; --z) {
-    for (int x = 0; x < width; ++x) {
+  // One vertex per height map sample, two triangles per cell
+  for (int z = 0; z <= height; ++z) {
+    for (int x = 0; x <= width; ++x) {
       float x1 = x - width / 2;
       float z1 = z - height / 2;
-      float x2 = x1 + 1;
-      float z2 = z1 + 1;
-      float y1 = heightMap[z][x] * scale;
-      float y2 = heightMap[z + 1][x] * scale;
-      float y3 = heightMap[z][x + 1] * scale;
-      float y4 = heightMap[z + 1][x + 1] * scale;
-
       m->positions.push_back(x1);
-      m->positions.push_back(y1);
+      m->positions.push_back(heightMap[z][x] * scale);
       m->positions.push_back(z1);
-      m->positions.push_back(x1);
-      m->positions.push_back(y2);
-      m->positions.push_back(z2);
-      m->positions.push_back(x2);
-      m->positions.push_back(y3);
-      m->positions.push_back(z1);
-
-      m->texcoords.push_back(x1 / (float)width * 10);
-      m->texcoords.push_back(z1 / (float)height * 10);
       m->texcoords.push_back(x1 / (float)width * 10);
-      m->texcoords.push_back(z2 / (float)height * 10);
-      m->texcoords.push_back(x2 / (float)width * 10);
       m->texcoords.push_back(z1 / (float)height * 10);
-
-      m->positions.push_back(x1);
-      m->positions.push_back(y2);
-      m->positions.push_back(z2);
-      m->positions.push_back(x2);
-      m->positions.push_back(y4);
-      m->positions.push_back(z2);
-      m->positions.push_back(x2);
-      m->positions.push_back(y3);
-      m->positions.push_back(z1);
-
-      m->texcoords.push_back(x1 / (float)width * 10);
-      m->texcoords.push_back(z2 / (float)height * 10);
-      m->texcoords.push_back(x2 / (float)width * 10);
-      m->texcoords.push_back(z2 / (float)height * 10);
-      m->texcoords.push_back(x2 / (float)width * 10);
-      m->texcoords.push_back(z1 / (float)height * 10);
-
-      // Ĥ@ӤT
-      glm::vec3 normal1 = glm::cross(glm::vec3(x1 - x1, y1 - y2, z1 - z2), glm::vec3(x1 - x2, y1 - y3, z1 - z1));
-      if (glm::length(normal1) < 0.0001f) {
-        normal1 = glm::vec3(0.0f, 1.0f, 0.0f);
-      } else {
-        normal1 = glm::normalize(normal1);
-      }
-      int index1 = z * width + x;
-      int index2 = (z + 1) * width + x;
-      int index3 = z * width + (x + 1);
-
-      normalsAccum[index1] += normal1;
-      normalsAccum[index2] += normal1;
-      normalsAccum[index3] += normal1;
-
-      normalCounts[index1]++;
-      normalCounts[index2]++;
-      normalCounts[index3]++;
-
-      // ĤGӤT
-      glm::vec3 normal2 = glm::cross(glm::vec3(x1 - x2, y2 - y4, z2 - z2), glm::vec3(x1 - x2, y2 - y3, z2 - z1));
-      if (glm::length(normal2) < 0.0001f) {
-        normal2 = glm::vec3(0.0f, 1.0f, 0.0f);
-      } else {
-        normal2 = glm::normalize(normal2);
-      }
-      normalsAccum[index2] += normal2;
-      normalsAccum[(z + 1) * width + (x + 1)] += normal2;
-      normalsAccum[index3] += normal2;
-
-      normalCounts[index2]++;
-      normalCounts[(z + 1) * width + (x + 1)]++;
-      normalCounts[index3]++;
     }
   }
-
-  for (int z = height - 1; z >= 0; --z) {
+  for (int z = 0; z < height; ++z) {
     for (int x = 0; x < width; ++x) {
-      int index = z * width + x;
-      if (normalCounts[index] > 0) {
-        glm::vec3 averageNormal = glm::normalize(normalsAccum[index] / (float)normalCounts[index]);
-        m->normals.push_back(averageNormal.x);
-        m->normals.push_back(averageNormal.y);
-        m->normals.push_back(averageNormal.z);
-        normalMap[z][x] = averageNormal;
-      }
-      index = (z + 1) * width + x;
-      if (normalCounts[index] > 0) {
-        glm::vec3 averageNormal = glm::normalize(normalsAccum[index] / (float)normalCounts[index]);
-        m->normals.push_back(averageNormal.x);
-        m->normals.push_back(averageNormal.y);
-        m->normals.push_back(averageNormal.z);
-        normalMap[z + 1][x] = averageNormal;
-      }
-      index = z * width + (x + 1);
-      if (normalCounts[index] > 0) {
-        glm::vec3 averageNormal = glm::normalize(normalsAccum[index] / (float)normalCounts[index]);
-        m->normals.push_back(averageNormal.x);
-        m->normals.push_back(averageNormal.y);
-        m->normals.push_back(averageNormal.z);
-        normalMap[z][x + 1] = averageNormal;
-      }
-      index = (z + 1) * width + x;
-      if (normalCounts[index] > 0) {
-        glm::vec3 averageNormal = glm::normalize(normalsAccum[index] / (float)normalCounts[index]);
-        m->normals.push_back(averageNormal.x);
-        m->normals.push_back(averageNormal.y);
-        m->normals.push_back(averageNormal.z);
-        normalMap[z + 1][x] = averageNormal;
-      }
-      index = (z + 1) * width + (x + 1);
-      if (normalCounts[index] > 0) {
-        glm::vec3 averageNormal = glm::normalize(normalsAccum[index] / (float)normalCounts[index]);
-        m->normals.push_back(averageNormal.x);
-        m->normals.push_back(averageNormal.y);
-        m->normals.push_back(averageNormal.z);
-        normalMap[z + 1][x + 1] = averageNormal;
-      }
-      index = z * width + (x + 1);
-      if (normalCounts[index] > 0) {
-        glm::vec3 averageNormal = glm::normalize(normalsAccum[index] / (float)normalCounts[index]);
-        m->normals.push_back(averageNormal.x);
-        m->normals.push_back(averageNormal.y);
-        m->normals.push_back(averageNormal.z);
-        normalMap[z][x + 1] = averageNormal;
-      }
+      GLuint v00 = z * (width + 1) + x;
+      GLuint v01 = (z + 1) * (width + 1) + x;
+      GLuint v10 = z * (width + 1) + (x + 1);
+      GLuint v11 = (z + 1) * (width + 1) + (x + 1);
+      m->indices.insert(m->indices.end(), {v00, v01, v10, v01, v11, v10});
+    }
+  }
+  m->numVertex = m->positions.size() / 3;
+  m->numIndex = m->indices.size();
+  computeNormals(m);
+  for (int z = 0; z <= height; ++z) {
+    for (int x = 0; x <= width; ++x) {
+      int index = z * (width + 1) + x;
+      normalMap[z][x] = glm::vec3(m->normals[index * 3], m->normals[index * 3 + 1], m->normals[index * 3 + 2]);
     }
   }
 
   // ]mҫѼ
-  m->numVertex = m->positions.size() / 3;
   m->drawMode = GL_TRIANGLES;
-  m->textures.push_back(createTexture("../assets/models/terrain/moss.jpg"));
-  m->textures.push_back(createTexture("../assets/models/terrain/stone.jpg"));
-  m->textures.push_back(createTexture("../assets/models/ocean/water.jpg"));
+  // Textured through ctx.terrainMaterial, see islandLayerWeights
   m->modelMatrix = glm::scale(glm::identity<glm::mat4>(), glm::vec3(1, 1, 1));
   // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);  // ҥνuؼҦ
-  // glDisable(GL_CULL_FACE);                    // I簣
+  // GLState::setEnabled(GL_CULL_FACE, false);                    // I簣
 
   return m;
 }
@@ -382,66 +359,35 @@ Model* createOcean(float size, float waterLevel) {
   Model* m = new Model();
 
   // pGaէC0.1Aͦv
-  for (int z = 0; z < size; ++z) {
-    for (int x = 0; x < size; ++x) {
+  int cells = (int)size;
+  for (int z = 0; z <= cells; ++z) {
+    for (int x = 0; x <= cells; ++x) {
       float x1 = x - size / 2;
       float z1 = z - size / 2;
-      float x2 = x1 + 1;
-      float z2 = z1 + 1;
-
       m->positions.push_back(x1);
       m->positions.push_back(waterLevel);
       m->positions.push_back(z1);
-      m->positions.push_back(x1);
-      m->positions.push_back(waterLevel);
-      m->positions.push_back(z2);
-      m->positions.push_back(x2);
-      m->positions.push_back(waterLevel);
-      m->positions.push_back(z1);
-
-      for (int i = 0; i < 3; i++) {
-        m->normals.push_back(0);
-        m->normals.push_back(1);
-        m->normals.push_back(0);
-      }
-
-      m->texcoords.push_back(x1 / (float)size * 10);
-      m->texcoords.push_back(z1 / (float)size * 10);
-      m->texcoords.push_back(x1 / (float)size * 10);
-      m->texcoords.push_back(z2 / (float)size * 10);
-      m->texcoords.push_back(x2 / (float)size * 10);
-      m->texcoords.push_back(z1 / (float)size * 10);
-
-      m->positions.push_back(x1);
-      m->positions.push_back(waterLevel);
-      m->positions.push_back(z2);
-      m->positions.push_back(x2);
-      m->positions.push_back(waterLevel);
-      m->positions.push_back(z2);
-      m->positions.push_back(x2);
-      m->positions.push_back(waterLevel);
-      m->positions.push_back(z1);
-
-      for (int i = 0; i < 3; i++) {
-        m->normals.push_back(0);
-        m->normals.push_back(1);
-        m->normals.push_back(0);
-      }
-
       m->texcoords.push_back(x1 / (float)size * 10);
-      m->texcoords.push_back(z2 / (float)size * 10);
-      m->texcoords.push_back(x2 / (float)size * 10);
-      m->texcoords.push_back(z2 / (float)size * 10);
-      m->texcoords.push_back(x2 / (float)size * 10);
       m->texcoords.push_back(z1 / (float)size * 10);
     }
   }
+  for (int z = 0; z < cells; ++z) {
+    for (int x = 0; x < cells; ++x) {
+      GLuint v00 = z * (cells + 1) + x;
+      GLuint v01 = (z + 1) * (cells + 1) + x;
+      GLuint v10 = z * (cells + 1) + (x + 1);
+      GLuint v11 = (z + 1) * (cells + 1) + (x + 1);
+      m->indices.insert(m->indices.end(), {v00, v01, v10, v01, v11, v10});
+    }
+  }
+  m->numVertex = m->positions.size() / 3;
+  m->numIndex = m->indices.size();
+  computeNormals(m);
 
   // ]mҫѼ
-  m->numVertex = m->positions.size() / 3;
   m->drawMode = GL_TRIANGLES;
-  m->textures.push_back(createTexture("../assets/models/ocean/water.jpg"));
-  m->textures.push_back(createTexture("../assets/models/terrain/moss.jpg"));
+  m->textures.push_back(ctx.textureCache->get("../assets/models/ocean/water.jpg"));
+  m->textures.push_back(ctx.textureCache->get("../assets/models/terrain/moss.jpg"));
 
   return m;
 }
@@ -452,28 +398,66 @@ Model* createPlants() {
     std::cerr << "Error: Failed to load the dice model!" << std::endl;
     return nullptr;
   }
-  GLuint textureID = createTexture("../assets/models/grass/grass.png");
-  if (textureID == 0) {
+  TextureHandle texture = ctx.textureCache->get("../assets/models/grass/grass.png");
+  if (!texture) {
     std::cerr << "Error: Failed to load dice.jpg! Please check the file path or format." << std::endl;
     delete tree;
     return nullptr;
   }
-  tree->textures.push_back(textureID);
+  tree->textures.push_back(texture);
+  // Tangent space normal map, sampled with the tangents built in loadModels
+  tree->textures.push_back(ctx.textureCache->get("../assets/models/grass/agave test_DefaultMaterial_Normal.png",
+                                                 glm::vec4(0.5f, 0.5f, 1.0f, 1.0f)));
   tree->modelMatrix = glm::scale(tree->modelMatrix, glm::vec3(0.6f, 0.6f, 0.6f));
-  tree->drawMode = GL_QUADS;
   return tree;
 }
 
 void loadModels() {
-  ctx.models.push_back(createIsland());
+  ctx.oceanModelIndex = (int)ctx.models.size();
   ctx.models.push_back(createOcean(75, 0.2f));
+  ctx.plantsModelIndex = (int)ctx.models.size();
   ctx.models.push_back(createPlants());
+
+  // Chunks let far parts of the island use a coarser LOD than near ones
+  Model* island = createIsland();
+  optimizeModel(island, "island");
+  std::vector<Model*> chunks = splitModel(island, 4, 4);
+  // About 7 splat texels per world unit across the island
+  glm::vec2 islandMin(island->boundsMin.x, island->boundsMin.z), islandMax(island->boundsMax.x, island->boundsMax.z);
+  ctx.terrainMaterial->createSplatMap(islandMin, islandMax, 512);
+  delete island;
+  ctx.terrainModelBegin = (int)ctx.models.size();
+  ctx.terrainModelCount = (int)chunks.size();
+  ctx.models.insert(ctx.models.end(), chunks.begin(), chunks.end());
+
+  std::vector<std::string> names = {"ocean", "plants"};
+  for (int i = 0; i < ctx.terrainModelCount; i++) names.push_back("terrain chunk " + std::to_string(i));
+  for (size_t i = 0; i < ctx.models.size(); i++) optimizeModel(ctx.models[i], names[i].c_str());
+  computeTangents(ctx.models[ctx.plantsModelIndex]);
+  // The island never changes, so every chunk is baked once
+  for (int i = 0; i < ctx.terrainModelCount; i++) {
+    Model* chunk = ctx.models[ctx.terrainModelBegin + i];
+    ctx.terrainMaterial->bakeChunk(chunk, chunk->modelMatrix, islandLayerWeights);
+  }
+  ctx.terrainMaterial->finishBakes();
+  ctx.terrainMaterial->printStats();
+  // Chunk edges are shared with the neighbouring chunk, moving them would open cracks
+  generateLodsParallel(ctx.models, 4, ctx.terrainModelBegin, ctx.terrainModelBegin + ctx.terrainModelCount);
+
+  for (size_t i = 0; i < ctx.models.size(); i++) {
+    // All current models tolerate 16-bit positions and half float uvs
+    ctx.models[i]->vertexFormat = VertexFormat::Quantized;
+    std::cout << "Vertex buffer " << names[i] << ": " << ctx.models[i]->numVertex * vertexStride(VertexFormat::Float)
+              << " -> " << ctx.models[i]->numVertex * vertexStride(ctx.models[i]->vertexFormat) << " bytes"
+              << std::endl;
+    ctx.geometryArena->upload(ctx.models[i]);
+  }
 }
 
 void setupObjects() {
-  Object* terrainObject = new Object(0, glm::mat4(1.0f));
-  terrainObject->programId = ctx.terrainProgramIndex;
-  ctx.objects.push_back(terrainObject);
+  for (int i = 0; i < ctx.terrainModelCount; i++) {
+    ctx.scene.create(ctx.terrainModelBegin + i, ctx.terrainProgramIndex, glm::mat4(1.0f));
+  }
 
   float xMin = 13.0f, xMax = 63.0f;
   float zMin = 13.0f, zMax = 63.0f;
@@ -493,29 +477,107 @@ void setupObjects() {
     glm::vec3 adjustedPosition = position - 0.03f * islandNormal;
     glm::mat4 translationMatrix = glm::translate(glm::mat4(1.0f), adjustedPosition);
     glm::mat4 modelMatrix = glm::scale(translationMatrix * rotationMatrix, scale);
-    Object* plantsObject = new Object(2, modelMatrix);
-    plantsObject->programId = ctx.plantsProgramIndex;
-    ctx.objects.push_back(plantsObject);
+    ctx.scene.create(ctx.plantsModelIndex, ctx.plantsProgramIndex, modelMatrix);
+  }
+
+  ctx.scene.create(ctx.oceanModelIndex, ctx.OceanProgramIndex, glm::mat4(1.0f));
+}
+
+// Bounds of everything that casts a shadow, the terrain and the plants
+void shadowCasterBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) {
+  boundsMin = glm::vec3(1e30f);
+  boundsMax = glm::vec3(-1e30f);
+  const std::vector<int>& programIndices = ctx.scene.getProgramIndices();
+  for (size_t i = 0; i < ctx.scene.size(); i++) {
+    if (programIndices[i] == ctx.OceanProgramIndex) continue;
+    boundsMin = glm::min(boundsMin, ctx.scene.getBoundsMin()[i]);
+    boundsMax = glm::max(boundsMax, ctx.scene.getBoundsMax()[i]);
   }
+}
 
-  Object* oceanObject = new Object(1, glm::mat4(1.0f));
-  oceanObject->programId = ctx.OceanProgramIndex;
-  ctx.objects.push_back(oceanObject);
+// Camera and sun shared by every program this frame. The sun circles the
+// island at 10 degrees per second, its color and the ambient light come from
+// the atmosphere tables.
+FrameData buildFrameData(const Camera& camera, float time) {
+  float sunAngle = glm::radians(time * 10.0f);
+  glm::vec3 sunDirection = glm::normalize(glm::vec3(cos(sunAngle), sin(sunAngle), 0.0f));
+  AtmosphereLight light = ctx.atmosphere->light(sunDirection);
+
+  FrameData frame{};
+  frame.projection = glm::make_mat4(camera.getProjectionMatrix());
+  frame.view = glm::make_mat4(camera.getViewMatrix());
+  frame.viewPosition = glm::vec4(glm::make_vec3(camera.getPosition()), 1.0f);
+  frame.sunDirection = glm::vec4(sunDirection, 0.0f);
+  frame.sunColor = glm::vec4(light.sunColor, 1.0f);
+  frame.ambientColor = glm::vec4(light.ambientColor, 1.0f);
+  frame.time = time;
+  return frame;
 }
 
-int main() {
-  initOpenGL();
+int main(int argc, char** argv) {
+  BenchmarkOptions benchmarkOptions;
+  if (!benchmarkOptions.parse(argc, argv)) return 1;
+  if (benchmarkOptions.enabled) sceneRandom.seed(benchmarkOptions.seed);
+  initOpenGL(benchmarkOptions.enabled);
 
   GLFWwindow* window = OpenGLContext::getWindow();
   glfwSetWindowTitle(window, "Final Project");
 
   // Init Camera helper
   Camera camera(glm::vec3(0, 2, 5));
-  camera.initialize(OpenGLContext::getAspectRatio());
+  Benchmark benchmark(benchmarkOptions);
+  camera.initialize(benchmarkOptions.enabled ? benchmark.getAspectRatio() : OpenGLContext::getAspectRatio());
   // Store camera as glfw global variable for callbacks use
   glfwSetWindowUserPointer(window, &camera);
   ctx.camera = &camera;
   ctx.window = window;
+  // Owned here so its buffers are released while the GL context is alive
+  GeometryArena geometryArena;
+  ctx.geometryArena = &geometryArena;
+  TextureLoader textureLoader;
+  ctx.textureLoader = &textureLoader;
+  TextureCache textureCache(&textureLoader);
+  ctx.textureCache = &textureCache;
+  // Before any texture is queued, it decides which levels load up front
+  TextureStreamer textureStreamer(&textureLoader);
+  ctx.textureStreamer = &textureStreamer;
+  // Layer order is what islandLayerWeights and terrain.frag expect
+  TerrainMaterial terrainMaterial(&textureCache, {"../assets/models/terrain/moss.jpg",
+                                                  "../assets/models/terrain/stone.jpg",
+                                                  "../assets/models/ocean/water.jpg"});
+  ctx.terrainMaterial = &terrainMaterial;
+  // Benchmark runs step the simulation exactly once per frame
+  FrameClock frameClock(benchmarkOptions.enabled ? benchmarkOptions.timestep : 1.0 / 60.0);
+  ctx.frameClock = &frameClock;
+  FrameUniforms frameUniforms;
+  ctx.frameUniforms = &frameUniforms;
+  // Integrates the sky on worker threads while the scene loads
+  Atmosphere atmosphere;
+  ctx.atmosphere = &atmosphere;
+  atmosphere.start("../assets/cache");
+  RenderQueue renderQueue;
+  ProgramCache programCache("../assets/cache");
+  ctx.programCache = &programCache;
+  ctx.renderQueue = &renderQueue;
+  // Started once, the per frame passes of the scene and the culler share its workers
+  JobSystem jobSystem;
+  ctx.scene.setJobSystem(&jobSystem);
+  OcclusionCuller occlusionCuller(&jobSystem);
+  ctx.occlusionCuller = &occlusionCuller;
+  // The scene is drawn here and scaled up when rendered below full resolution
+  RenderTarget sceneTarget;
+  float renderScale = 1.0f;
+  // One refresh interval. Step costs are first guesses, the governor refines
+  // them from what each change measures.
+  QualityGovernor qualityGovernor(1000.0 / OpenGLContext::getRefreshRate());
+  ctx.qualityGovernor = &qualityGovernor;
+  qualityGovernor.addKnob("render scale", {1.0f, 0.85f, 0.7f, 0.5f}, 2.0, [&](float v) { renderScale = v; });
+  qualityGovernor.addKnob("ocean FFT resolution", {128.0f, 64.0f, 32.0f}, 0.5,
+                          [](float v) { oceanResolution = (int)v; });
+  qualityGovernor.addKnob("terrain LOD error", {1.0f, 2.0f, 4.0f}, 0.5, [](float v) { ctx.lodErrorThreshold = v; });
+  qualityGovernor.addKnob("vegetation density", {1.0f, 0.5f, 0.25f}, 0.3, [](float v) { ctx.plantDensity = v; });
+  // Benchmarks measure one fixed quality
+  if (benchmarkOptions.enabled) qualityGovernor.setEnabled(false);
 
   createFFTDisplacementMap();
   initializeWaveSpectrum();
@@ -524,18 +586,102 @@ int main() {
   loadModels();
   loadPrograms();
   setupObjects();
+  ctx.scene.updateTransforms();
+  atmosphere.finish();
+  glm::vec3 casterMin, casterMax;
+  shadowCasterBounds(casterMin, casterMax);
+  ShadowCascades shadowCascades(casterMin, casterMax);
+  ctx.shadowCascades = &shadowCascades;
+  geometryArena.printStats();
+  std::cout << "Startup took " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+
+  // HW2_TRACE=file.json records the whole run as a Chrome trace
+  const char* tracePath = std::getenv("HW2_TRACE");
+  if (tracePath) {
+    PROFILE_START_CAPTURE();
+  }
+
+  // --benchmark renders a fixed number of frames offscreen with a fixed timestep
+  if (benchmarkOptions.enabled) {
+    if (!benchmark.initialize()) return 1;
+    textureLoader.finish();
+    pollPrograms(true);
+  }
+  // Checksums only match between runs if streaming finishes within the frame
+  bool syncStreaming = benchmarkOptions.enabled && benchmarkOptions.checksumEvery > 0;
 
   // Main rendering loop
-  while (!glfwWindowShouldClose(window)) {
+  bool texturesReported = false;
+  bool programsReported = false;
+  double overlayUpdate = 0.0;
+  double lastFrameStart = glfwGetTime();
+  // Time the ocean was last sampled at, none yet
+  double oceanTime = -1.0;
+  while (!glfwWindowShouldClose(window) && !(benchmarkOptions.enabled && benchmark.finished())) {
+    PROFILE_BEGIN_FRAME();
+    // The only place time is sampled, everything else reads frameClock.now()
+    double frameStart = glfwGetTime();
+    frameClock.tick(benchmarkOptions.enabled ? benchmarkOptions.timestep : frameStart - lastFrameStart);
+    lastFrameStart = frameStart;
+    const FrameTime& frameTime = frameClock.now();
     // Polling events.
     glfwPollEvents();
     // Update camera position and view
-    camera.move(window);
+    if (benchmarkOptions.enabled) {
+      benchmark.beginFrame(camera, (float)frameTime.time);
+    } else {
+      PROFILE_SCOPE("camera.move");
+      camera.move(window);
+    }
+    // Make decoded textures resident without stalling the frame, then stream
+    // mip levels for what the last frame drew
+    {
+      PROFILE_SCOPE("Texture streaming");
+      textureLoader.update(2.0);
+      textureStreamer.update();
+      if (syncStreaming) textureLoader.finish();
+    }
+    if (!texturesReported && textureLoader.idle()) {
+      texturesReported = true;
+      textureCache.printReport();
+    }
+    if (!programsReported && pollPrograms(false)) {
+      programsReported = true;
+      programCache.printReport();
+    }
+    // The waves are a closed form of time, so they are sampled at the render
+    // time of every frame that moves it instead of stepping at the fixed rate
+    if (frameTime.time != oceanTime) {
+      PROFILE_GPU_SCOPE("updateFFTDisplacementMap");
+      oceanTime = frameTime.time;
+      updateFFTDisplacementMap((float)oceanTime);
+    }
+    frameUniforms.update(buildFrameData(camera, (float)frameTime.time));
+    // Only objects moved since the last frame are recomputed
+    ctx.scene.updateTransforms();
+    {
+      PROFILE_GPU_SCOPE("ShadowProgram");
+      ctx.programs[5]->doMainLoop();
+    }
+    // Render at renderScale of the output, the window or the benchmark target
+    GLuint outputFramebuffer = benchmarkOptions.enabled ? benchmark.getTarget().getFramebuffer() : 0;
+    int outputWidth = benchmarkOptions.enabled ? benchmarkOptions.width : OpenGLContext::getWidth();
+    int outputHeight = benchmarkOptions.enabled ? benchmarkOptions.height : OpenGLContext::getHeight();
+    bool scaled = renderScale < 1.0f &&
+                  sceneTarget.resize(std::max(1, (int)(outputWidth * renderScale)),
+                                     std::max(1, (int)(outputHeight * renderScale)));
+    if (scaled) {
+      sceneTarget.bind();
+    } else {
+      glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+      glViewport(0, 0, outputWidth, outputHeight);
+    }
+    ctx.renderHeight = scaled ? sceneTarget.getHeight() : outputHeight;
     // GL_XXX_BIT can simply "OR" together to use.
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     /// TO DO Enable DepthTest
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
+    GLState::setEnabled(GL_DEPTH_TEST, true);
+    GLState::depthFunc(GL_LEQUAL);
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT);
     glClearDepth(1.0f);
@@ -543,15 +689,56 @@ int main() {
     ctx.spotLightDirection = glm::normalize(glm::vec3(3, 0.3, 3) - ctx.spotLightPosition);
     ctx.pointLightPosition = glm::vec3(6 * glm::cos(glm::radians(ctx._pointLightPosisionDegree)), 3.0f,
                                        6 * glm::sin(glm::radians(ctx._pointLightPosisionDegree)));
-    updateFFTDisplacementMap(glfwGetTime());
-    ctx.programs[1]->doMainLoop();
-    ctx.programs[4]->doMainLoop();
+    {
+      PROFILE_GPU_SCOPE("LightProgram");
+      ctx.programs[1]->doMainLoop();
+    }
+    {
+      PROFILE_GPU_SCOPE("SkyboxProgram");
+      ctx.programs[4]->doMainLoop();
+    }
+    if (scaled) sceneTarget.blitTo(outputFramebuffer, outputWidth, outputHeight);
+    if (occlusionOverlay && frameStart - overlayUpdate > 0.25) {
+      overlayUpdate = frameStart;
+      std::ostringstream title;
+      title.setf(std::ios::fixed);
+      title.precision(2);
+      title << "Final Project | occlusion: " << occlusionCuller.getCulled() << " of " << occlusionCuller.getTested()
+            << " culled, " << occlusionCuller.getMilliseconds() << " ms";
+      glfwSetWindowTitle(window, title.str().c_str());
+    }
 
+    GLState::endFrame();
+    // Work of the frame without the wait for vsync in glfwSwapBuffers. CPU and
+    // GPU overlap, so the slower of the two bounds the frame; the GPU time is
+    // that of a frame or two ago, whose queries have finished.
+    qualityGovernor.addFrame(std::max((glfwGetTime() - frameStart) * 1000.0, PROFILE_GPU_FRAME_MS()));
+    if (benchmarkOptions.enabled) {
+      benchmark.endFrame();
+      PROFILE_END_FRAME();
+      continue;
+    }
 #ifdef __APPLE__
     // Some platform need explicit glFlush
     glFlush();
 #endif
-    glfwSwapBuffers(window);
+    {
+      PROFILE_SCOPE("glfwSwapBuffers");
+      glfwSwapBuffers(window);
+    }
+    PROFILE_END_FRAME();
+  }
+  // Models hold texture handles, they go before the texture cache does
+  for (Model* model : ctx.models) delete model;
+  for (Program* program : ctx.programs) delete program;
+  ctx.models.clear();
+  ctx.programs.clear();
+  if (benchmarkOptions.enabled && !benchmark.writeStats()) return 1;
+  textureStreamer.printReport();
+  shadowCascades.printReport();
+  PROFILE_REPORT();
+  if (tracePath) {
+    PROFILE_WRITE_TRACE(tracePath);
   }
   return 0;
 }
@@ -575,6 +762,26 @@ void keyCallback(GLFWwindow* window, int key, int, int action, int) {
         }
         break;
       }
+      // Time controls: pause, slower, faster, back to the start
+      case GLFW_KEY_P:
+        ctx.frameClock->setPaused(!ctx.frameClock->isPaused());
+        break;
+      case GLFW_KEY_LEFT_BRACKET:
+        ctx.frameClock->setScale(ctx.frameClock->getScale() * 0.5);
+        break;
+      case GLFW_KEY_RIGHT_BRACKET:
+        ctx.frameClock->setScale(ctx.frameClock->getScale() * 2.0);
+        break;
+      case GLFW_KEY_HOME:
+        ctx.frameClock->seek(0.0);
+        break;
+      case GLFW_KEY_G:
+        ctx.qualityGovernor->setEnabled(!ctx.qualityGovernor->isEnabled());
+        break;
+      case GLFW_KEY_O:
+        occlusionOverlay = !occlusionOverlay;
+        if (!occlusionOverlay) glfwSetWindowTitle(window, "Final Project");
+        break;
       default:
         break;
     }
@@ -589,19 +796,19 @@ void resizeCallback(GLFWwindow* window, int width, int height) {
   }
 }
 
-void initOpenGL() {
+void initOpenGL(bool headless) {
   // Initialize OpenGL context, details are wrapped in class.
 #ifdef __APPLE__
   // MacOS need explicit request legacy support
-  OpenGLContext::createContext(21, GLFW_OPENGL_ANY_PROFILE);
+  OpenGLContext::createContext(21, GLFW_OPENGL_ANY_PROFILE, headless);
 #else
-  OpenGLContext::createContext(21, GLFW_OPENGL_ANY_PROFILE);
+  OpenGLContext::createContext(21, GLFW_OPENGL_ANY_PROFILE, headless);
 //  OpenGLContext::createContext(43, GLFW_OPENGL_COMPAT_PROFILE);
 #endif
   GLFWwindow* window = OpenGLContext::getWindow();
   glfwSetKeyCallback(window, keyCallback);
   glfwSetFramebufferSizeCallback(window, resizeCallback);
-  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+  if (!headless) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 #ifndef NDEBUG
   OpenGLContext::printSystemInfo();
   // This is useful if you want to debug your OpenGL API calls.
@@ -0,0 +1,209 @@
+#include "mesh_normals.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "model.h"
+
+namespace {
+// Below this many triangles per worker starting a thread costs more than it saves
+constexpr size_t kMinTrianglesPerWorker = 16384;
+
+int workerCount(size_t triangles) {
+  size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+  return (int)std::clamp(triangles / kMinTrianglesPerWorker, (size_t)1, hardware);
+}
+
+// Call fn(begin, end, worker) for `workers` contiguous slices of [0, count)
+template <typename Fn>
+void parallelFor(size_t count, int workers, Fn fn) {
+  if (workers <= 1) {
+    fn((size_t)0, count, 0);
+    return;
+  }
+  std::vector<std::future<void>> jobs;
+  for (int w = 0; w < workers; w++) {
+    jobs.push_back(std::async(std::launch::async, fn, count * w / workers, count * (w + 1) / workers, w));
+  }
+  for (std::future<void>& job : jobs) job.get();
+}
+
+// Every worker accumulates into its own array, so no atomics are needed.
+// The arrays are then summed into partial[0], split over vertex ranges.
+template <typename T>
+void reduce(std::vector<std::vector<T>>& partial) {
+  int workers = (int)partial.size();
+  parallelFor(partial[0].size(), workers, [&partial](size_t begin, size_t end, int) {
+    for (size_t w = 1; w < partial.size(); w++) {
+      for (size_t i = begin; i < end; i++) partial[0][i] += partial[w][i];
+    }
+  });
+}
+
+std::vector<GLuint> triangleList(const Model* model) {
+  std::vector<GLuint> corners = model->indices;
+  if (corners.empty()) {
+    corners.resize(model->numVertex);
+    std::iota(corners.begin(), corners.end(), 0);
+  }
+  corners.resize(corners.size() / 3 * 3);
+  return corners;
+}
+
+glm::vec3 load3(const std::vector<float>& stream, GLuint index) {
+  return glm::vec3(stream[index * 3], stream[index * 3 + 1], stream[index * 3 + 2]);
+}
+
+glm::vec2 load2(const std::vector<float>& stream, GLuint index) {
+  return glm::vec2(stream[index * 2], stream[index * 2 + 1]);
+}
+
+// Angle between b - a and c - a
+float cornerAngle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+  glm::vec3 u = b - a, v = c - a;
+  float lengths = glm::length(u) * glm::length(v);
+  if (lengths <= 0.0f) return 0.0f;
+  return std::acos(glm::clamp(glm::dot(u, v) / lengths, -1.0f, 1.0f));
+}
+
+// Map every vertex to the first vertex with the same position
+std::vector<GLuint> weldPositions(const std::vector<float>& positions, int numVertex) {
+  std::vector<GLuint> order(numVertex);
+  std::iota(order.begin(), order.end(), 0);
+  auto key = [&positions](GLuint v) {
+    return std::make_tuple(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+  };
+  std::sort(order.begin(), order.end(), [&key](GLuint a, GLuint b) { return key(a) < key(b); });
+
+  std::vector<GLuint> canonical(numVertex);
+  for (size_t i = 0; i < order.size(); i++) {
+    bool same = i > 0 && key(order[i]) == key(order[i - 1]);
+    canonical[order[i]] = same ? canonical[order[i - 1]] : order[i];
+  }
+  return canonical;
+}
+
+struct TangentSum {
+  glm::vec3 tangent = glm::vec3(0.0f);
+  glm::vec3 bitangent = glm::vec3(0.0f);
+
+  TangentSum& operator+=(const TangentSum& other) {
+    tangent += other.tangent;
+    bitangent += other.bitangent;
+    return *this;
+  }
+};
+
+// Remove the component of v along the unit vector n
+glm::vec3 projectOnPlane(const glm::vec3& v, const glm::vec3& n) { return v - n * glm::dot(n, v); }
+
+// Any unit vector perpendicular to n
+glm::vec3 perpendicular(const glm::vec3& n) {
+  glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+  return glm::normalize(glm::cross(n, axis));
+}
+}  // namespace
+
+void computeNormals(Model* model, NormalWeighting weighting) {
+  std::vector<GLuint> corners = triangleList(model);
+  std::vector<GLuint> canonical = weldPositions(model->positions, model->numVertex);
+  size_t numTriangle = corners.size() / 3;
+  int workers = workerCount(numTriangle);
+
+  std::vector<std::vector<glm::vec3>> partial(workers);
+  parallelFor(numTriangle, workers, [&](size_t begin, size_t end, int worker) {
+    std::vector<glm::vec3>& sums = partial[worker];
+    sums.assign(model->numVertex, glm::vec3(0.0f));
+    for (size_t t = begin; t < end; t++) {
+      GLuint v[3] = {corners[t * 3], corners[t * 3 + 1], corners[t * 3 + 2]};
+      glm::vec3 p[3] = {load3(model->positions, v[0]), load3(model->positions, v[1]),
+                        load3(model->positions, v[2])};
+      // Length of the cross product is twice the triangle area
+      glm::vec3 faceNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+      float doubleArea = glm::length(faceNormal);
+      if (doubleArea <= 0.0f) continue;
+      for (int j = 0; j < 3; j++) {
+        glm::vec3 contribution = faceNormal;
+        if (weighting == NormalWeighting::Angle) {
+          contribution *= cornerAngle(p[j], p[(j + 1) % 3], p[(j + 2) % 3]) / doubleArea;
+        }
+        sums[canonical[v[j]]] += contribution;
+      }
+    }
+  });
+  reduce(partial);
+
+  const std::vector<glm::vec3>& sums = partial[0];
+  model->normals.resize(model->numVertex * 3);
+  for (int i = 0; i < model->numVertex; i++) {
+    glm::vec3 sum = sums[canonical[i]];
+    glm::vec3 n = glm::length(sum) > 0.0f ? glm::normalize(sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+    model->normals[i * 3] = n.x;
+    model->normals[i * 3 + 1] = n.y;
+    model->normals[i * 3 + 2] = n.z;
+  }
+}
+
+void computeTangents(Model* model) {
+  if (model->normals.empty() || model->texcoords.empty()) {
+    std::cout << "computeTangents: model needs normals and texcoords" << std::endl;
+    return;
+  }
+  std::vector<GLuint> corners = triangleList(model);
+  size_t numTriangle = corners.size() / 3;
+  int workers = workerCount(numTriangle);
+
+  std::vector<std::vector<TangentSum>> partial(workers);
+  parallelFor(numTriangle, workers, [&](size_t begin, size_t end, int worker) {
+    std::vector<TangentSum>& sums = partial[worker];
+    sums.assign(model->numVertex, TangentSum());
+    for (size_t t = begin; t < end; t++) {
+      GLuint v[3] = {corners[t * 3], corners[t * 3 + 1], corners[t * 3 + 2]};
+      glm::vec3 p[3] = {load3(model->positions, v[0]), load3(model->positions, v[1]),
+                        load3(model->positions, v[2])};
+      glm::vec2 uv[3] = {load2(model->texcoords, v[0]), load2(model->texcoords, v[1]),
+                         load2(model->texcoords, v[2])};
+      glm::vec3 e1 = p[1] - p[0], e2 = p[2] - p[0];
+      glm::vec2 d1 = uv[1] - uv[0], d2 = uv[2] - uv[0];
+      // Only the sign of the uv area matters, the directions are normalized per corner
+      float uvArea = d1.x * d2.y - d2.x * d1.y;
+      if (uvArea == 0.0f) continue;
+      float orientation = uvArea > 0.0f ? 1.0f : -1.0f;
+      glm::vec3 faceTangent = (e1 * d2.y - e2 * d1.y) * orientation;
+      glm::vec3 faceBitangent = (e2 * d1.x - e1 * d2.x) * orientation;
+
+      // Like MikkTSpace, project onto each vertex's tangent plane and weight by corner angle
+      for (int j = 0; j < 3; j++) {
+        glm::vec3 n = load3(model->normals, v[j]);
+        glm::vec3 tangent = projectOnPlane(faceTangent, n);
+        glm::vec3 bitangent = projectOnPlane(faceBitangent, n);
+        if (glm::length(tangent) <= 0.0f || glm::length(bitangent) <= 0.0f) continue;
+        float angle = cornerAngle(p[j], p[(j + 1) % 3], p[(j + 2) % 3]);
+        sums[v[j]].tangent += glm::normalize(tangent) * angle;
+        sums[v[j]].bitangent += glm::normalize(bitangent) * angle;
+      }
+    }
+  });
+  reduce(partial);
+
+  const std::vector<TangentSum>& sums = partial[0];
+  model->tangents.resize(model->numVertex * 4);
+  for (int i = 0; i < model->numVertex; i++) {
+    glm::vec3 n = load3(model->normals, i);
+    glm::vec3 tangent = projectOnPlane(sums[i].tangent, n);
+    tangent = glm::length(tangent) > 0.0f ? glm::normalize(tangent) : perpendicular(n);
+    float handedness = glm::dot(glm::cross(n, tangent), sums[i].bitangent) < 0.0f ? -1.0f : 1.0f;
+    model->tangents[i * 4] = tangent.x;
+    model->tangents[i * 4 + 1] = tangent.y;
+    model->tangents[i * 4 + 2] = tangent.z;
+    model->tangents[i * 4 + 3] = handedness;
+  }
+}
@@ -0,0 +1,427 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+#include "model.h"
+
+namespace {
+// Number of floats each attribute stream contributes to a vertex
+struct VertexLayout {
+  int positionSize;
+  int normalSize;
+  int texcoordSize;
+  int tangentSize;
+};
+
+VertexLayout layoutOf(const Model* model) {
+  VertexLayout layout{3, 0, 0, 0};
+  if (!model->normals.empty()) layout.normalSize = 3;
+  if (!model->texcoords.empty()) layout.texcoordSize = 2;
+  if (!model->tangents.empty()) layout.tangentSize = 4;
+  return layout;
+}
+
+bool sameFloats(const float* a, const float* b, int count) {
+  return count == 0 || std::memcmp(a, b, sizeof(float) * count) == 0;
+}
+
+uint32_t hashFloats(uint32_t hash, const float* data, int count) {
+  // FNV-1a over the raw bit pattern, so the comparison stays exact
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < sizeof(float) * count; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool sameVertex(const Model* model, const VertexLayout& layout, GLuint a, GLuint b) {
+  return sameFloats(&model->positions[a * layout.positionSize], &model->positions[b * layout.positionSize],
+                    layout.positionSize) &&
+         sameFloats(layout.normalSize ? &model->normals[a * layout.normalSize] : nullptr,
+                    layout.normalSize ? &model->normals[b * layout.normalSize] : nullptr, layout.normalSize) &&
+         sameFloats(layout.texcoordSize ? &model->texcoords[a * layout.texcoordSize] : nullptr,
+                    layout.texcoordSize ? &model->texcoords[b * layout.texcoordSize] : nullptr, layout.texcoordSize) &&
+         sameFloats(layout.tangentSize ? &model->tangents[a * layout.tangentSize] : nullptr,
+                    layout.tangentSize ? &model->tangents[b * layout.tangentSize] : nullptr, layout.tangentSize);
+}
+
+// Copy vertex attributes so that new vertex i comes from old vertex source[i]
+void gatherVertices(Model* model, const VertexLayout& layout, const std::vector<GLuint>& source) {
+  auto gather = [&source](std::vector<float>& stream, int size) {
+    if (size == 0) return;
+    std::vector<float> result(source.size() * size);
+    for (size_t i = 0; i < source.size(); i++) {
+      std::copy_n(&stream[source[i] * size], size, &result[i * size]);
+    }
+    stream.swap(result);
+  };
+  gather(model->positions, layout.positionSize);
+  gather(model->normals, layout.normalSize);
+  gather(model->texcoords, layout.texcoordSize);
+  gather(model->tangents, layout.tangentSize);
+  model->numVertex = (int)source.size();
+}
+
+glm::vec3 positionOf(const std::vector<float>& positions, GLuint index) {
+  return glm::vec3(positions[index * 3], positions[index * 3 + 1], positions[index * 3 + 2]);
+}
+}  // namespace
+
+void triangulateModel(Model* model) {
+  std::vector<GLuint> corners = model->indices;
+  if (corners.empty()) {
+    corners.resize(model->numVertex);
+    std::iota(corners.begin(), corners.end(), 0);
+  }
+
+  std::vector<GLuint> triangles;
+  switch (model->drawMode) {
+    case GL_TRIANGLES:
+      triangles.swap(corners);
+      triangles.resize(triangles.size() / 3 * 3);
+      break;
+    case GL_QUADS:
+      triangles.reserve(corners.size() / 4 * 6);
+      for (size_t i = 0; i + 3 < corners.size(); i += 4) {
+        triangles.insert(triangles.end(), {corners[i], corners[i + 1], corners[i + 2]});
+        triangles.insert(triangles.end(), {corners[i], corners[i + 2], corners[i + 3]});
+      }
+      break;
+    case GL_TRIANGLE_STRIP:
+      for (size_t i = 2; i < corners.size(); i++) {
+        GLuint a = corners[i - 2], b = corners[i - 1], c = corners[i];
+        if (a == b || b == c || a == c) continue;
+        // Every other triangle in a strip has flipped winding
+        if (i % 2 == 0) {
+          triangles.insert(triangles.end(), {a, b, c});
+        } else {
+          triangles.insert(triangles.end(), {b, a, c});
+        }
+      }
+      break;
+    case GL_TRIANGLE_FAN:
+      for (size_t i = 2; i < corners.size(); i++) {
+        triangles.insert(triangles.end(), {corners[0], corners[i - 1], corners[i]});
+      }
+      break;
+    default:
+      std::cout << "triangulateModel: unsupported draw mode " << model->drawMode << std::endl;
+      return;
+  }
+  model->indices.swap(triangles);
+  model->numIndex = (int)model->indices.size();
+  model->drawMode = GL_TRIANGLES;
+}
+
+void deduplicateVertices(Model* model) {
+  VertexLayout layout = layoutOf(model);
+  size_t tableSize = 1;
+  while (tableSize < (size_t)model->numVertex * 2) tableSize <<= 1;
+
+  // Open addressing table of unique source vertices
+  constexpr GLuint empty = ~0u;
+  std::vector<GLuint> table(tableSize, empty);
+  std::vector<GLuint> remap(model->numVertex, empty);
+  std::vector<GLuint> unique;
+
+  for (GLuint v : model->indices) {
+    if (remap[v] != empty) continue;
+    uint32_t hash = 2166136261u;
+    hash = hashFloats(hash, &model->positions[v * layout.positionSize], layout.positionSize);
+    if (layout.normalSize) hash = hashFloats(hash, &model->normals[v * layout.normalSize], layout.normalSize);
+    if (layout.texcoordSize) hash = hashFloats(hash, &model->texcoords[v * layout.texcoordSize], layout.texcoordSize);
+
+    size_t slot = hash & (tableSize - 1);
+    while (table[slot] != empty && !sameVertex(model, layout, unique[table[slot]], v)) {
+      slot = (slot + 1) & (tableSize - 1);
+    }
+    if (table[slot] == empty) {
+      table[slot] = (GLuint)unique.size();
+      unique.push_back(v);
+    }
+    remap[v] = table[slot];
+  }
+
+  for (GLuint& index : model->indices) index = remap[index];
+  gatherVertices(model, layout, unique);
+}
+
+void optimizeVertexCache(std::vector<GLuint>& indices, int numVertex, int cacheSize, std::vector<GLuint>* clusters) {
+  size_t numTriangle = indices.size() / 3;
+  if (numTriangle == 0) return;
+
+  // Vertex to triangle adjacency in compressed row form
+  std::vector<GLuint> offsets(numVertex + 1, 0);
+  for (GLuint v : indices) offsets[v + 1]++;
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<GLuint> adjacency(indices.size());
+  std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = (GLuint)(i / 3);
+
+  std::vector<int> liveTriangles(numVertex);
+  for (int v = 0; v < numVertex; v++) liveTriangles[v] = (int)(offsets[v + 1] - offsets[v]);
+  std::vector<int> cacheTime(numVertex, 0);
+  std::vector<char> emitted(numTriangle, 0);
+  std::vector<GLuint> deadEnd;
+  std::vector<GLuint> candidates;
+  std::vector<GLuint> result;
+  result.reserve(indices.size());
+
+  int timestamp = cacheSize + 1;
+  int cursor = 0;
+  int fanning = 0;
+  bool hardBoundary = true;
+  if (clusters) clusters->clear();
+
+  while (fanning >= 0) {
+    candidates.clear();
+    for (GLuint k = offsets[fanning]; k < offsets[fanning + 1]; k++) {
+      GLuint t = adjacency[k];
+      if (emitted[t]) continue;
+      if (clusters && hardBoundary) clusters->push_back((GLuint)(result.size() / 3));
+      hardBoundary = false;
+      for (int j = 0; j < 3; j++) {
+        GLuint v = indices[t * 3 + j];
+        result.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        liveTriangles[v]--;
+        if (timestamp - cacheTime[v] > cacheSize) cacheTime[v] = timestamp++;
+      }
+      emitted[t] = 1;
+    }
+
+    // Prefer the candidate that will still be in cache after emitting its fan
+    int best = -1, bestPriority = -1;
+    for (GLuint v : candidates) {
+      if (liveTriangles[v] <= 0) continue;
+      int priority = 0;
+      if (timestamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) priority = timestamp - cacheTime[v];
+      if (priority > bestPriority) {
+        best = (int)v;
+        bestPriority = priority;
+      }
+    }
+    if (best < 0) {
+      // Dead end: fall back to recently used vertices, then to input order
+      hardBoundary = true;
+      while (!deadEnd.empty() && best < 0) {
+        GLuint v = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveTriangles[v] > 0) best = (int)v;
+      }
+      while (best < 0 && cursor < numVertex) {
+        if (liveTriangles[cursor] > 0) best = cursor;
+        cursor++;
+      }
+    }
+    fanning = best;
+  }
+  indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<GLuint>& clusters,
+                      const std::vector<float>& positions) {
+  GLuint numTriangle = (GLuint)(indices.size() / 3);
+  if (clusters.empty() || numTriangle == 0) return;
+
+  // Split hard clusters further where the local ACMR is close to the cluster
+  // ACMR, so reordering them costs at most ~5% of vertex cache efficiency
+  constexpr float threshold = 1.05f;
+  std::vector<GLuint> boundaries;
+  std::vector<int> cacheTime(positions.size() / 3, -kVertexCacheSize);
+  int counter = 0;
+  // Cache misses of one triangle; advancing counter by the cache size flushes it
+  auto triangleMisses = [&](GLuint t) {
+    int misses = 0;
+    for (int j = 0; j < 3; j++) {
+      GLuint v = indices[t * 3 + j];
+      if (counter - cacheTime[v] >= kVertexCacheSize) {
+        cacheTime[v] = counter++;
+        misses++;
+      }
+    }
+    return misses;
+  };
+  for (size_t c = 0; c < clusters.size(); c++) {
+    GLuint begin = clusters[c];
+    GLuint end = c + 1 < clusters.size() ? clusters[c + 1] : numTriangle;
+    int clusterMisses = 0;
+    counter += kVertexCacheSize;
+    for (GLuint t = begin; t < end; t++) clusterMisses += triangleMisses(t);
+    float clusterACMR = (float)clusterMisses / (end - begin);
+
+    boundaries.push_back(begin);
+    int misses = 0;
+    GLuint start = begin;
+    counter += kVertexCacheSize;
+    for (GLuint t = begin; t < end; t++) {
+      misses += triangleMisses(t);
+      if (t + 1 < end && (float)misses / (t - start + 1) <= clusterACMR * threshold) {
+        boundaries.push_back(t + 1);
+        start = t + 1;
+        misses = 0;
+        // Each sub cluster starts with a cold cache after sorting
+        counter += kVertexCacheSize;
+      }
+    }
+  }
+
+  // Area weighted centroid and normal of each cluster, and of the whole mesh
+  struct ClusterInfo {
+    GLuint begin, end;
+    float sortKey;
+    glm::vec3 centroid, normal;
+    float area;
+  };
+  std::vector<ClusterInfo> infos;
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+  for (size_t c = 0; c < boundaries.size(); c++) {
+    ClusterInfo info{boundaries[c], c + 1 < boundaries.size() ? boundaries[c + 1] : numTriangle, 0.0f,
+                     glm::vec3(0.0f), glm::vec3(0.0f), 0.0f};
+    for (GLuint t = info.begin; t < info.end; t++) {
+      glm::vec3 p0 = positionOf(positions, indices[t * 3]);
+      glm::vec3 p1 = positionOf(positions, indices[t * 3 + 1]);
+      glm::vec3 p2 = positionOf(positions, indices[t * 3 + 2]);
+      glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      float area = glm::length(n);
+      info.centroid += (p0 + p1 + p2) * (area / 3.0f);
+      info.normal += n;
+      info.area += area;
+    }
+    meshCentroid += info.centroid;
+    meshArea += info.area;
+    if (info.area > 0.0f) info.centroid /= info.area;
+    infos.push_back(info);
+  }
+  if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+  for (ClusterInfo& info : infos) {
+    float length = glm::length(info.normal);
+    info.sortKey = length > 0.0f ? glm::dot(info.centroid - meshCentroid, info.normal / length) : 0.0f;
+  }
+  // Clusters facing away from the center are likely occluders, draw them first
+  std::stable_sort(infos.begin(), infos.end(),
+                   [](const ClusterInfo& a, const ClusterInfo& b) { return a.sortKey > b.sortKey; });
+
+  std::vector<GLuint> result;
+  result.reserve(indices.size());
+  for (const ClusterInfo& info : infos) {
+    result.insert(result.end(), indices.begin() + info.begin * 3, indices.begin() + info.end * 3);
+  }
+  indices.swap(result);
+}
+
+void optimizeVertexFetch(Model* model) {
+  constexpr GLuint unused = ~0u;
+  std::vector<GLuint> remap(model->numVertex, unused);
+  std::vector<GLuint> order;
+  order.reserve(model->numVertex);
+  for (GLuint& index : model->indices) {
+    if (remap[index] == unused) {
+      remap[index] = (GLuint)order.size();
+      order.push_back(index);
+    }
+    index = remap[index];
+  }
+  gatherVertices(model, layoutOf(model), order);
+}
+
+float computeACMR(const std::vector<GLuint>& indices, int numVertex, int cacheSize) {
+  if (indices.size() < 3) return 0.0f;
+  std::vector<int> cacheTime(numVertex, -cacheSize);
+  int counter = 0;
+  int misses = 0;
+  for (GLuint v : indices) {
+    if (counter - cacheTime[v] >= cacheSize) {
+      cacheTime[v] = counter++;
+      misses++;
+    }
+  }
+  return (float)misses / (indices.size() / 3);
+}
+
+void optimizeModel(Model* model, const char* name) {
+  triangulateModel(model);
+  int verticesBefore = model->numVertex;
+  float acmrBefore = computeACMR(model->indices, model->numVertex);
+
+  deduplicateVertices(model);
+  std::vector<GLuint> clusters;
+  optimizeVertexCache(model->indices, model->numVertex, kVertexCacheSize, &clusters);
+  optimizeOverdraw(model->indices, clusters, model->positions);
+  optimizeVertexFetch(model);
+  model->numIndex = (int)model->indices.size();
+
+  for (int i = 0; i < model->numVertex; i++) {
+    glm::vec3 p = positionOf(model->positions, i);
+    model->boundsMin = i == 0 ? p : glm::min(model->boundsMin, p);
+    model->boundsMax = i == 0 ? p : glm::max(model->boundsMax, p);
+  }
+
+  float acmrAfter = computeACMR(model->indices, model->numVertex);
+  std::cout << "Optimized mesh " << name << ": " << model->numIndex / 3 << " triangles, " << verticesBefore << " -> "
+            << model->numVertex << " vertices, ACMR " << std::fixed << std::setprecision(3) << acmrBefore << " -> "
+            << acmrAfter << std::defaultfloat << std::endl;
+}
+
+std::vector<Model*> splitModel(const Model* model, int chunksX, int chunksZ) {
+  glm::vec3 minBound = model->boundsMin, size = model->boundsMax - model->boundsMin;
+  auto cellOf = [&](float value, float origin, float extent, int cells) {
+    int cell = extent > 0.0f ? (int)((value - origin) / extent * cells) : 0;
+    return std::min(std::max(cell, 0), cells - 1);
+  };
+
+  std::vector<std::vector<GLuint>> cellTriangles(chunksX * chunksZ);
+  for (int t = 0; t < model->numIndex / 3; t++) {
+    glm::vec3 centroid = (positionOf(model->positions, model->indices[t * 3]) +
+                          positionOf(model->positions, model->indices[t * 3 + 1]) +
+                          positionOf(model->positions, model->indices[t * 3 + 2])) /
+                         3.0f;
+    int x = cellOf(centroid.x, minBound.x, size.x, chunksX);
+    int z = cellOf(centroid.z, minBound.z, size.z, chunksZ);
+    cellTriangles[z * chunksX + x].push_back(t);
+  }
+
+  VertexLayout layout = layoutOf(model);
+  std::vector<Model*> chunks;
+  for (const std::vector<GLuint>& triangles : cellTriangles) {
+    if (triangles.empty()) continue;
+    Model* chunk = new Model();
+    chunk->modelMatrix = model->modelMatrix;
+    chunk->drawMode = model->drawMode;
+    chunk->vertexFormat = model->vertexFormat;
+    chunk->textures = model->textures;
+
+    constexpr GLuint unused = ~0u;
+    std::vector<GLuint> remap(model->numVertex, unused);
+    std::vector<GLuint> source;
+    for (GLuint t : triangles) {
+      for (int j = 0; j < 3; j++) {
+        GLuint v = model->indices[t * 3 + j];
+        if (remap[v] == unused) {
+          remap[v] = (GLuint)source.size();
+          source.push_back(v);
+        }
+        chunk->indices.push_back(remap[v]);
+      }
+    }
+    chunk->positions = model->positions;
+    chunk->normals = model->normals;
+    chunk->texcoords = model->texcoords;
+    chunk->tangents = model->tangents;
+    gatherVertices(chunk, layout, source);
+    chunk->numIndex = (int)chunk->indices.size();
+    chunks.push_back(chunk);
+  }
+  return chunks;
+}
@@ -0,0 +1,309 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <unordered_set>
+
+#include "mesh_optimizer.h"
+#include "model.h"
+
+namespace {
+enum class VertexKind : unsigned char {
+  // Interior vertex, can collapse onto any neighbor
+  Manifold,
+  // On an open edge, can only collapse along that edge
+  Border,
+  // UV seam, non-manifold corner or locked border, never moves
+  Locked,
+};
+
+// Border edges pull the error up strongly so outlines are preserved
+constexpr double kBorderWeight = 10.0;
+
+struct Vec3d {
+  double x, y, z;
+};
+
+Vec3d operator-(const Vec3d& a, const Vec3d& b) { return Vec3d{a.x - b.x, a.y - b.y, a.z - b.z}; }
+
+Vec3d cross(const Vec3d& a, const Vec3d& b) {
+  return Vec3d{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+double dot(const Vec3d& a, const Vec3d& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+double length(const Vec3d& a) { return std::sqrt(dot(a, a)); }
+
+Vec3d scaled(const Vec3d& a, double s) { return Vec3d{a.x * s, a.y * s, a.z * s}; }
+
+// Sum of weighted squared distances to a set of planes, Q(p) = p'Ap + 2b'p + c
+struct Quadric {
+  double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+  double b0 = 0, b1 = 0, b2 = 0, c = 0;
+  double weight = 0;
+
+  void addPlane(const Vec3d& n, double d, double w) {
+    a00 += w * n.x * n.x;
+    a11 += w * n.y * n.y;
+    a22 += w * n.z * n.z;
+    a01 += w * n.x * n.y;
+    a02 += w * n.x * n.z;
+    a12 += w * n.y * n.z;
+    b0 += w * n.x * d;
+    b1 += w * n.y * d;
+    b2 += w * n.z * d;
+    c += w * d * d;
+    weight += w;
+  }
+
+  void add(const Quadric& q) {
+    a00 += q.a00, a11 += q.a11, a22 += q.a22, a01 += q.a01, a02 += q.a02, a12 += q.a12;
+    b0 += q.b0, b1 += q.b1, b2 += q.b2, c += q.c;
+    weight += q.weight;
+  }
+
+  // Weighted mean squared distance of p to the planes
+  double evaluate(const Vec3d& p) const {
+    double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+               2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+               2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+    return weight > 0.0 ? std::abs(r) / weight : 0.0;
+  }
+};
+
+struct Collapse {
+  GLuint from, to;
+  double cost;
+};
+
+uint64_t edgeKey(GLuint a, GLuint b) { return (uint64_t)a << 32 | b; }
+
+Vec3d positionOf(const std::vector<float>& positions, GLuint v) {
+  return Vec3d{positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]};
+}
+
+Vec3d triangleNormal(const Vec3d& p0, const Vec3d& p1, const Vec3d& p2) { return cross(p1 - p0, p2 - p0); }
+
+// Vertices sharing a position but not attributes are seams; map each vertex
+// to the first vertex with the same position
+std::vector<GLuint> findPositionIds(const std::vector<float>& positions, int numVertex) {
+  std::vector<GLuint> order(numVertex);
+  std::iota(order.begin(), order.end(), 0);
+  auto less = [&positions](GLuint a, GLuint b) { return std::memcmp(&positions[a * 3], &positions[b * 3], 12) < 0; };
+  std::sort(order.begin(), order.end(), less);
+
+  std::vector<GLuint> ids(numVertex);
+  for (int i = 0; i < numVertex; i++) {
+    bool same = i > 0 && std::memcmp(&positions[order[i] * 3], &positions[order[i - 1] * 3], 12) == 0;
+    ids[order[i]] = same ? ids[order[i - 1]] : order[i];
+  }
+  return ids;
+}
+}  // namespace
+
+std::vector<GLuint> simplifyMesh(const std::vector<float>& positions, const std::vector<GLuint>& indices,
+                                 size_t targetIndexCount, float maxError, float* resultError, bool lockBorders) {
+  int numVertex = (int)positions.size() / 3;
+  std::vector<GLuint> result = indices;
+  std::vector<GLuint> positionIds = findPositionIds(positions, numVertex);
+
+  // Classify vertices
+  std::vector<VertexKind> kinds(numVertex, VertexKind::Manifold);
+  std::vector<int> groupSize(numVertex, 0);
+  for (int v = 0; v < numVertex; v++) groupSize[positionIds[v]]++;
+  std::unordered_set<uint64_t> directedEdges;
+  for (size_t i = 0; i < result.size(); i += 3) {
+    for (int e = 0; e < 3; e++) {
+      directedEdges.insert(edgeKey(positionIds[result[i + e]], positionIds[result[i + (e + 1) % 3]]));
+    }
+  }
+  std::unordered_set<uint64_t> borderEdges;
+  std::vector<int> borderCount(numVertex, 0);
+  for (uint64_t key : directedEdges) {
+    GLuint a = (GLuint)(key >> 32), b = (GLuint)key;
+    if (directedEdges.count(edgeKey(b, a))) continue;
+    borderEdges.insert(key);
+    borderCount[a]++;
+    borderCount[b]++;
+  }
+  for (int v = 0; v < numVertex; v++) {
+    GLuint id = positionIds[v];
+    if (groupSize[id] > 1 || borderCount[id] > 2 || (lockBorders && borderCount[id] > 0)) {
+      kinds[v] = VertexKind::Locked;
+    } else if (borderCount[id] > 0) {
+      kinds[v] = VertexKind::Border;
+    }
+  }
+  auto isBorderEdge = [&](GLuint a, GLuint b) {
+    return borderEdges.count(edgeKey(positionIds[a], positionIds[b])) ||
+           borderEdges.count(edgeKey(positionIds[b], positionIds[a]));
+  };
+
+  // Area weighted plane quadrics, plus planes perpendicular to border edges
+  std::vector<Quadric> quadrics(numVertex);
+  for (size_t i = 0; i + 2 < result.size(); i += 3) {
+    GLuint corner[3] = {result[i], result[i + 1], result[i + 2]};
+    Vec3d p[3] = {positionOf(positions, corner[0]), positionOf(positions, corner[1]), positionOf(positions, corner[2])};
+    Vec3d n = triangleNormal(p[0], p[1], p[2]);
+    double area = length(n);
+    if (area <= 0.0) continue;
+    n = scaled(n, 1.0 / area);
+    for (GLuint v : corner) quadrics[v].addPlane(n, -dot(n, p[0]), area * 0.5);
+
+    for (int e = 0; e < 3; e++) {
+      GLuint a = corner[e], b = corner[(e + 1) % 3];
+      if (!borderEdges.count(edgeKey(positionIds[a], positionIds[b]))) continue;
+      Vec3d edge = p[(e + 1) % 3] - p[e];
+      Vec3d normal = cross(edge, n);
+      double edgeLength = length(normal);
+      if (edgeLength <= 0.0) continue;
+      normal = scaled(normal, 1.0 / edgeLength);
+      double d = -dot(normal, p[e]);
+      quadrics[a].addPlane(normal, d, edgeLength * edgeLength * kBorderWeight);
+      quadrics[b].addPlane(normal, d, edgeLength * edgeLength * kBorderWeight);
+    }
+  }
+
+  double maxCost = (double)maxError * maxError;
+  double reachedCost = 0.0;
+  std::vector<Collapse> collapses;
+  std::vector<char> touched(numVertex);
+  std::vector<GLuint> offsets(numVertex + 1);
+  std::vector<GLuint> adjacency;
+
+  while (result.size() > targetIndexCount) {
+    // Vertex to triangle adjacency of the current mesh
+    std::fill(offsets.begin(), offsets.end(), 0);
+    for (GLuint v : result) offsets[v + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    adjacency.resize(result.size());
+    std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < result.size(); i++) adjacency[fill[result[i]]++] = (GLuint)(i / 3);
+
+    collapses.clear();
+    auto consider = [&](GLuint from, GLuint to) {
+      if (kinds[from] == VertexKind::Locked) return;
+      if (kinds[from] == VertexKind::Border && !isBorderEdge(from, to)) return;
+      Quadric q = quadrics[from];
+      q.add(quadrics[to]);
+      collapses.push_back(Collapse{from, to, q.evaluate(positionOf(positions, to))});
+    };
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int e = 0; e < 3; e++) {
+        GLuint a = result[i + e], b = result[i + (e + 1) % 3];
+        consider(a, b);
+        consider(b, a);
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+    // Every collapse removes about two triangles
+    size_t collapseGoal = (result.size() - targetIndexCount) / 6 + 1;
+    size_t performed = 0;
+    std::fill(touched.begin(), touched.end(), 0);
+    for (const Collapse& collapse : collapses) {
+      if (performed >= collapseGoal || collapse.cost > maxCost) break;
+      if (touched[collapse.from] || touched[collapse.to]) continue;
+
+      // Reject collapses that would flip a remaining triangle
+      bool flips = false;
+      for (GLuint k = offsets[collapse.from]; k < offsets[collapse.from + 1] && !flips; k++) {
+        GLuint* tri = &result[adjacency[k] * 3];
+        if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) continue;
+        Vec3d before[3], after[3];
+        for (int j = 0; j < 3; j++) {
+          before[j] = positionOf(positions, tri[j]);
+          after[j] = positionOf(positions, tri[j] == collapse.from ? collapse.to : tri[j]);
+        }
+        Vec3d n0 = triangleNormal(before[0], before[1], before[2]);
+        Vec3d n1 = triangleNormal(after[0], after[1], after[2]);
+        flips = dot(n0, n1) <= 0.0;
+      }
+      if (flips) continue;
+
+      for (GLuint k = offsets[collapse.from]; k < offsets[collapse.from + 1]; k++) {
+        GLuint* tri = &result[adjacency[k] * 3];
+        for (int j = 0; j < 3; j++) {
+          // Neighbors' triangles changed, keep them out of this pass
+          touched[tri[j]] = 1;
+          if (tri[j] == collapse.from) tri[j] = collapse.to;
+        }
+      }
+      quadrics[collapse.to].add(quadrics[collapse.from]);
+      reachedCost = std::max(reachedCost, collapse.cost);
+      performed++;
+    }
+    if (performed == 0) break;
+
+    // Drop triangles that became degenerate
+    size_t write = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      GLuint a = result[i], b = result[i + 1], c = result[i + 2];
+      if (a == b || b == c || a == c) continue;
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  if (resultError) *resultError = (float)std::sqrt(reachedCost);
+  return result;
+}
+
+void generateLods(Model* model, int levels, bool lockBorders) {
+  model->lods.clear();
+  model->lods.push_back(ModelLod{0, model->numIndex, 0.0f});
+  std::vector<GLuint> base(model->indices.begin(), model->indices.begin() + model->numIndex);
+
+  float error = 0.0f;
+  size_t previous = base.size();
+  for (int level = 1; level <= levels; level++) {
+    size_t target = previous / 2 / 3 * 3;
+    if (target < 3) break;
+    float levelError = 0.0f;
+    std::vector<GLuint> lod =
+        simplifyMesh(model->positions, base, target, std::numeric_limits<float>::max(), &levelError, lockBorders);
+    // Stop once borders and seams prevent any meaningful reduction
+    if (lod.empty() || lod.size() * 10 > previous * 9) break;
+    optimizeVertexCache(lod, model->numVertex);
+
+    error = std::max(error, levelError);
+    model->lods.push_back(ModelLod{(GLuint)model->indices.size(), (int)lod.size(), error});
+    model->indices.insert(model->indices.end(), lod.begin(), lod.end());
+    previous = lod.size();
+  }
+}
+
+void generateLodsParallel(const std::vector<Model*>& models, int levels, size_t lockedBegin, size_t lockedEnd) {
+  std::vector<std::future<void>> jobs;
+  for (size_t i = 0; i < models.size(); i++) {
+    bool lockBorders = i >= lockedBegin && i < lockedEnd;
+    jobs.push_back(std::async(std::launch::async, generateLods, models[i], levels, lockBorders));
+  }
+  for (std::future<void>& job : jobs) job.get();
+}
+
+int selectLod(const Model* model, const glm::mat4& worldMatrix, const glm::vec3& cameraPosition,
+              float projectionScale, float thresholdPixels) {
+  if (model->lods.size() <= 1) return 0;
+  glm::vec3 center = (model->boundsMin + model->boundsMax) * 0.5f;
+  float radius = glm::length(model->boundsMax - model->boundsMin) * 0.5f;
+  glm::vec3 worldCenter = glm::vec3(worldMatrix * glm::vec4(center, 1.0f));
+  float scale = std::max(std::max(glm::length(glm::vec3(worldMatrix[0])), glm::length(glm::vec3(worldMatrix[1]))),
+                         glm::length(glm::vec3(worldMatrix[2])));
+  // Distance to the closest point of the bounding sphere
+  float distance = std::max(glm::length(worldCenter - cameraPosition) - radius * scale, 1e-3f);
+
+  int level = 0;
+  for (int i = 1; i < (int)model->lods.size(); i++) {
+    if (model->lods[i].error * scale / distance * projectionScale > thresholdPixels) break;
+    level = i;
+  }
+  return level;
+}
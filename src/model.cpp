@@ -32,7 +32,7 @@ Model* Model::fromObjectFile(const char* obj_file) {
    *         | v1x  | v1y  | v2x  | v2y  | v3x  | v3y  | v1x  | v1y  | ...
    * Note:
    *        OBJ File Format (https://en.wikipedia.org/wiki/Wavefront_.obj_file)
-   *        Vertex per face = 3 or 4
+   *        Vertex per face = 3 or 4, faces with more vertex are split into a triangle fan
    */
   std::vector<glm::vec3> positions;
   std::vector<glm::vec2> texcoords;
@@ -56,20 +56,27 @@ Model* Model::fromObjectFile(const char* obj_file) {
       normals.push_back(normal);
     } else if (type == "f") {
       std::string face;
+      std::vector<glm::ivec3> corners;
       while(iss >> face) {
         std::istringstream face_iss(face);
         std::string vertex, texcoord, normal;
         std::getline(face_iss, vertex, '/');
         std::getline(face_iss, texcoord, '/');
         std::getline(face_iss, normal, '/');
-        m->positions.push_back(positions[std::stoi(vertex) - 1].x);
-        m->positions.push_back(positions[std::stoi(vertex) - 1].y);
-        m->positions.push_back(positions[std::stoi(vertex) - 1].z);
-        m->texcoords.push_back(texcoords[std::stoi(texcoord) - 1].x);
-        m->texcoords.push_back(texcoords[std::stoi(texcoord) - 1].y);
-        m->normals.push_back(normals[std::stoi(normal) - 1].x);
-        m->normals.push_back(normals[std::stoi(normal) - 1].y);
-        m->normals.push_back(normals[std::stoi(normal) - 1].z);
+        corners.push_back(glm::ivec3(std::stoi(vertex) - 1, std::stoi(texcoord) - 1, std::stoi(normal) - 1));
+      }
+      // Triangulate n-gons as a fan around the first corner
+      for (size_t i = 2; i < corners.size(); i++) {
+        for (const glm::ivec3& corner : {corners[0], corners[i - 1], corners[i]}) {
+          m->positions.push_back(positions[corner.x].x);
+          m->positions.push_back(positions[corner.x].y);
+          m->positions.push_back(positions[corner.x].z);
+          m->texcoords.push_back(texcoords[corner.y].x);
+          m->texcoords.push_back(texcoords[corner.y].y);
+          m->normals.push_back(normals[corner.z].x);
+          m->normals.push_back(normals[corner.z].y);
+          m->normals.push_back(normals[corner.z].z);
+        }
       }
     }
   }
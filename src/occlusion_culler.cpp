@@ -0,0 +1,196 @@
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "model.h"
+
+namespace {
+constexpr int kTilesX = OcclusionCuller::kWidth / OcclusionCuller::kTileSize;
+constexpr int kTilesY = OcclusionCuller::kHeight / OcclusionCuller::kTileSize;
+// Most bands a frame is split into, a band is filled by one thread
+constexpr int kMaxBands = 4;
+// Vertices closer to the camera plane than this are not projected
+constexpr float kMinW = 1e-3f;
+
+double millisecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+}  // namespace
+
+OcclusionCuller::OcclusionCuller(JobSystem* jobs)
+    : jobs(jobs), depth(kWidth * kHeight, 1.0f), scratch(kWidth * kHeight), tileMax(kTilesX * kTilesY, 1.0f) {}
+
+void OcclusionCuller::begin(const glm::mat4& matrix) {
+  viewProjection = matrix;
+  occluders.clear();
+  vertices.clear();
+  tested = culled = 0;
+  milliseconds = 0.0;
+}
+
+void OcclusionCuller::addOccluder(const Model* model, const glm::mat4& worldMatrix) {
+  if (!enabled || (int)model->positions.size() < model->numVertex * 3) return;
+  auto begin = std::chrono::steady_clock::now();
+  occluders.push_back(Occluder{model, vertices.size()});
+  glm::mat4 matrix = viewProjection * worldMatrix;
+  for (int i = 0; i < model->numVertex; i++) {
+    glm::vec4 clip = matrix * glm::vec4(model->positions[i * 3], model->positions[i * 3 + 1],
+                                        model->positions[i * 3 + 2], 1.0f);
+    ScreenVertex& v = vertices.emplace_back();
+    v.w = clip.w;
+    if (clip.w < kMinW) continue;
+    v.x = (clip.x / clip.w * 0.5f + 0.5f) * kWidth;
+    v.y = (clip.y / clip.w * 0.5f + 0.5f) * kHeight;
+    v.z = clip.z / clip.w;
+  }
+  milliseconds += millisecondsSince(begin);
+}
+
+void OcclusionCuller::rasterize() {
+  auto begin = std::chrono::steady_clock::now();
+  std::fill(depth.begin(), depth.end(), 1.0f);
+  // Every band walks all triangles, but only fills its own rows
+  int bands = std::min(jobs->getThreadCount(), kMaxBands);
+  jobs->parallelFor(kHeight, bands, [this](size_t rowBegin, size_t rowEnd) {
+    rasterizeBand((int)rowBegin, (int)rowEnd);
+  });
+  erode();
+  milliseconds += millisecondsSince(begin);
+}
+
+void OcclusionCuller::rasterizeBand(int rowBegin, int rowEnd) {
+  for (const Occluder& occluder : occluders) {
+    const Model* model = occluder.model;
+    const ScreenVertex* v = vertices.data() + occluder.firstVertex;
+    if (model->numIndex == 0) {
+      for (int i = 0; i + 2 < model->numVertex; i += 3) rasterizeTriangle(v[i], v[i + 1], v[i + 2], rowBegin, rowEnd);
+      continue;
+    }
+    GLuint first = model->lods.empty() ? 0 : model->lods[0].firstIndex;
+    int count = model->lods.empty() ? model->numIndex : model->lods[0].numIndex;
+    const GLuint* indices = model->indices.data() + first;
+    for (int i = 0; i + 2 < count; i += 3) {
+      rasterizeTriangle(v[indices[i]], v[indices[i + 1]], v[indices[i + 2]], rowBegin, rowEnd);
+    }
+  }
+}
+
+void OcclusionCuller::rasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2,
+                                        int rowBegin, int rowEnd) {
+  // Triangles reaching behind the camera are left out, that only loses occlusion
+  if (v0.w < kMinW || v1.w < kMinW || v2.w < kMinW) return;
+  const ScreenVertex* a = &v0;
+  const ScreenVertex* b = &v1;
+  const ScreenVertex* c = &v2;
+  if (a->y > b->y) std::swap(a, b);
+  if (b->y > c->y) std::swap(b, c);
+  if (a->y > b->y) std::swap(a, b);
+  int yBegin = std::max(rowBegin, (int)std::ceil(a->y - 0.5f));
+  int yEnd = std::min(rowEnd, (int)std::ceil(c->y - 0.5f));
+  if (yBegin >= yEnd) return;
+
+  // Depth is a plane in screen space: z = a.z + dzdx * (x - a.x) + dzdy * (y - a.y)
+  float e1x = b->x - a->x, e1y = b->y - a->y, e1z = b->z - a->z;
+  float e2x = c->x - a->x, e2y = c->y - a->y, e2z = c->z - a->z;
+  float area = e1x * e2y - e1y * e2x;
+  if (std::abs(area) < 1e-6f) return;
+  float dzdx = (e1z * e2y - e1y * e2z) / area;
+  float dzdy = (e1x * e2z - e1z * e2x) / area;
+  float zMin = std::min({a->z, b->z, c->z});
+  if (zMin >= 1.0f) return;
+
+  for (int y = yBegin; y < yEnd; y++) {
+    float py = y + 0.5f;
+    // x where the long edge a-c and the short edge through b cross this row
+    float xLong = a->x + (py - a->y) * (c->x - a->x) / (c->y - a->y);
+    const ScreenVertex* s0 = py < b->y ? a : b;
+    const ScreenVertex* s1 = py < b->y ? b : c;
+    float xShort = s1->y > s0->y ? s0->x + (py - s0->y) * (s1->x - s0->x) / (s1->y - s0->y) : s1->x;
+    float left = std::min(xLong, xShort), right = std::max(xLong, xShort);
+    int xBegin = std::max(0, (int)std::ceil(left - 0.5f));
+    int xEnd = std::min(kWidth, (int)std::ceil(right - 0.5f));
+    if (xBegin >= xEnd) continue;
+    // A plain min over a linear ramp, which the compiler turns into SIMD
+    float z0 = a->z + dzdy * (py - a->y) + dzdx * (0.5f - a->x);
+    float* row = depth.data() + y * kWidth;
+    for (int x = xBegin; x < xEnd; x++) row[x] = std::min(row[x], std::max(z0 + dzdx * x, zMin));
+  }
+}
+
+void OcclusionCuller::erode() {
+  // Farthest of each 3x3 neighbourhood, separable: rows into scratch, then columns back
+  for (int y = 0; y < kHeight; y++) {
+    const float* row = depth.data() + y * kWidth;
+    float* out = scratch.data() + y * kWidth;
+    for (int x = 0; x < kWidth; x++) {
+      out[x] = std::max({row[std::max(x - 1, 0)], row[x], row[std::min(x + 1, kWidth - 1)]});
+    }
+  }
+  for (int y = 0; y < kHeight; y++) {
+    const float* up = scratch.data() + std::max(y - 1, 0) * kWidth;
+    const float* row = scratch.data() + y * kWidth;
+    const float* down = scratch.data() + std::min(y + 1, kHeight - 1) * kWidth;
+    float* out = depth.data() + y * kWidth;
+    for (int x = 0; x < kWidth; x++) out[x] = std::max({up[x], row[x], down[x]});
+  }
+  for (int ty = 0; ty < kTilesY; ty++) {
+    for (int tx = 0; tx < kTilesX; tx++) {
+      float farthest = -1.0f;
+      for (int y = ty * kTileSize; y < (ty + 1) * kTileSize; y++) {
+        const float* row = depth.data() + y * kWidth + tx * kTileSize;
+        farthest = std::max(farthest, *std::max_element(row, row + kTileSize));
+      }
+      tileMax[ty * kTilesX + tx] = farthest;
+    }
+  }
+}
+
+bool OcclusionCuller::isVisible(const glm::mat4& worldMatrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+  if (!enabled) return true;
+  auto begin = std::chrono::steady_clock::now();
+  tested++;
+  glm::mat4 matrix = viewProjection * worldMatrix;
+  glm::vec2 lower(1e30f), upper(-1e30f);
+  float nearest = 1.0f;
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 corner(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y,
+                     i & 4 ? boundsMax.z : boundsMin.z);
+    glm::vec4 clip = matrix * glm::vec4(corner, 1.0f);
+    // Reaches past the camera plane, too close to tell
+    if (clip.w < kMinW) {
+      milliseconds += millisecondsSince(begin);
+      return true;
+    }
+    glm::vec2 screen((clip.x / clip.w * 0.5f + 0.5f) * kWidth, (clip.y / clip.w * 0.5f + 0.5f) * kHeight);
+    lower = glm::vec2(std::min(lower.x, screen.x), std::min(lower.y, screen.y));
+    upper = glm::vec2(std::max(upper.x, screen.x), std::max(upper.y, screen.y));
+    nearest = std::min(nearest, clip.z / clip.w);
+  }
+
+  int x0 = std::max(0, (int)std::floor(lower.x)), x1 = std::min(kWidth, (int)std::ceil(upper.x));
+  int y0 = std::max(0, (int)std::floor(lower.y)), y1 = std::min(kHeight, (int)std::ceil(upper.y));
+  // Outside the view or beyond the far plane
+  bool visible = false;
+  if (x0 < x1 && y0 < y1 && nearest <= 1.0f) {
+    for (int ty = y0 / kTileSize; ty <= (y1 - 1) / kTileSize && !visible; ty++) {
+      for (int tx = x0 / kTileSize; tx <= (x1 - 1) / kTileSize && !visible; tx++) {
+        // Every texel of the tile is closer than the box
+        if (nearest > tileMax[ty * kTilesX + tx]) continue;
+        for (int y = std::max(y0, ty * kTileSize); y < std::min(y1, (ty + 1) * kTileSize) && !visible; y++) {
+          const float* row = depth.data() + y * kWidth;
+          for (int x = std::max(x0, tx * kTileSize); x < std::min(x1, (tx + 1) * kTileSize); x++) {
+            if (nearest <= row[x]) {
+              visible = true;
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+  if (!visible) culled++;
+  milliseconds += millisecondsSince(begin);
+  return visible;
+}
@@ -1,14 +1,18 @@
 #include "opengl_context.h"
 
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <stdexcept>
 
+#include "gl_state.h"
+
 GLFWwindow* OpenGLContext::window = nullptr;
 int OpenGLContext::refresh_rate = 60;
 int OpenGLContext::major_version = 4;
 int OpenGLContext::minor_version = 1;
 int OpenGLContext::profile = GLFW_OPENGL_COMPAT_PROFILE;
+bool OpenGLContext::headless = false;
 int OpenGLContext::framebuffer_width = 1280;
 int OpenGLContext::framebuffer_height = 720;
 
@@ -114,6 +118,11 @@ void GLAPIENTRY errorCallback(GLenum source, GLenum type, GLuint id, GLenum seve
 }  // namespace
 
 OpenGLContext::OpenGLContext() {
+  // Without a display server the null platform can still create an OSMesa context
+  bool offscreen = headless && std::getenv("DISPLAY") == nullptr && std::getenv("WAYLAND_DISPLAY") == nullptr;
+#ifdef GLFW_PLATFORM_NULL
+  if (offscreen) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
   // Initialize GLFW
   if (glfwInit() == GLFW_FALSE) {
     THROW_EXCEPTION(std::runtime_error, "Failed to initialize GLFW!");
@@ -125,6 +134,8 @@ OpenGLContext::OpenGLContext() {
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
   }
   glfwWindowHint(GLFW_OPENGL_PROFILE, OpenGLContext::profile);
+  if (headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  if (offscreen) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
 #ifndef NDEBUG
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 #endif
@@ -139,7 +150,8 @@ OpenGLContext::OpenGLContext() {
     if (window == nullptr) THROW_EXCEPTION(std::runtime_error, "Failed to create OpenGL context!");
   }
   glfwMakeContextCurrent(window);
-  glfwSwapInterval(1);
+  // Headless frames are never presented, so they must not wait for vsync
+  glfwSwapInterval(headless ? 0 : 1);
   // Load OpenGL function pointers
 #ifdef GLAD_OPTION_GL_ON_DEMAND
   // Lazy loading
@@ -155,9 +167,11 @@ OpenGLContext::OpenGLContext() {
   glViewport(0, 0, framebuffer_width, framebuffer_height);
   // OK, everything works fine
   // ----------------------------------------------------------
+  // Nothing is known about the state of a new context
+  GLState::invalidate();
   // Enable some OpenGL feature
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_CULL_FACE);
+  GLState::setEnabled(GL_DEPTH_TEST, true);
+  GLState::setEnabled(GL_CULL_FACE, true);
   glClearColor(0, 0, 0, 1);
 }
 
@@ -166,9 +180,10 @@ OpenGLContext::~OpenGLContext() {
   glfwTerminate();
 }
 
-void OpenGLContext::createContext(int GLversion, int profile) {
+void OpenGLContext::createContext(int GLversion, int profile, bool headless) {
   // We should only initialize once
   if (window == nullptr) {
+    OpenGLContext::headless = headless;
     OpenGLContext::major_version = GLversion / 10;
     OpenGLContext::minor_version = GLversion % 10;
     if (GLversion < 32)
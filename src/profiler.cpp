@@ -0,0 +1,328 @@
+#include "profiler.h"
+
+#if HW2_PROFILER
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+struct Event {
+  const char* name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// Written only by its thread and read only by the GL thread in endFrame, so
+// the two indices are all the synchronization it needs
+struct EventRing {
+  // Power of two, events past it are dropped until the next endFrame
+  static constexpr uint32_t kCapacity = 8192;
+  Event events[kCapacity];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+  std::atomic<uint64_t> dropped{0};
+  int thread = 0;
+};
+
+struct CapturedEvent {
+  const char* name;
+  uint64_t begin;
+  uint64_t end;
+  // Ring index, kGpuThread for GPU scopes
+  int thread;
+};
+
+struct GpuQuery {
+  GLuint query = 0;
+  const char* name = nullptr;
+  // When the scope was opened, GL_TIME_ELAPSED only gives its length
+  uint64_t begin = 0;
+};
+
+// The last kWindowFrames frame times, overwritten oldest first once full
+struct FrameWindow {
+  std::vector<float> values;
+  size_t next = 0;
+};
+
+constexpr int kGpuThread = 1000;
+// About 100 MB of captured events
+constexpr size_t kMaxCapturedEvents = 4u << 20;
+
+struct ProfilerState {
+  // Taken when a thread records its first event and when endFrame lists the rings
+  std::mutex ringsMutex;
+  std::vector<std::unique_ptr<EventRing>> rings;
+
+  // Everything below belongs to the GL thread
+  int mainThread = -1;
+  bool gpuChecked = false;
+  bool gpuAvailable = false;
+  bool gpuOpen = false;
+  // Queries of the frame being recorded and of the one before it
+  std::vector<GpuQuery> gpuQueries[2];
+  int gpuUsed[2] = {0, 0};
+  int gpuFrame = 0;
+  uint64_t gpuPending = 0;
+  double lastGpuFrameMs = 0.0;
+
+  uint64_t frameBegin = 0;
+  uint64_t frames = 0;
+  FrameWindow cpuFrameMs;
+  FrameWindow gpuFrameMs;
+  // Total ms and count of every scope since the last log line
+  std::unordered_map<const char*, std::pair<double, uint64_t>> scopes;
+  uint64_t lastLog = 0;
+
+  bool capturing = false;
+  uint64_t captureBegin = 0;
+  std::vector<CapturedEvent> captured;
+};
+
+ProfilerState& state() {
+  static ProfilerState instance;
+  return instance;
+}
+
+thread_local EventRing* threadRing = nullptr;
+
+EventRing* ring() {
+  if (threadRing == nullptr) {
+    ProfilerState& profiler = state();
+    std::lock_guard<std::mutex> lock(profiler.ringsMutex);
+    profiler.rings.push_back(std::make_unique<EventRing>());
+    threadRing = profiler.rings.back().get();
+    threadRing->thread = (int)profiler.rings.size() - 1;
+  }
+  return threadRing;
+}
+
+void push(FrameWindow& window, float value) {
+  if ((int)window.values.size() < Profiler::kWindowFrames) {
+    window.values.push_back(value);
+  } else {
+    window.values[window.next] = value;
+  }
+  window.next = (window.next + 1) % Profiler::kWindowFrames;
+}
+
+// p in [0, 1] of the window, 0 if it is empty
+float percentile(std::vector<float> values, float p) {
+  if (values.empty()) return 0.0f;
+  size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+// Order does not matter to percentiles, so the ring is read as it is
+std::string percentiles(const FrameWindow& window) {
+  if (window.values.empty()) return "n/a";
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(2) << percentile(window.values, 0.5f) << " / "
+       << percentile(window.values, 0.95f) << " / " << percentile(window.values, 0.99f) << " ms";
+  return text.str();
+}
+
+std::string escape(const char* text) {
+  std::string result;
+  for (const char* c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') result += '\\';
+    result += *c;
+  }
+  return result;
+}
+
+void collect(ProfilerState& profiler, const CapturedEvent& event) {
+  auto& scope = profiler.scopes[event.name];
+  scope.first += (event.end - event.begin) / 1e6;
+  scope.second++;
+  if (profiler.capturing && profiler.captured.size() < kMaxCapturedEvents) profiler.captured.push_back(event);
+}
+
+// Gather the GPU times of the frame before the current one
+void resolveGpu(ProfilerState& profiler) {
+  int frame = profiler.gpuFrame ^ 1;
+  uint64_t total = 0;
+  bool any = false;
+  for (int i = 0; i < profiler.gpuUsed[frame]; i++) {
+    const GpuQuery& query = profiler.gpuQueries[frame][i];
+    GLuint available = 0;
+    glGetQueryObjectuiv(query.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      // Never wait, the result is dropped
+      profiler.gpuPending++;
+      continue;
+    }
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &elapsed);
+    total += elapsed;
+    any = true;
+    collect(profiler, CapturedEvent{query.name, query.begin, query.begin + elapsed, kGpuThread});
+  }
+  if (any) {
+    profiler.lastGpuFrameMs = total / 1e6;
+    push(profiler.gpuFrameMs, (float)profiler.lastGpuFrameMs);
+  }
+  profiler.gpuUsed[frame] = 0;
+  profiler.gpuFrame = frame;
+}
+}  // namespace
+
+uint64_t Profiler::now() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Profiler::record(const char* name, uint64_t begin, uint64_t end) {
+  EventRing* events = ring();
+  uint32_t head = events->head.load(std::memory_order_relaxed);
+  if (head - events->tail.load(std::memory_order_acquire) >= EventRing::kCapacity) {
+    events->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  events->events[head & (EventRing::kCapacity - 1)] = Event{name, begin, end};
+  events->head.store(head + 1, std::memory_order_release);
+}
+
+int Profiler::beginGpu(const char* name) {
+  ProfilerState& profiler = state();
+  if (!profiler.gpuChecked) {
+    profiler.gpuChecked = true;
+    // Core since 3.3, software rasterizers included
+    profiler.gpuAvailable = GLAD_GL_VERSION_3_3;
+    if (!profiler.gpuAvailable) std::cout << "Profiler: no timer queries, GPU scopes are not timed" << std::endl;
+  }
+  if (!profiler.gpuAvailable || profiler.gpuOpen) return -1;
+
+  std::vector<GpuQuery>& queries = profiler.gpuQueries[profiler.gpuFrame];
+  int slot = profiler.gpuUsed[profiler.gpuFrame]++;
+  if (slot == (int)queries.size()) {
+    queries.emplace_back();
+    glGenQueries(1, &queries.back().query);
+  }
+  queries[slot].name = name;
+  queries[slot].begin = now();
+  glBeginQuery(GL_TIME_ELAPSED, queries[slot].query);
+  profiler.gpuOpen = true;
+  return slot;
+}
+
+void Profiler::endGpu(int slot) {
+  if (slot < 0) return;
+  glEndQuery(GL_TIME_ELAPSED);
+  state().gpuOpen = false;
+}
+
+void Profiler::beginFrame() {
+  ProfilerState& profiler = state();
+  profiler.mainThread = ring()->thread;
+  profiler.frameBegin = now();
+  if (profiler.lastLog == 0) profiler.lastLog = profiler.frameBegin;
+}
+
+void Profiler::endFrame() {
+  ProfilerState& profiler = state();
+  uint64_t end = now();
+  record("Frame", profiler.frameBegin, end);
+  push(profiler.cpuFrameMs, (float)((end - profiler.frameBegin) / 1e6));
+  profiler.frames++;
+
+  if (profiler.gpuAvailable) resolveGpu(profiler);
+
+  std::vector<EventRing*> rings;
+  {
+    std::lock_guard<std::mutex> lock(profiler.ringsMutex);
+    for (const auto& events : profiler.rings) rings.push_back(events.get());
+  }
+  for (EventRing* events : rings) {
+    uint32_t tail = events->tail.load(std::memory_order_relaxed);
+    uint32_t head = events->head.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+      const Event& event = events->events[tail & (EventRing::kCapacity - 1)];
+      collect(profiler, CapturedEvent{event.name, event.begin, event.end, events->thread});
+    }
+    events->tail.store(tail, std::memory_order_release);
+  }
+
+  if (end - profiler.lastLog < (uint64_t)(kLogInterval * 1e9)) return;
+  std::vector<std::pair<const char*, std::pair<double, uint64_t>>> scopes(profiler.scopes.begin(),
+                                                                          profiler.scopes.end());
+  std::sort(scopes.begin(), scopes.end(), [](const auto& a, const auto& b) { return a.second.first > b.second.first; });
+  std::cout << "Frame p50 / p95 / p99: CPU " << percentiles(profiler.cpuFrameMs) << ", GPU "
+            << percentiles(profiler.gpuFrameMs) << std::endl;
+  uint64_t frames = std::max<uint64_t>(1, profiler.frames);
+  std::cout << "  ms per frame:" << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < scopes.size() && i < 6; i++) {
+    std::cout << " " << scopes[i].first << " " << scopes[i].second.first / frames;
+  }
+  std::cout << std::defaultfloat << std::endl;
+  profiler.scopes.clear();
+  profiler.frames = 0;
+  profiler.lastLog = end;
+}
+
+double Profiler::getGpuFrameMs() { return state().lastGpuFrameMs; }
+
+void Profiler::startCapture() {
+  ProfilerState& profiler = state();
+  profiler.capturing = true;
+  profiler.captureBegin = now();
+  profiler.captured.clear();
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+  ProfilerState& profiler = state();
+  std::ofstream file(path);
+  if (!file) {
+    std::cout << "Failed to write trace " << path << std::endl;
+    return false;
+  }
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  file << std::fixed << std::setprecision(3);
+  int threads;
+  {
+    std::lock_guard<std::mutex> lock(profiler.ringsMutex);
+    threads = (int)profiler.rings.size();
+  }
+  for (int thread = 0; thread < threads; thread++) {
+    const char* name = thread == profiler.mainThread ? "GL thread" : "Worker";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"" << name
+         << " " << thread << "\"}},\n";
+  }
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << kGpuThread
+       << ",\"args\":{\"name\":\"GPU\"}}";
+  for (const CapturedEvent& event : profiler.captured) {
+    // Complete events, microseconds since the capture started
+    double begin = event.begin >= profiler.captureBegin ? (event.begin - profiler.captureBegin) / 1e3 : 0.0;
+    file << ",\n{\"name\":\"" << escape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+         << ",\"ts\":" << begin << ",\"dur\":" << (event.end - event.begin) / 1e3 << "}";
+  }
+  file << "\n]}\n";
+  std::cout << "Wrote " << profiler.captured.size() << " trace events to " << path << std::endl;
+  return (bool)file;
+}
+
+void Profiler::printReport() {
+  ProfilerState& profiler = state();
+  uint64_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(profiler.ringsMutex);
+    for (const auto& events : profiler.rings) dropped += events->dropped.load();
+  }
+  std::cout << "Profiler: frame p50 / p95 / p99 over the last " << profiler.cpuFrameMs.values.size() << " frames: CPU "
+            << percentiles(profiler.cpuFrameMs) << ", GPU " << percentiles(profiler.gpuFrameMs) << ", "
+            << dropped << " events dropped, " << profiler.gpuPending << " GPU results not ready in time"
+            << std::endl;
+}
+
+#endif
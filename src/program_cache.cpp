@@ -0,0 +1,223 @@
+#include "program_cache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+// Bump when the file layout changes so stale cache files are not used
+constexpr uint32_t kCacheVersion = 1;
+
+std::string glString(GLenum name) {
+  const GLubyte* value = glGetString(name);
+  return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+}  // namespace
+
+ProgramCache::ProgramCache(const std::string& directory) : directory(directory) {
+  driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+  GLint formats = 0;
+  if (GLAD_GL_VERSION_4_1) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  supported = formats > 0;
+  if (!supported) std::cout << "Program cache: program binaries not supported, compiling every start" << std::endl;
+  parallel = GLAD_GL_KHR_parallel_shader_compile;
+  // Let the driver pick how many threads compile
+  if (parallel) glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+}
+
+std::string ProgramCache::cachePath(const std::string& vertSource, const std::string& fragSource,
+                                    const std::string& defines) const {
+  // FNV-1a over everything the binary depends on, each part prefixed by its size
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+  };
+  add(&kCacheVersion, sizeof(kCacheVersion));
+  for (const std::string* part : {&driver, &defines, &vertSource, &fragSource}) {
+    uint64_t size = part->size();
+    add(&size, sizeof(size));
+    add(part->data(), part->size());
+  }
+  std::ostringstream path;
+  path << directory << "/program-" << std::hex << hash << ".bin";
+  return path.str();
+}
+
+GLuint ProgramCache::load(const std::string& path) const {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return 0;
+  uint32_t version = 0;
+  GLenum format = 0;
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  file.read(reinterpret_cast<char*>(&format), sizeof(format));
+  if (!file || version != kCacheVersion) return 0;
+  std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (binary.empty()) return 0;
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+  GLint success = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    // Usually a driver that changed without changing its version string
+    std::cout << "Program cache: rejected " << path << std::endl;
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void ProgramCache::save(const std::string& path, GLuint program) const {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return;
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+
+  // Written next to the final name and renamed, so a crash never leaves a truncated binary behind
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&kCacheVersion), sizeof(kCacheVersion));
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), length);
+    file.close();
+    if (!file) error = std::make_error_code(std::errc::io_error);
+  }
+  if (!error) std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::cout << "Program cache: cannot write " << path << std::endl;
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+ProgramBuild ProgramCache::submit(const char* vertFile, const char* fragFile, const ShaderDefines& defines) {
+  ProgramBuild build;
+  build.begin = std::chrono::steady_clock::now();
+  build.name = std::string(vertFile) + " + " + fragFile;
+  std::string vertSource, fragSource;
+  std::vector<std::string> vertFiles, fragFiles;
+  if (!preprocessShader(vertFile, defines, vertSource, &vertFiles) ||
+      !preprocessShader(fragFile, defines, fragSource, &fragFiles)) {
+    return build;
+  }
+
+  build.path = cachePath(vertSource, fragSource, defines.str());
+  // Ready, failed or still compiling for an earlier request, poll follows that build
+  auto variant = variants.find(build.path);
+  if (variant != variants.end()) {
+    build.program = variant->second.program;
+    build.status = variant->second.status;
+    return build;
+  }
+  if (supported) {
+    build.program = load(build.path);
+    if (build.program != 0) {
+      variants[build.path] = Variant{build.program, 0, 0, {}, {}, ProgramBuild::Status::kReady};
+      double ms = millisecondsSince(build.begin);
+      std::cout << "Program cache: loaded " << build.name << " in " << ms << " ms" << std::endl;
+      loaded++;
+      loadMs += ms;
+      build.status = ProgramBuild::Status::kReady;
+      return build;
+    }
+  }
+
+  // Nothing here reads a status back, that would wait for the driver
+  const char* sources[] = {vertSource.c_str(), fragSource.c_str()};
+  Variant& compiling = variants[build.path];
+  compiling.vert = glCreateShader(GL_VERTEX_SHADER);
+  compiling.frag = glCreateShader(GL_FRAGMENT_SHADER);
+  compiling.vertFiles = std::move(vertFiles);
+  compiling.fragFiles = std::move(fragFiles);
+  glShaderSource(compiling.vert, 1, &sources[0], 0);
+  glShaderSource(compiling.frag, 1, &sources[1], 0);
+  glCompileShader(compiling.vert);
+  glCompileShader(compiling.frag);
+  compiling.program = glCreateProgram();
+  glAttachShader(compiling.program, compiling.vert);
+  glAttachShader(compiling.program, compiling.frag);
+  if (supported) glProgramParameteri(compiling.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(compiling.program);
+  build.program = compiling.program;
+  if (compiled == 0) firstCompile = build.begin;
+  compiled++;
+  build.status = ProgramBuild::Status::kCompiling;
+  return build;
+}
+
+ProgramBuild::Status ProgramCache::poll(ProgramBuild& build, bool wait) {
+  if (build.status != ProgramBuild::Status::kCompiling) return build.status;
+  Variant& variant = variants[build.path];
+  if (variant.status == ProgramBuild::Status::kCompiling && !finish(build, variant, wait)) return build.status;
+  build.program = variant.program;
+  build.status = variant.status;
+  return build.status;
+}
+
+bool ProgramCache::finish(const ProgramBuild& build, Variant& variant, bool wait) {
+  if (parallel && !wait) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(variant.program, GL_COMPLETION_STATUS_KHR, &done);
+    if (!done) return false;
+  }
+
+  GLint success = GL_FALSE;
+  glGetProgramiv(variant.program, GL_LINK_STATUS, &success);
+  if (!success) {
+    char infoLog[512];
+    for (GLuint shader : {variant.vert, variant.frag}) {
+      GLint shaderCompiled = GL_FALSE;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
+      if (shaderCompiled) continue;
+      glGetShaderInfoLog(shader, 512, NULL, infoLog);
+      std::cout << "ERROR::SHADER::COMPILATION_FAILED " << build.name << "\n" << infoLog;
+      // The log numbers files as the #line directives of the preprocessor do
+      const std::vector<std::string>& files = shader == variant.vert ? variant.vertFiles : variant.fragFiles;
+      for (size_t i = 0; i < files.size(); i++) std::cout << "  source " << i << ": " << files[i] << std::endl;
+    }
+    glGetProgramInfoLog(variant.program, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED " << build.name << "\n" << infoLog << std::endl;
+    glDeleteProgram(variant.program);
+    variant.program = 0;
+    variant.status = ProgramBuild::Status::kFailed;
+  } else {
+    glDetachShader(variant.program, variant.vert);
+    glDetachShader(variant.program, variant.frag);
+    if (supported) save(build.path, variant.program);
+    std::cout << "Program cache: compiled " << build.name << ", ready after " << millisecondsSince(build.begin)
+              << " ms" << std::endl;
+    variant.status = ProgramBuild::Status::kReady;
+  }
+  glDeleteShader(variant.vert);
+  glDeleteShader(variant.frag);
+  variant.vert = variant.frag = 0;
+  lastCompile = std::chrono::steady_clock::now();
+  return true;
+}
+
+GLuint ProgramCache::build(const char* vertFile, const char* fragFile, const ShaderDefines& defines) {
+  ProgramBuild build = submit(vertFile, fragFile, defines);
+  return poll(build, true) == ProgramBuild::Status::kReady ? build.program : 0;
+}
+
+void ProgramCache::printReport() const {
+  double compileMs = compiled > 0 ? std::chrono::duration<double, std::milli>(lastCompile - firstCompile).count() : 0;
+  std::cout << "Program cache: " << loaded << " programs loaded in " << loadMs << " ms, " << compiled
+            << " compiled in " << compileMs << " ms" << (parallel ? " by parallel driver threads" : "") << std::endl;
+}
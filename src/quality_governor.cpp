@@ -0,0 +1,101 @@
+#include "quality_governor.h"
+
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+QualityGovernor::QualityGovernor(double budgetMs) : budgetMs(budgetMs) { frameMs.reserve(kWindow); }
+
+void QualityGovernor::addKnob(const std::string& name, const std::vector<float>& values, double stepCostMs,
+                              std::function<void(float)> apply) {
+  if (values.empty()) return;
+  Knob knob;
+  knob.name = name;
+  knob.values = values;
+  knob.stepCostMs = stepCostMs;
+  knob.apply = std::move(apply);
+  knob.apply(knob.values[0]);
+  knobs.push_back(std::move(knob));
+}
+
+void QualityGovernor::setEnabled(bool enabled) {
+  this->enabled = enabled;
+  resetWindow(kSettleFrames);
+  std::cout << "Quality governor " << (enabled ? "enabled" : "disabled") << ", knobs stay where they are"
+            << std::endl;
+}
+
+float QualityGovernor::getValue(const std::string& name) const {
+  for (const Knob& knob : knobs) {
+    if (knob.name == name) return knob.values[knob.level];
+  }
+  return 0.0f;
+}
+
+void QualityGovernor::resetWindow(int settle) {
+  frameMs.clear();
+  settleFrames = settle;
+}
+
+void QualityGovernor::addFrame(double ms) {
+  if (!enabled) return;
+  if (settleFrames > 0) {
+    settleFrames--;
+    return;
+  }
+  frameMs.push_back(ms);
+  if ((int)frameMs.size() < kWindow) return;
+  double average = std::accumulate(frameMs.begin(), frameMs.end(), 0.0) / frameMs.size();
+  frameMs.clear();
+
+  // What the last change really did, so later decisions use better estimates
+  if (changedKnob >= 0) {
+    Knob& knob = knobs[changedKnob];
+    // Positive when the change went the expected way: a step down saved time, a step up cost some
+    double measured = steppedDown ? averageBeforeChange - average : average - averageBeforeChange;
+    std::cout << std::fixed << std::setprecision(2) << "Quality governor: " << knob.name << " step measured "
+              << measured << " ms";
+    // The opposite sign is noise or a change in the scene, it says nothing about the knob
+    if (measured >= 0.0) {
+      knob.stepCostMs = 0.5 * (knob.stepCostMs + measured);
+      std::cout << ", estimate now " << knob.stepCostMs << " ms";
+    } else {
+      std::cout << ", estimate kept at " << knob.stepCostMs << " ms";
+    }
+    std::cout << std::defaultfloat << std::endl;
+    changedKnob = -1;
+  }
+
+  int best = -1;
+  if (average > budgetMs * kOverBudget) {
+    // Largest saving first, it gets back under budget in the fewest changes
+    for (int i = 0; i < (int)knobs.size(); i++) {
+      const Knob& knob = knobs[i];
+      if (knob.level + 1 >= (int)knob.values.size()) continue;
+      if (best < 0 || knob.stepCostMs > knobs[best].stepCostMs) best = i;
+    }
+    if (best >= 0) change(best, knobs[best].level + 1, average);
+  } else {
+    // Cheapest first, and only if it leaves a margin so it is not undone right away
+    for (int i = 0; i < (int)knobs.size(); i++) {
+      const Knob& knob = knobs[i];
+      if (knob.level == 0 || average + knob.stepCostMs > budgetMs * kUnderBudget) continue;
+      if (best < 0 || knob.stepCostMs < knobs[best].stepCostMs) best = i;
+    }
+    if (best >= 0) change(best, knobs[best].level - 1, average);
+  }
+}
+
+void QualityGovernor::change(int index, int level, double averageMs) {
+  Knob& knob = knobs[index];
+  std::cout << std::fixed << std::setprecision(2) << "Quality governor: " << averageMs << " ms average, "
+            << budgetMs << " ms budget, " << knob.name << " " << knob.values[knob.level] << " -> "
+            << knob.values[level] << " (" << (level > knob.level ? "saves" : "costs") << " ~" << knob.stepCostMs
+            << " ms)" << std::defaultfloat << std::endl;
+  steppedDown = level > knob.level;
+  knob.level = level;
+  knob.apply(knob.values[level]);
+  changedKnob = index;
+  averageBeforeChange = averageMs;
+  resetWindow(kSettleFrames);
+}
@@ -0,0 +1,94 @@
+#include "render_queue.h"
+
+#include <algorithm>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "geometry_arena.h"
+#include "gl_state.h"
+#include "model.h"
+#include "program.h"
+
+uint64_t RenderQueue::makeKey(int pass, bool transparent, int program, int material, GLuint vertexArray,
+                              float depth) {
+  uint64_t quantized = (uint64_t)(std::clamp(depth, 0.0f, 1.0f) * (float)0xFFFFFF);
+  uint64_t state = ((uint64_t)(program & 0x3F) << 24) | ((uint64_t)(material & 0xFFFF) << 8) | (vertexArray & 0xFF);
+  uint64_t key = ((uint64_t)(pass & 0x3) << 62) | ((uint64_t)transparent << 61);
+  if (transparent) {
+    // Farthest first
+    return key | ((0xFFFFFF - quantized) << 37) | (state << 7);
+  }
+  return key | (state << 31) | (quantized << 7);
+}
+
+int RenderQueue::materialId(const GLuint (&textures)[DrawItem::kTextureUnits]) {
+  uint64_t set = ((uint64_t)textures[0] << 32) | textures[1];
+  auto iter = materials.find(set);
+  if (iter != materials.end()) return iter->second;
+  // Ids past 16 bits would alias in the key, start over
+  if (materials.size() > 0xFFFF) materials.clear();
+  int id = (int)materials.size();
+  materials[set] = id;
+  return id;
+}
+
+void RenderQueue::submit(uint64_t key, const DrawItem& item) {
+  entries.push_back(Entry{key, (uint32_t)items.size()});
+  items.push_back(item);
+}
+
+void RenderQueue::sort() {
+  // LSD radix sort on bytes, stable so equal keys keep their submission order
+  scratch.resize(entries.size());
+  for (int shift = 0; shift < 64; shift += 8) {
+    size_t counts[256] = {};
+    for (const Entry& entry : entries) counts[(entry.key >> shift) & 0xFF]++;
+    // Every key has the same byte here, nothing to reorder
+    if (counts[(entries[0].key >> shift) & 0xFF] == entries.size()) continue;
+    size_t offset = 0;
+    for (size_t& count : counts) {
+      size_t next = offset + count;
+      count = offset;
+      offset = next;
+    }
+    for (const Entry& entry : entries) scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+    entries.swap(scratch);
+  }
+}
+
+void RenderQueue::execute(GeometryArena* arena, const std::function<void(const Program*)>& onProgramChange) {
+  if (entries.empty()) return;
+  sort();
+
+  // GLState drops the binds that match the previous draw, in key order those are most of them
+  const Program* program = nullptr;
+  for (const Entry& entry : entries) {
+    const DrawItem& item = items[entry.index];
+    if (item.program != program) {
+      program = item.program;
+      GLState::useProgram(program->programId);
+      onProgramChange(program);
+    }
+    GLState::setEnabled(GL_BLEND, item.blend);
+    if (item.blend) GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for (int unit = 0; unit < DrawItem::kTextureUnits; unit++) {
+      if (item.textures[unit] != 0) GLState::bindTexture(unit, GL_TEXTURE_2D, item.textures[unit]);
+    }
+    GLState::bindVertexArray(arena->vertexArray(item.model));
+
+    glUniformMatrix4fv(program->modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(item.worldMatrix));
+    if (program->normalMatrixLocation >= 0) {
+      glUniformMatrix3fv(program->normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(item.normalMatrix));
+    }
+    setDequantizeUniforms(program->dequantize, item.model);
+    arena->drawBound(item.model, item.lod);
+  }
+  GLState::setEnabled(GL_BLEND, false);
+  GLState::bindVertexArray(0);
+  GLState::useProgram(0);
+}
+
+void RenderQueue::clear() {
+  items.clear();
+  entries.clear();
+}
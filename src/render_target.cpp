@@ -0,0 +1,55 @@
+#include "render_target.h"
+
+#include <iostream>
+
+RenderTarget::~RenderTarget() { release(); }
+
+void RenderTarget::release() {
+  if (framebuffer != 0) glDeleteFramebuffers(1, &framebuffer);
+  if (colorBuffer != 0) glDeleteRenderbuffers(1, &colorBuffer);
+  if (depthBuffer != 0) glDeleteRenderbuffers(1, &depthBuffer);
+  framebuffer = colorBuffer = depthBuffer = 0;
+  width = height = 0;
+}
+
+bool RenderTarget::resize(int newWidth, int newHeight) {
+  if (framebuffer != 0 && newWidth == width && newHeight == height) return true;
+  release();
+
+  glGenRenderbuffers(1, &colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, newWidth, newHeight);
+  glGenRenderbuffers(1, &depthBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, newWidth, newHeight);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "Render target " << newWidth << "x" << newHeight << " incomplete: 0x" << std::hex << status
+              << std::dec << std::endl;
+    release();
+    return false;
+  }
+  width = newWidth;
+  height = newHeight;
+  return true;
+}
+
+void RenderTarget::bind() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(0, 0, width, height);
+}
+
+void RenderTarget::blitTo(GLuint target, int targetWidth, int targetHeight) const {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, targetWidth, targetHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, target);
+  glViewport(0, 0, targetWidth, targetHeight);
+}
@@ -0,0 +1,178 @@
+#include "scene.h"
+
+Scene::Scene(const std::vector<Model*>& models) : models(models), materials(1) {}
+
+ObjectHandle Scene::create(int modelIndex, int programIndex, const glm::mat4& transform, ObjectHandle parent) {
+  uint32_t slot = freeSlot;
+  if (slot == kNoSlot) {
+    slot = (uint32_t)slots.size();
+    slots.emplace_back();
+  } else {
+    freeSlot = slots[slot].index;
+  }
+  size_t index = size();
+  slots[slot].index = (uint32_t)index;
+  slots[slot].generation++;
+
+  localTransforms.push_back(transform);
+  globalTransforms.emplace_back();
+  worldMatrices.emplace_back();
+  normalMatrices.emplace_back();
+  boundsMin.emplace_back();
+  boundsMax.emplace_back();
+  modelIndices.push_back(modelIndex);
+  programIndices.push_back(programIndex);
+  materialIndices.push_back(0);
+  textureIndices.push_back(0);
+  dirty.push_back(kDirty);
+  slotOf.push_back(slot);
+  anyDirty = true;
+  if (isValid(parent)) link(slot, parent.slot);
+  return ObjectHandle{slot, slots[slot].generation};
+}
+
+void Scene::destroy(ObjectHandle handle) {
+  if (!isValid(handle)) return;
+  while (slots[handle.slot].firstChild != kNoSlot) {
+    uint32_t child = slots[handle.slot].firstChild;
+    destroy(ObjectHandle{child, slots[child].generation});
+  }
+  unlink(handle.slot);
+
+  size_t index = indexOf(handle);
+  size_t last = size() - 1;
+  if (index != last) {
+    localTransforms[index] = localTransforms[last];
+    globalTransforms[index] = globalTransforms[last];
+    worldMatrices[index] = worldMatrices[last];
+    normalMatrices[index] = normalMatrices[last];
+    boundsMin[index] = boundsMin[last];
+    boundsMax[index] = boundsMax[last];
+    modelIndices[index] = modelIndices[last];
+    programIndices[index] = programIndices[last];
+    materialIndices[index] = materialIndices[last];
+    textureIndices[index] = textureIndices[last];
+    dirty[index] = dirty[last];
+    slotOf[index] = slotOf[last];
+    slots[slotOf[index]].index = (uint32_t)index;
+  }
+  localTransforms.pop_back();
+  globalTransforms.pop_back();
+  worldMatrices.pop_back();
+  normalMatrices.pop_back();
+  boundsMin.pop_back();
+  boundsMax.pop_back();
+  modelIndices.pop_back();
+  programIndices.pop_back();
+  materialIndices.pop_back();
+  textureIndices.pop_back();
+  dirty.pop_back();
+  slotOf.pop_back();
+
+  // Bumping the generation makes every copy of the handle stale
+  slots[handle.slot].generation++;
+  slots[handle.slot].index = freeSlot;
+  freeSlot = handle.slot;
+}
+
+bool Scene::isValid(ObjectHandle handle) const {
+  return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation;
+}
+
+void Scene::setTransform(ObjectHandle handle, const glm::mat4& transform) {
+  if (!isValid(handle)) return;
+  localTransforms[indexOf(handle)] = transform;
+  markDirty(handle.slot);
+}
+
+void Scene::setParent(ObjectHandle handle, ObjectHandle parent) {
+  if (!isValid(handle)) return;
+  // An object cannot become its own ancestor
+  for (uint32_t slot = isValid(parent) ? parent.slot : kNoSlot; slot != kNoSlot; slot = slots[slot].parent) {
+    if (slot == handle.slot) return;
+  }
+  unlink(handle.slot);
+  if (isValid(parent)) link(handle.slot, parent.slot);
+  markDirty(handle.slot);
+}
+
+void Scene::setMaterial(ObjectHandle handle, int materialIndex) {
+  if (!isValid(handle)) return;
+  materialIndices[indexOf(handle)] = materialIndex;
+}
+
+void Scene::setTexture(ObjectHandle handle, int textureIndex) {
+  if (!isValid(handle)) return;
+  textureIndices[indexOf(handle)] = textureIndex;
+}
+
+int Scene::addMaterial(const Material& material) {
+  materials.push_back(material);
+  return (int)materials.size() - 1;
+}
+
+void Scene::updateTransforms() {
+  if (!anyDirty) return;
+  anyDirty = false;
+  // Global transforms depend on the parent's, so they are resolved in hierarchy order
+  for (size_t i = 0; i < size(); i++) {
+    if (dirty[i] == kDirty) resolveGlobal(i);
+  }
+  // What follows only depends on the object itself, a straight batch over the arrays
+  parallelFor([this](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      if (dirty[i] == kClean) continue;
+      dirty[i] = kClean;
+      const Model* model = models[modelIndices[i]];
+      glm::mat4 world = globalTransforms[i] * model->modelMatrix;
+      worldMatrices[i] = world;
+      normalMatrices[i] = glm::transpose(glm::inverse(glm::mat3(world)));
+      // Box around the eight transformed corners of the model's box
+      glm::vec3 lower(1e30f), upper(-1e30f);
+      for (int k = 0; k < 8; k++) {
+        glm::vec3 corner(k & 1 ? model->boundsMax.x : model->boundsMin.x,
+                         k & 2 ? model->boundsMax.y : model->boundsMin.y,
+                         k & 4 ? model->boundsMax.z : model->boundsMin.z);
+        glm::vec3 point = glm::vec3(world * glm::vec4(corner, 1.0f));
+        lower = glm::min(lower, point);
+        upper = glm::max(upper, point);
+      }
+      boundsMin[i] = lower;
+      boundsMax[i] = upper;
+    }
+  });
+}
+
+void Scene::markDirty(uint32_t slot) {
+  anyDirty = true;
+  dirty[slots[slot].index] = kDirty;
+  for (uint32_t child = slots[slot].firstChild; child != kNoSlot; child = slots[child].nextSibling) markDirty(child);
+}
+
+void Scene::link(uint32_t slot, uint32_t parent) {
+  slots[slot].parent = parent;
+  slots[slot].nextSibling = slots[parent].firstChild;
+  slots[parent].firstChild = slot;
+}
+
+void Scene::unlink(uint32_t slot) {
+  uint32_t parent = slots[slot].parent;
+  if (parent == kNoSlot) return;
+  uint32_t* next = &slots[parent].firstChild;
+  while (*next != slot) next = &slots[*next].nextSibling;
+  *next = slots[slot].nextSibling;
+  slots[slot].parent = kNoSlot;
+  slots[slot].nextSibling = kNoSlot;
+}
+
+void Scene::resolveGlobal(size_t index) {
+  uint32_t parent = slots[slotOf[index]].parent;
+  if (parent == kNoSlot) {
+    globalTransforms[index] = localTransforms[index];
+  } else {
+    size_t parentIndex = slots[parent].index;
+    if (dirty[parentIndex] == kDirty) resolveGlobal(parentIndex);
+    globalTransforms[index] = globalTransforms[parentIndex] * localTransforms[index];
+  }
+  dirty[index] = kGlobalResolved;
+}
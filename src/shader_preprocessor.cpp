@@ -0,0 +1,89 @@
+#include "shader_preprocessor.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "gl_helper.h"
+
+namespace {
+// Source string number of filename, a new one for a file not seen yet
+size_t sourceNumber(const std::filesystem::path& filename, std::vector<std::string>& files) {
+  size_t number = std::find(files.begin(), files.end(), filename.string()) - files.begin();
+  if (number == files.size()) files.push_back(filename.string());
+  return number;
+}
+
+// Append filename to output with its #include lines replaced by the files
+// they name. Every include is pasted, the include files have guards. #line
+// directives keep driver errors on the original lines, the source string
+// number of a file is its index in files.
+bool expandIncludes(const std::filesystem::path& filename, std::vector<std::filesystem::path>& expanding,
+                    std::vector<std::string>& files, std::string& output) {
+  std::string source;
+  if (!readShaderFile(filename.string().c_str(), source)) return false;
+  size_t number = sourceNumber(filename, files);
+  expanding.push_back(filename);
+  std::istringstream lines(source);
+  std::string line;
+  for (int lineNumber = 1; std::getline(lines, line); lineNumber++) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+      output += line;
+      output += '\n';
+      continue;
+    }
+    size_t open = line.find('"', start);
+    size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+    if (close == std::string::npos) {
+      std::cout << "Shader " << filename.string() << ": malformed " << line << std::endl;
+      return false;
+    }
+    std::filesystem::path include = filename.parent_path() / line.substr(open + 1, close - open - 1);
+    include = include.lexically_normal();
+    if (std::find(expanding.begin(), expanding.end(), include) != expanding.end()) {
+      std::cout << "Shader " << filename.string() << ": " << include.string() << " includes itself" << std::endl;
+      return false;
+    }
+    output += "#line 1 " + std::to_string(sourceNumber(include, files)) + "\n";
+    if (!expandIncludes(include, expanding, files, output)) {
+      std::cout << "Shader " << filename.string() << ": cannot include " << include.string() << std::endl;
+      return false;
+    }
+    output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(number) + "\n";
+  }
+  expanding.pop_back();
+  return true;
+}
+}  // namespace
+
+ShaderDefines& ShaderDefines::set(const std::string& name, const std::string& value) {
+  values[name] = value;
+  return *this;
+}
+
+std::string ShaderDefines::str() const {
+  std::string text;
+  for (const auto& [name, value] : values) text += "#define " + name + " " + value + "\n";
+  return text;
+}
+
+bool preprocessShader(const std::string& filename, const ShaderDefines& defines, std::string& source,
+                      std::vector<std::string>* files) {
+  std::vector<std::filesystem::path> expanding;
+  std::vector<std::string> sourceFiles;
+  source.clear();
+  if (!expandIncludes(std::filesystem::path(filename).lexically_normal(), expanding, sourceFiles, source)) return false;
+  if (files) *files = std::move(sourceFiles);
+  if (defines.empty()) return true;
+  // #version has to stay the first line
+  size_t lineEnd = source.rfind("#version", 0) == 0 ? source.find('\n') : std::string::npos;
+  if (lineEnd == std::string::npos) {
+    source = defines.str() + "#line 1 0\n" + source;
+  } else {
+    source.insert(lineEnd + 1, defines.str() + "#line 2 0\n");
+  }
+  return true;
+}
@@ -0,0 +1,47 @@
+#include "shader_reflection.h"
+
+#include <algorithm>
+#include <vector>
+
+void ShaderReflection::reflect(GLuint program) {
+  locations.clear();
+  blocks.clear();
+
+  GLint count = 0, maxLength = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<GLchar> name(std::max(maxLength, 1));
+  for (GLint i = 0; i < count; i++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+    std::string uniform(name.data(), length);
+    GLint location = glGetUniformLocation(program, uniform.c_str());
+    // Members of uniform blocks have no location
+    if (location < 0) continue;
+    locations[uniform] = location;
+    if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+      locations[uniform.substr(0, uniform.size() - 3)] = location;
+    }
+  }
+
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+  name.resize(std::max(maxLength, 1));
+  for (GLint i = 0; i < count; i++) {
+    GLsizei length = 0;
+    glGetActiveUniformBlockName(program, (GLuint)i, (GLsizei)name.size(), &length, name.data());
+    blocks[std::string(name.data(), length)] = (GLuint)i;
+  }
+}
+
+GLint ShaderReflection::location(const std::string& name) const {
+  auto iter = locations.find(name);
+  return iter == locations.end() ? -1 : iter->second;
+}
+
+GLuint ShaderReflection::blockIndex(const std::string& name) const {
+  auto iter = blocks.find(name);
+  return iter == blocks.end() ? GL_INVALID_INDEX : iter->second;
+}
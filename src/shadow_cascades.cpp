@@ -0,0 +1,132 @@
+#include "shadow_cascades.h"
+
+#include <cmath>
+#include <iostream>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "gl_state.h"
+#include "program.h"
+
+ShadowCascades::ShadowCascades(const glm::vec3& sceneMin, const glm::vec3& sceneMax)
+    : sceneCenter((sceneMin + sceneMax) * 0.5f), sceneRadius(glm::length(sceneMax - sceneMin) * 0.5f) {
+  glGenTextures(1, &texture);
+  GLState::bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, kResolution, kResolution, kCascades, 0,
+               GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+  // Linear filtering of comparisons gives 2x2 PCF for free
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "Shadow framebuffer incomplete, shadows disabled" << std::endl;
+    glDeleteFramebuffers(1, &framebuffer);
+    framebuffer = 0;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  for (glm::mat4& matrix : matrices) matrix = glm::identity<glm::mat4>();
+}
+
+ShadowCascades::~ShadowCascades() {
+  if (framebuffer != 0) glDeleteFramebuffers(1, &framebuffer);
+  GLState::deleteTextures(1, &texture);
+}
+
+glm::mat4 ShadowCascades::fitSphere(const glm::vec3& center, float radius) const {
+  // Any up vector not parallel to the sun works
+  glm::vec3 up = std::abs(sunDirection.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+  // Far enough towards the sun that every caster of the scene is in front
+  float distance = radius + sceneRadius + glm::length(center - sceneCenter);
+  glm::mat4 lightView = glm::lookAt(center + sunDirection * distance, center, up);
+  glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, distance + radius);
+
+  // Move by less than a texel so texels stay at fixed world positions
+  glm::mat4 matrix = lightProjection * lightView;
+  glm::vec4 origin = matrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  float texelsPerUnit = kResolution * 0.5f;
+  glm::vec2 snapped = glm::vec2(origin.x, origin.y) * texelsPerUnit;
+  glm::vec2 offset = (glm::vec2(std::round(snapped.x), std::round(snapped.y)) - snapped) / texelsPerUnit;
+  glm::mat4 snap = glm::translate(glm::identity<glm::mat4>(), glm::vec3(offset, 0.0f));
+  return snap * matrix;
+}
+
+void ShadowCascades::frustumSphere(const glm::mat4& view, const glm::mat4& projection, float from, float to,
+                                   glm::vec3& center, float& radius) const {
+  float tanY = 1.0f / projection[1][1];
+  float tanX = 1.0f / projection[0][0];
+  glm::mat4 cameraToWorld = glm::inverse(view);
+  glm::vec3 corners[8];
+  for (int i = 0; i < 8; i++) {
+    float depth = (i & 4) ? to : from;
+    glm::vec3 corner((i & 1 ? 1.0f : -1.0f) * tanX * depth, (i & 2 ? 1.0f : -1.0f) * tanY * depth, -depth);
+    corners[i] = glm::vec3(cameraToWorld * glm::vec4(corner, 1.0f));
+  }
+  center = glm::vec3(0.0f);
+  for (const glm::vec3& corner : corners) center += corner;
+  center /= 8.0f;
+  radius = 0.0f;
+  for (const glm::vec3& corner : corners) radius = std::max(radius, glm::length(corner - center));
+  // A size that does not change with the view keeps the texel snapping exact
+  radius = std::ceil(radius * 4.0f) / 4.0f;
+}
+
+void ShadowCascades::update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& sun,
+                            uint64_t frame) {
+  sunDirection = glm::normalize(sun);
+  enabled = framebuffer != 0 && sunDirection.y > kMinSunHeight;
+  for (bool& cascade : due) cascade = false;
+  if (!enabled) return;
+  frames++;
+
+  float splits[kCascades] = {0.0f, kSplit0, kSplit1};
+  due[0] = true;
+  due[1] = !valid || frame % kMiddleInterval == 0;
+  float sunMoved = glm::degrees(std::acos(glm::clamp(glm::dot(sunDirection, farSunDirection), -1.0f, 1.0f)));
+  due[2] = !valid || sunMoved > kFarSunThreshold;
+  for (int cascade = 0; cascade < 2; cascade++) {
+    if (!due[cascade]) continue;
+    glm::vec3 center;
+    float radius;
+    frustumSphere(view, projection, std::max(splits[cascade], 0.1f), splits[cascade + 1], center, radius);
+    matrices[cascade] = fitSphere(center, radius);
+  }
+  if (due[2]) {
+    matrices[2] = fitSphere(sceneCenter, sceneRadius);
+    farSunDirection = sunDirection;
+  }
+  for (int cascade = 0; cascade < kCascades; cascade++) renders[cascade] += due[cascade];
+  valid = true;
+}
+
+void ShadowCascades::beginCascade(int cascade) const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, cascade);
+  glViewport(0, 0, kResolution, kResolution);
+  glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowCascades::bind(const Program* program, int unit) const {
+  GLState::bindTexture(unit, GL_TEXTURE_2D_ARRAY, texture);
+  glUniform1i(program->uniform("ShadowMap"), unit);
+  glUniform1i(program->uniform("ShadowEnabled"), enabled);
+  glUniformMatrix4fv(program->uniform("ShadowMatrices"), kCascades, GL_FALSE, glm::value_ptr(matrices[0]));
+  glUniform2f(program->uniform("ShadowSplits"), kSplit0, kSplit1);
+}
+
+void ShadowCascades::printReport() const {
+  std::cout << "Shadow cascades: " << frames << " frames with sun, rendered";
+  for (int cascade = 0; cascade < kCascades; cascade++) std::cout << " " << renders[cascade];
+  std::cout << " times, " << kCascades * frames - (renders[0] + renders[1] + renders[2]) << " renders saved"
+            << std::endl;
+}
@@ -0,0 +1,137 @@
+#include "terrain_material.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "gl_state.h"
+#include "model.h"
+
+namespace {
+// Twice the signed area of (a, b, c)
+float edge(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
+  return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+}  // namespace
+
+TerrainMaterial::TerrainMaterial(TextureCache* cache, const std::vector<std::string>& layerFiles, int layerSize)
+    : layers(cache->getArray(layerFiles, layerSize)) {}
+
+TerrainMaterial::~TerrainMaterial() {
+  if (splatMap != 0) GLState::deleteTextures(1, &splatMap);
+}
+
+void TerrainMaterial::createSplatMap(glm::vec2 min, glm::vec2 max, int size) {
+  boundsMin = min;
+  boundsMax = max;
+  resolution = size;
+  // Until a chunk is baked everything shows layer 0
+  weights.assign((size_t)size * size * 4, 0);
+  for (size_t i = 0; i < weights.size(); i += 4) weights[i] = 255;
+
+  if (splatMap == 0) glGenTextures(1, &splatMap);
+  GLState::bindTexture(GL_TEXTURE_2D, splatMap);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, weights.data());
+  GLState::countUpload(weights.size());
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  GLState::bindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TerrainMaterial::bakeChunk(const Model* chunk, const glm::mat4& worldMatrix, const WeightFunction& weightOf) {
+  if (splatMap == 0 || chunk->drawMode != GL_TRIANGLES) return;
+  auto begin = std::chrono::steady_clock::now();
+  glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(worldMatrix)));
+  glm::vec2 texelsPerUnit = glm::vec2((float)resolution) / (boundsMax - boundsMin);
+
+  size_t first = 0, count = chunk->numIndex > 0 ? chunk->numIndex : chunk->numVertex;
+  if (!chunk->lods.empty()) first = chunk->lods[0].firstIndex, count = chunk->lods[0].numIndex;
+  auto vertex = [&](size_t i) -> size_t { return chunk->numIndex > 0 ? chunk->indices[first + i] : first + i; };
+
+  // Rasterize the triangles into the splat map, interpolating the surface at every texel center
+  int minX = resolution, minY = resolution, maxX = -1, maxY = -1;
+  for (size_t i = 0; i + 2 < count; i += 3) {
+    glm::vec3 positions[3], normals[3];
+    glm::vec2 texels[3];
+    for (int k = 0; k < 3; k++) {
+      size_t v = vertex(i + k);
+      glm::vec3 position(chunk->positions[v * 3], chunk->positions[v * 3 + 1], chunk->positions[v * 3 + 2]);
+      positions[k] = glm::vec3(worldMatrix * glm::vec4(position, 1.0f));
+      glm::vec3 normal(chunk->normals[v * 3], chunk->normals[v * 3 + 1], chunk->normals[v * 3 + 2]);
+      normals[k] = normalMatrix * normal;
+      texels[k] = (glm::vec2(positions[k].x, positions[k].z) - boundsMin) * texelsPerUnit;
+    }
+    float area = edge(texels[0], texels[1], texels[2]);
+    if (std::abs(area) < 1e-8f) continue;
+
+    int x0 = std::max((int)std::floor(std::min({texels[0].x, texels[1].x, texels[2].x})), 0);
+    int x1 = std::min((int)std::ceil(std::max({texels[0].x, texels[1].x, texels[2].x})), resolution - 1);
+    int y0 = std::max((int)std::floor(std::min({texels[0].y, texels[1].y, texels[2].y})), 0);
+    int y1 = std::min((int)std::ceil(std::max({texels[0].y, texels[1].y, texels[2].y})), resolution - 1);
+    for (int y = y0; y <= y1; y++) {
+      for (int x = x0; x <= x1; x++) {
+        glm::vec2 center(x + 0.5f, y + 0.5f);
+        float w0 = edge(texels[1], texels[2], center) / area;
+        float w1 = edge(texels[2], texels[0], center) / area;
+        float w2 = 1.0f - w0 - w1;
+        // A little slack so texels on shared edges are not missed
+        if (w0 < -1e-4f || w1 < -1e-4f || w2 < -1e-4f) continue;
+
+        glm::vec3 position = positions[0] * w0 + positions[1] * w1 + positions[2] * w2;
+        glm::vec3 normal = glm::normalize(normals[0] * w0 + normals[1] * w1 + normals[2] * w2);
+        glm::vec4 weight = weightOf(position, normal);
+        for (int c = 0; c < 4; c++) weight[c] = std::max(weight[c], 0.0f);
+        float sum = weight[0] + weight[1] + weight[2] + weight[3];
+        weight = sum > 0.0f ? weight * (1.0f / sum) : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+
+        unsigned char* texel = &weights[((size_t)y * resolution + x) * 4];
+        for (int c = 0; c < 4; c++) texel[c] = (unsigned char)(weight[c] * 255.0f + 0.5f);
+        minX = std::min(minX, x), maxX = std::max(maxX, x);
+        minY = std::min(minY, y), maxY = std::max(maxY, y);
+      }
+    }
+  }
+
+  if (maxX >= minX) {
+    GLState::bindTexture(GL_TEXTURE_2D, splatMap);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, resolution);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, minX, minY, maxX - minX + 1, maxY - minY + 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                    &weights[((size_t)minY * resolution + minX) * 4]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    GLState::countUpload((size_t)(maxX - minX + 1) * (maxY - minY + 1) * 4);
+    GLState::bindTexture(GL_TEXTURE_2D, 0);
+    mipsStale = true;
+  }
+  chunksBaked++;
+  bakeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void TerrainMaterial::finishBakes() {
+  if (!mipsStale) return;
+  auto begin = std::chrono::steady_clock::now();
+  GLState::bindTexture(GL_TEXTURE_2D, splatMap);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  GLState::bindTexture(GL_TEXTURE_2D, 0);
+  mipsStale = false;
+  bakeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void TerrainMaterial::bind(GLuint programId, int firstUnit) const {
+  GLState::bindTexture(firstUnit, GL_TEXTURE_2D_ARRAY, layers);
+  glUniform1i(glGetUniformLocation(programId, "layers"), firstUnit);
+  GLState::bindTexture(firstUnit + 1, GL_TEXTURE_2D, splatMap);
+  glUniform1i(glGetUniformLocation(programId, "splatMap"), firstUnit + 1);
+  // splat coordinate = world xz * scale + offset
+  glm::vec2 scale = 1.0f / (boundsMax - boundsMin);
+  glUniform4f(glGetUniformLocation(programId, "SplatTransform"), scale.x, scale.y, -boundsMin.x * scale.x,
+              -boundsMin.y * scale.y);
+}
+
+void TerrainMaterial::printStats() const {
+  std::cout << "Terrain material: " << resolution << "x" << resolution << " splat map, " << chunksBaked
+            << " chunk bakes in " << bakeMs << " ms" << std::endl;
+}
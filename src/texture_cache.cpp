@@ -0,0 +1,140 @@
+#include "texture_cache.h"
+
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+#include "gl_state.h"
+#include "texture_loader.h"
+
+namespace {
+// Resolve "..", "." and symlinks so different spellings of a path share an entry
+std::string canonicalPath(const std::string& filename) {
+  std::error_code error;
+  std::filesystem::path path = std::filesystem::weakly_canonical(filename, error);
+  return error ? filename : path.string();
+}
+}  // namespace
+
+TextureHandle::TextureHandle(TextureCache* cache, int entry) : cache(cache), entry(entry) {
+  if (cache) cache->addReference(entry);
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other) : TextureHandle(other.cache, other.entry) {}
+
+TextureHandle::TextureHandle(TextureHandle&& other) noexcept
+    : cache(std::exchange(other.cache, nullptr)), entry(std::exchange(other.entry, -1)) {}
+
+TextureHandle& TextureHandle::operator=(TextureHandle other) noexcept {
+  std::swap(cache, other.cache);
+  std::swap(entry, other.entry);
+  return *this;
+}
+
+TextureHandle::~TextureHandle() {
+  if (cache) cache->release(entry);
+}
+
+GLuint TextureHandle::id() const { return cache ? cache->entries[entry].id : 0; }
+
+TextureCache::TextureCache(TextureLoader* loader, size_t budgetBytes) : loader(loader), budgetBytes(budgetBytes) {
+  loader->setResidentCallback([this](GLuint id, size_t bytes) { onResident(id, bytes); });
+}
+
+TextureCache::~TextureCache() {
+  loader->setResidentCallback(nullptr);
+  for (Entry& entry : entries) {
+    if (entry.id != 0) GLState::deleteTextures(1, &entry.id);
+  }
+}
+
+TextureHandle TextureCache::acquire(const std::string& key, const std::function<GLuint()>& create) {
+  auto iter = entryByKey.find(key);
+  if (iter != entryByKey.end()) {
+    hits++;
+    return TextureHandle(this, iter->second);
+  }
+  int index = (int)entries.size();
+  entries.push_back(Entry{key, create()});
+  entryByKey[key] = index;
+  entryById[entries[index].id] = index;
+  return TextureHandle(this, index);
+}
+
+TextureHandle TextureCache::get(const std::string& filename, glm::vec4 placeholder) {
+  std::string path = canonicalPath(filename);
+  return acquire(path, [&] { return loader->load(path, placeholder); });
+}
+
+TextureHandle TextureCache::getCubemap(const std::vector<std::string>& faces) {
+  std::vector<std::string> paths;
+  std::string key = "cubemap";
+  for (const std::string& face : faces) {
+    paths.push_back(canonicalPath(face));
+    key += "|" + paths.back();
+  }
+  return acquire(key, [&] { return loader->loadCubemap(paths); });
+}
+
+TextureHandle TextureCache::getArray(const std::vector<std::string>& layers, int layerSize) {
+  std::vector<std::string> paths;
+  std::string key = "array" + std::to_string(layerSize);
+  for (const std::string& layer : layers) {
+    paths.push_back(canonicalPath(layer));
+    key += "|" + paths.back();
+  }
+  return acquire(key, [&] { return loader->loadArray(paths, layerSize); });
+}
+
+void TextureCache::addReference(int entry) { entries[entry].references++; }
+
+void TextureCache::release(int entry) {
+  if (--entries[entry].references > 0) return;
+  entries[entry].releasedAt = ++tick;
+  evict();
+}
+
+void TextureCache::onResident(GLuint id, size_t bytes) {
+  auto iter = entryById.find(id);
+  if (iter == entryById.end()) return;
+  // Streamed textures report again whenever their resident levels change
+  Entry& entry = entries[iter->second];
+  residentBytes = residentBytes - entry.bytes + bytes;
+  entry.bytes = bytes;
+  evict();
+}
+
+void TextureCache::evict() {
+  while (residentBytes > budgetBytes) {
+    // Only resident textures are evicted, the loader still writes to loading ones
+    int oldest = -1;
+    for (int i = 0; i < (int)entries.size(); i++) {
+      const Entry& entry = entries[i];
+      if (entry.id == 0 || entry.references > 0 || entry.bytes == 0) continue;
+      if (oldest < 0 || entry.releasedAt < entries[oldest].releasedAt) oldest = i;
+    }
+    if (oldest < 0) return;
+
+    Entry& entry = entries[oldest];
+    std::cout << "Texture cache: evicting " << entry.key << " (" << entry.bytes / 1024 << " KB)" << std::endl;
+    loader->forget(entry.id);
+    GLState::deleteTextures(1, &entry.id);
+    residentBytes -= entry.bytes;
+    entryByKey.erase(entry.key);
+    entryById.erase(entry.id);
+    entry.id = 0;
+    entry.bytes = 0;
+  }
+}
+
+void TextureCache::printReport() const {
+  std::cout << "Texture cache: " << entryByKey.size() << " textures, " << hits << " duplicate loads shared, "
+            << residentBytes / 1024 << " KB of " << budgetBytes / 1024 << " KB budget" << std::endl;
+  for (const Entry& entry : entries) {
+    if (entry.id == 0) continue;
+    std::cout << "  " << std::right << std::setw(8) << entry.bytes / 1024 << " KB  refs " << std::setw(3)
+              << entry.references << "  " << entry.key << (entry.bytes == 0 ? " (loading)" : "") << std::left
+              << std::endl;
+  }
+}
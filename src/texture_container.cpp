@@ -0,0 +1,207 @@
+#include "texture_container.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// S3TC is an extension, the loader may not have generated these
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+namespace {
+constexpr uint64_t kLevelAlignment = 16;
+}  // namespace
+
+bool isCompressed(TextureFileFormat format) {
+  return format == TextureFileFormat::BC1 || format == TextureFileFormat::BC3 || format == TextureFileFormat::BC5;
+}
+
+size_t textureLevelSize(TextureFileFormat format, uint32_t width, uint32_t height) {
+  size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+  size_t pixels = (size_t)width * height;
+  switch (format) {
+    case TextureFileFormat::R8:
+      return pixels;
+    case TextureFileFormat::RG8:
+      return pixels * 2;
+    case TextureFileFormat::RGB8:
+      return pixels * 3;
+    case TextureFileFormat::RGBA8:
+      return pixels * 4;
+    case TextureFileFormat::BC1:
+      return blocks * 8;
+    case TextureFileFormat::BC3:
+    case TextureFileFormat::BC5:
+      return blocks * 16;
+  }
+  return 0;
+}
+
+GLenum textureInternalFormat(TextureFileFormat format, bool srgb) {
+  switch (format) {
+    case TextureFileFormat::R8:
+      return GL_R8;
+    case TextureFileFormat::RG8:
+      return GL_RG8;
+    case TextureFileFormat::RGB8:
+      return srgb ? GL_SRGB8 : GL_RGB8;
+    case TextureFileFormat::RGBA8:
+      return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    case TextureFileFormat::BC1:
+      return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TextureFileFormat::BC3:
+      return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TextureFileFormat::BC5:
+      return GL_COMPRESSED_RG_RGTC2;
+  }
+  return GL_RGBA8;
+}
+
+GLenum texturePixelFormat(TextureFileFormat format) {
+  switch (format) {
+    case TextureFileFormat::R8:
+      return GL_RED;
+    case TextureFileFormat::RG8:
+      return GL_RG;
+    case TextureFileFormat::RGB8:
+      return GL_RGB;
+    default:
+      return GL_RGBA;
+  }
+}
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& path) {
+  close();
+#ifdef _WIN32
+  HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (handle == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(handle);
+    return false;
+  }
+  HANDLE view = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (view == nullptr) {
+    CloseHandle(handle);
+    return false;
+  }
+  bytes = static_cast<const unsigned char*>(MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0));
+  if (bytes == nullptr) {
+    CloseHandle(view);
+    CloseHandle(handle);
+    return false;
+  }
+  file = handle;
+  mapping = view;
+  length = (size_t)fileSize.QuadPart;
+#else
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) return false;
+  struct stat status;
+  if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+    ::close(descriptor);
+    return false;
+  }
+  void* address = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  // The mapping stays valid after the descriptor is closed
+  ::close(descriptor);
+  if (address == MAP_FAILED) return false;
+  bytes = static_cast<const unsigned char*>(address);
+  length = (size_t)status.st_size;
+#endif
+  return true;
+}
+
+void MappedFile::close() {
+  if (bytes == nullptr) return;
+#ifdef _WIN32
+  UnmapViewOfFile(bytes);
+  CloseHandle(mapping);
+  CloseHandle(file);
+  mapping = file = nullptr;
+#else
+  munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+  bytes = nullptr;
+  length = 0;
+}
+
+bool parseTextureFile(const MappedFile& file, TextureFileView* view) {
+  if (file.size() < sizeof(TextureFileHeader)) return false;
+  const TextureFileHeader* header = reinterpret_cast<const TextureFileHeader*>(file.data());
+  if (std::memcmp(header->magic, kTextureFileMagic, sizeof(kTextureFileMagic)) != 0) return false;
+  if (header->version != kTextureFileVersion || header->format > (uint32_t)TextureFileFormat::BC5) return false;
+  if (header->width == 0 || header->height == 0 || header->levels == 0 || header->levels > 32) return false;
+  if (file.size() < sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * header->levels) return false;
+
+  const TextureFileLevel* levels = reinterpret_cast<const TextureFileLevel*>(header + 1);
+  TextureFileFormat format = (TextureFileFormat)header->format;
+  for (uint32_t i = 0; i < header->levels; i++) {
+    uint32_t width = std::max(1u, header->width >> i), height = std::max(1u, header->height >> i);
+    if (levels[i].size != textureLevelSize(format, width, height)) return false;
+    if (levels[i].offset > file.size() || levels[i].size > file.size() - levels[i].offset) return false;
+  }
+  view->header = header;
+  view->levels = levels;
+  return true;
+}
+
+bool writeTextureFile(const std::string& path, TextureFileFormat format, uint32_t flags, uint32_t width,
+                      uint32_t height, const std::vector<std::vector<unsigned char>>& levels) {
+  TextureFileHeader header;
+  std::memcpy(header.magic, kTextureFileMagic, sizeof(kTextureFileMagic));
+  header.version = kTextureFileVersion;
+  header.format = (uint32_t)format;
+  header.flags = flags;
+  header.width = width;
+  header.height = height;
+  header.levels = (uint32_t)levels.size();
+
+  std::vector<TextureFileLevel> table(levels.size());
+  uint64_t offset = sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * levels.size();
+  for (size_t i = 0; i < levels.size(); i++) {
+    offset = (offset + kLevelAlignment - 1) / kLevelAlignment * kLevelAlignment;
+    table[i] = TextureFileLevel{offset, levels[i].size()};
+    offset += levels[i].size();
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    std::cout << "Failed to open " << path << " for writing" << std::endl;
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(table.data()), sizeof(TextureFileLevel) * table.size());
+  const char padding[kLevelAlignment] = {};
+  for (size_t i = 0; i < levels.size(); i++) {
+    out.write(padding, table[i].offset - (uint64_t)out.tellp());
+    out.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+  }
+  return (bool)out;
+}
@@ -0,0 +1,528 @@
+#include "texture_loader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+#include <stb_image.h>
+
+#include "gl_state.h"
+#include "profiler.h"
+
+namespace {
+// Pixels copied into a PBO per step, small enough to stay inside a frame budget
+constexpr size_t kStageSliceBytes = 1 << 20;
+
+double millisecondsBetween(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// Pixel transfer format and sized internal format for a channel count
+void formatOf(int channels, GLenum* format, GLint* internalFormat) {
+  switch (channels) {
+    case 1:
+      *format = GL_RED, *internalFormat = GL_R8;
+      break;
+    case 2:
+      *format = GL_RG, *internalFormat = GL_RG8;
+      break;
+    case 4:
+      *format = GL_RGBA, *internalFormat = GL_RGBA8;
+      break;
+    case 3:
+    default:
+      *format = GL_RGB, *internalFormat = GL_RGB8;
+      break;
+  }
+}
+
+// Bytes per texel as stored by the GPU, drivers pad RGB8 to four bytes
+size_t texelBytes(int channels) { return channels == 3 ? 4 : channels; }
+
+int channelsOf(TextureFileFormat format) {
+  switch (format) {
+    case TextureFileFormat::R8:
+      return 1;
+    case TextureFileFormat::RG8:
+    case TextureFileFormat::BC5:
+      return 2;
+    case TextureFileFormat::RGB8:
+    case TextureFileFormat::BC1:
+      return 3;
+    default:
+      return 4;
+  }
+}
+
+// Bilinear resample of an RGBA8 image, used to give array layers one size
+unsigned char* resample(const unsigned char* pixels, int width, int height, int size) {
+  unsigned char* result = (unsigned char*)std::malloc((size_t)size * size * 4);
+  for (int y = 0; y < size; y++) {
+    float sy = std::max((y + 0.5f) * height / size - 0.5f, 0.0f);
+    int y0 = std::min((int)sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+    float fy = sy - y0;
+    for (int x = 0; x < size; x++) {
+      float sx = std::max((x + 0.5f) * width / size - 0.5f, 0.0f);
+      int x0 = std::min((int)sx, width - 1), x1 = std::min(x0 + 1, width - 1);
+      float fx = sx - x0;
+      for (int c = 0; c < 4; c++) {
+        auto at = [&](int px, int py) { return (float)pixels[((size_t)py * width + px) * 4 + c]; };
+        float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+        float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+        result[((size_t)y * size + x) * 4 + c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+      }
+    }
+  }
+  return result;
+}
+
+// Read one byte per page so the disk reads happen on the worker and not
+// during the PBO copy on the GL thread
+void prefetch(const unsigned char* data, size_t size) {
+  volatile unsigned char sink = 0;
+  for (size_t offset = 0; offset < size; offset += 4096) sink = sink + data[offset];
+}
+}  // namespace
+
+TextureLoader::TextureLoader(int workerCount) {
+  if (workerCount <= 0) workerCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+  // The flag is global in stb_image, set it once before any worker runs
+  stbi_set_flip_vertically_on_load(true);
+  // BC5 is core since GL 3.0, BC1 and BC3 need S3TC
+  s3tcSupported = GLAD_GL_EXT_texture_compression_s3tc;
+  if (!s3tcSupported) std::cout << "No S3TC support, BC1 / BC3 textures load from their source images" << std::endl;
+  for (int i = 0; i < workerCount; i++) workers.emplace_back(&TextureLoader::workerLoop, this);
+}
+
+TextureLoader::~TextureLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  jobReady.notify_all();
+  for (std::thread& worker : workers) worker.join();
+
+  for (auto& [index, texture] : pending) {
+    for (StagedFace& face : texture.faces) {
+      if (face.pixelBuffer == 0) continue;
+      if (face.mapped) {
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, face.pixelBuffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      }
+      GLState::deleteBuffers(1, &face.pixelBuffer);
+    }
+  }
+}
+
+GLuint TextureLoader::createPlaceholder(GLenum target, glm::vec4 color, int layers) {
+  std::vector<unsigned char> texel(4 * layers);
+  for (int i = 0; i < 4 * layers; i++) texel[i] = (unsigned char)(glm::clamp(color[i % 4], 0.0f, 1.0f) * 255.0f + 0.5f);
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  GLState::bindTexture(target, texture);
+  if (target == GL_TEXTURE_CUBE_MAP) {
+    for (int face = 0; face < 6; face++) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                   texel.data());
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  } else {
+    // A single 1x1 level is a complete mip chain, so the final filter can be set now
+    if (target == GL_TEXTURE_2D_ARRAY) {
+      glTexImage3D(target, 0, GL_RGBA8, 1, 1, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel.data());
+    } else {
+      glTexImage2D(target, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel.data());
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  }
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  GLState::bindTexture(target, 0);
+  return texture;
+}
+
+void TextureLoader::enqueue(GLuint id, GLenum target, const std::vector<std::string>& files, int layerSize) {
+  int index = nextPending++;
+  pending.emplace(index, PendingTexture{id, target, std::vector<StagedFace>(files.size()), 0});
+  texturesLeft++;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Cube maps always load every level, only 2D textures stream
+    int tailSize = target == GL_TEXTURE_2D ? streamingTail : 0;
+    for (int face = 0; face < (int)files.size(); face++) {
+      jobs.push_back(DecodeJob{index, face, files[face], tailSize, layerSize});
+    }
+  }
+  jobReady.notify_all();
+}
+
+GLuint TextureLoader::load(const std::string& filename, glm::vec4 placeholder) {
+  Clock::time_point begin = Clock::now();
+  GLuint id = createPlaceholder(GL_TEXTURE_2D, placeholder);
+  enqueue(id, GL_TEXTURE_2D, {filename});
+  blockedMs += millisecondsBetween(begin, Clock::now());
+  return id;
+}
+
+GLuint TextureLoader::loadCubemap(const std::vector<std::string>& faces) {
+  Clock::time_point begin = Clock::now();
+  GLuint id = createPlaceholder(GL_TEXTURE_CUBE_MAP, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+  enqueue(id, GL_TEXTURE_CUBE_MAP, faces);
+  blockedMs += millisecondsBetween(begin, Clock::now());
+  return id;
+}
+
+GLuint TextureLoader::loadArray(const std::vector<std::string>& layers, int layerSize) {
+  Clock::time_point begin = Clock::now();
+  GLuint id = createPlaceholder(GL_TEXTURE_2D_ARRAY, glm::vec4(0.5f, 0.5f, 0.5f, 1.0f), (int)layers.size());
+  enqueue(id, GL_TEXTURE_2D_ARRAY, layers, layerSize);
+  blockedMs += millisecondsBetween(begin, Clock::now());
+  return id;
+}
+
+bool TextureLoader::canUpload(const TextureFileHeader* header) const {
+  TextureFileFormat format = (TextureFileFormat)header->format;
+  return s3tcSupported || (format != TextureFileFormat::BC1 && format != TextureFileFormat::BC3);
+}
+
+void TextureLoader::workerLoop() {
+  while (true) {
+    DecodeJob job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+      if (stopping) return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+
+    PROFILE_SCOPE("Decode texture");
+    Clock::time_point begin = Clock::now();
+    DecodedImage image{job.texture, job.face};
+    if (job.file) {
+      // Stream job, the file is already mapped and validated
+      image.file = job.file;
+      image.view = job.view;
+      image.firstLevel = job.firstLevel;
+      image.endLevel = job.endLevel;
+    } else if (job.layerSize == 0) {
+      auto file = std::make_shared<MappedFile>();
+      std::string container = std::filesystem::path(job.filename).replace_extension(kTextureFileExtension).string();
+      if (file->open(container) && parseTextureFile(*file, &image.view) && canUpload(image.view.header)) {
+        const TextureFileHeader* header = image.view.header;
+        image.file = std::move(file);
+        image.endLevel = (int)header->levels;
+        while (job.tailSize > 0 && image.firstLevel + 1 < image.endLevel &&
+               std::max(header->width, header->height) >> image.firstLevel > (uint32_t)job.tailSize) {
+          image.firstLevel++;
+        }
+      }
+    }
+
+    if (image.file) {
+      const TextureFileHeader* header = image.view.header;
+      const TextureFileLevel& first = image.view.levels[image.firstLevel];
+      const TextureFileLevel& last = image.view.levels[image.endLevel - 1];
+      image.width = (int)header->width;
+      image.height = (int)header->height;
+      image.channels = channelsOf((TextureFileFormat)header->format);
+      image.source = image.file->data() + first.offset;
+      image.size = last.offset + last.size - first.offset;
+      prefetch(image.source, image.size);
+    } else {
+      // Array layers share one format, so they are always expanded to RGBA
+      int channels = job.layerSize > 0 ? 4 : 0;
+      unsigned char* pixels = stbi_load(job.filename.c_str(), &image.width, &image.height, &image.channels, channels);
+      image.pixels = std::unique_ptr<unsigned char, void (*)(void*)>(pixels, stbi_image_free);
+      if (pixels && job.layerSize > 0) {
+        pixels = resample(pixels, image.width, image.height, job.layerSize);
+        image.pixels = std::unique_ptr<unsigned char, void (*)(void*)>(pixels, std::free);
+        image.width = image.height = job.layerSize;
+        image.channels = 4;
+      }
+      image.source = pixels;
+      image.size = (size_t)image.width * image.height * image.channels;
+      if (!pixels) {
+        std::cout << "Failed to load texture " << job.filename << std::endl;
+        image.width = image.height = 0;
+        image.size = 0;
+      }
+    }
+    Clock::time_point end = Clock::now();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      decodeMs += millisecondsBetween(begin, end);
+      decodedBytes += image.size;
+      imagesDecoded++;
+      if (image.file && !job.file) filesMapped++;
+      lastDecodeTime = end;
+      decoded.push_back(std::move(image));
+    }
+    imageReady.notify_all();
+  }
+}
+
+bool TextureLoader::stage(StagedFace& face, const Clock::time_point& deadline) {
+  size_t size = face.image.size;
+  if (size == 0) return true;
+
+  if (face.pixelBuffer == 0) {
+    glGenBuffers(1, &face.pixelBuffer);
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, face.pixelBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    face.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    // Other uploads must not read from this buffer
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  // Always copy one slice so a tiny budget still makes progress
+  do {
+    size_t slice = std::min(kStageSliceBytes, size - face.copied);
+    std::memcpy(face.mapped + face.copied, face.image.source + face.copied, slice);
+    face.copied += slice;
+  } while (face.copied < size && Clock::now() < deadline);
+  if (face.copied < size) return false;
+
+  GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, face.pixelBuffer);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  face.mapped = nullptr;
+  face.image.pixels.reset();
+  face.image.source = nullptr;
+  return true;
+}
+
+size_t TextureLoader::uploadLevels(GLenum target, const DecodedImage& image) {
+  const TextureFileHeader* header = image.view.header;
+  TextureFileFormat format = (TextureFileFormat)header->format;
+  GLenum internalFormat = textureInternalFormat(format, srgbDecode && (header->flags & kTextureFileSrgb));
+  size_t bytes = 0;
+  for (int level = image.firstLevel; level < image.endLevel; level++) {
+    const TextureFileLevel& entry = image.view.levels[level];
+    GLsizei width = std::max(1, image.width >> level), height = std::max(1, image.height >> level);
+    // Offset into the PBO, which starts at firstLevel
+    const void* offset = reinterpret_cast<const void*>(entry.offset - image.view.levels[image.firstLevel].offset);
+    if (isCompressed(format)) {
+      glCompressedTexImage2D(target, level, internalFormat, width, height, 0, (GLsizei)entry.size, offset);
+      bytes += entry.size;
+    } else {
+      glTexImage2D(target, level, internalFormat, width, height, 0, texturePixelFormat(format), GL_UNSIGNED_BYTE,
+                   offset);
+      bytes += (size_t)width * height * texelBytes(image.channels);
+    }
+  }
+  return bytes;
+}
+
+void TextureLoader::makeResident(PendingTexture& texture) {
+  bool complete = std::all_of(texture.faces.begin(), texture.faces.end(),
+                              [](const StagedFace& face) { return face.pixelBuffer != 0; });
+  if (complete && !texture.cancelled) {
+    size_t bytes = 0;
+    // Level range of texture files; empty means the mip chain is generated here
+    int firstLevel = 0, endLevel = 0;
+    // Switch from the placeholder in one step, the PBOs make the copies asynchronous
+    GLState::bindTexture(texture.target, texture.id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (texture.target == GL_TEXTURE_2D_ARRAY) {
+      // Allocate every layer, the loop fills them one by one
+      const DecodedImage& image = texture.faces[0].image;
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, image.width, image.height, (GLsizei)texture.faces.size(), 0,
+                   GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    for (int i = 0; i < (int)texture.faces.size(); i++) {
+      const DecodedImage& image = texture.faces[i].image;
+      GLenum target = texture.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : texture.target;
+      GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, texture.faces[i].pixelBuffer);
+      if (image.file) {
+        bytes += uploadLevels(target, image);
+        firstLevel = image.firstLevel;
+        endLevel = image.endLevel;
+        continue;
+      }
+      if (texture.target == GL_TEXTURE_2D_ARRAY) {
+        glTexSubImage3D(target, 0, 0, 0, i, image.width, image.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        bytes += (size_t)image.width * image.height * 4;
+        continue;
+      }
+      GLenum format;
+      GLint internalFormat;
+      formatOf(image.channels, &format, &internalFormat);
+      glTexImage2D(target, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+      bytes += (size_t)image.width * image.height * texelBytes(image.channels);
+    }
+    GLState::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    GLState::countUpload(bytes);
+
+    if (texture.streaming) {
+      // The finer levels are all defined now, start sampling them
+      StreamedTexture& entry = streamed[texture.id];
+      glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, firstLevel);
+      levelsStreamedIn += entry.baseLevel - firstLevel;
+      entry.baseLevel = firstLevel;
+      entry.loading = false;
+      bytes = entry.bytesFrom(firstLevel);
+    } else if (endLevel > 0) {
+      // Only [firstLevel, endLevel) is defined, keep sampling inside it
+      glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, firstLevel);
+      glTexParameteri(texture.target, GL_TEXTURE_MAX_LEVEL, endLevel - 1);
+      if (firstLevel > 0) {
+        const DecodedImage& image = texture.faces[0].image;
+        streamed[texture.id] = StreamedTexture{image.file, image.view, firstLevel, firstLevel, false};
+      }
+    } else if (texture.target == GL_TEXTURE_2D || texture.target == GL_TEXTURE_2D_ARRAY) {
+      glGenerateMipmap(texture.target);
+      // A full mip chain adds a third
+      bytes += bytes / 3;
+    }
+    GLState::bindTexture(texture.target, 0);
+    if (!texture.streaming) texturesResident++;
+    if (onResident) onResident(texture.id, bytes);
+  }
+
+  for (StagedFace& face : texture.faces) {
+    if (face.pixelBuffer != 0) GLState::deleteBuffers(1, &face.pixelBuffer);
+  }
+  texture.faces.clear();
+  texturesLeft--;
+}
+
+size_t TextureLoader::StreamedTexture::bytesFrom(int level) const {
+  const TextureFileHeader* header = view.header;
+  TextureFileFormat format = (TextureFileFormat)header->format;
+  size_t bytes = 0;
+  for (int i = level; i < levels(); i++) {
+    uint32_t width = std::max(1u, header->width >> i), height = std::max(1u, header->height >> i);
+    bytes += isCompressed(format) ? view.levels[i].size : (size_t)width * height * texelBytes(channelsOf(format));
+  }
+  return bytes;
+}
+
+const TextureLoader::StreamedTexture* TextureLoader::findStreamed(GLuint id) const {
+  auto iter = streamed.find(id);
+  return iter == streamed.end() ? nullptr : &iter->second;
+}
+
+void TextureLoader::streamIn(GLuint id, int level) {
+  auto iter = streamed.find(id);
+  if (iter == streamed.end()) return;
+  StreamedTexture& entry = iter->second;
+  level = std::max(level, 0);
+  if (entry.loading || level >= entry.baseLevel) return;
+
+  entry.loading = true;
+  int index = nextPending++;
+  pending.emplace(index, PendingTexture{id, GL_TEXTURE_2D, std::vector<StagedFace>(1), 0, true});
+  texturesLeft++;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(DecodeJob{index, 0, std::string(), 0, 0, entry.file, entry.view, level, entry.baseLevel});
+  }
+  jobReady.notify_all();
+}
+
+void TextureLoader::streamOut(GLuint id, int level) {
+  auto iter = streamed.find(id);
+  if (iter == streamed.end()) return;
+  StreamedTexture& entry = iter->second;
+  level = std::min(level, entry.levels() - 1);
+  if (entry.loading || level <= entry.baseLevel) return;
+
+  GLState::bindTexture(GL_TEXTURE_2D, id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+  // A 0x0 image releases a level, it is outside [BASE_LEVEL, MAX_LEVEL] so completeness is unaffected
+  for (int i = entry.baseLevel; i < level; i++) {
+    glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  }
+  GLState::bindTexture(GL_TEXTURE_2D, 0);
+  levelsStreamedOut += level - entry.baseLevel;
+  entry.baseLevel = level;
+  if (onResident) onResident(id, entry.bytesFrom(level));
+}
+
+void TextureLoader::forget(GLuint id) {
+  if (streamed.erase(id) == 0) return;
+  for (auto& [index, texture] : pending) {
+    if (texture.streaming && texture.id == id) texture.cancelled = true;
+  }
+}
+
+void TextureLoader::update(double budgetMs) {
+  if (texturesLeft == 0) return;
+  Clock::time_point begin = Clock::now();
+  Clock::time_point deadline = begin + std::chrono::duration_cast<Clock::duration>(
+                                           std::chrono::duration<double, std::milli>(budgetMs));
+
+  bool uploaded = false;
+  while (Clock::now() < deadline || !uploaded) {
+    if (staging.empty()) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (decoded.empty()) break;
+      DecodedImage& image = decoded.front();
+      staging.emplace_back(image.texture, image.face);
+      pending.at(image.texture).faces[image.face].image = std::move(image);
+      decoded.pop_front();
+    }
+
+    uploaded = true;
+    auto [index, face] = staging.front();
+    PendingTexture& texture = pending.at(index);
+    if (!stage(texture.faces[face], deadline)) break;
+    staging.pop_front();
+    if (++texture.facesStaged == (int)texture.faces.size()) {
+      makeResident(texture);
+      pending.erase(index);
+    }
+  }
+
+  if (uploaded) {
+    uploadMs += millisecondsBetween(begin, Clock::now());
+    framesUploading++;
+  }
+  if (texturesLeft == 0 && !reported) {
+    reported = true;
+    printReport();
+  }
+}
+
+void TextureLoader::finish() {
+  while (texturesLeft > 0) {
+    Clock::time_point begin = Clock::now();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      imageReady.wait(lock, [this] { return !decoded.empty() || !staging.empty(); });
+    }
+    blockedMs += millisecondsBetween(begin, Clock::now());
+    update(1e9);
+  }
+}
+
+bool TextureLoader::idle() const { return texturesLeft == 0; }
+
+void TextureLoader::printReport() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  double wallMs = millisecondsBetween(startTime, lastDecodeTime);
+  std::cout << std::fixed << std::setprecision(1) << "Texture loader: " << texturesResident << " textures from "
+            << imagesDecoded << " images (" << filesMapped << " mapped texture files), "
+            << decodedBytes / (1024.0 * 1024.0) << " MB decoded on " << workers.size() << " threads in " << wallMs
+            << " ms (" << decodeMs << " ms of decode work, "
+            << (wallMs > 0.0 ? decodeMs / wallMs : 1.0) << "x), " << uploadMs << " ms of uploads over "
+            << framesUploading << " frames, main thread blocked " << blockedMs << " ms" << std::defaultfloat
+            << std::endl;
+  if (!streamed.empty() || levelsStreamedIn > 0) {
+    std::cout << "Texture loader: " << streamed.size() << " textures streaming, " << levelsStreamedIn
+              << " levels streamed in, " << levelsStreamedOut << " streamed out" << std::endl;
+  }
+}
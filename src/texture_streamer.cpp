@@ -0,0 +1,138 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "model.h"
+#include "texture_loader.h"
+
+namespace {
+// Enough to coarsen a 64k texture down to 1x1
+constexpr int kMaxBias = 16;
+}  // namespace
+
+TextureStreamer::TextureStreamer(TextureLoader* loader, size_t budgetBytes, int tailSize)
+    : loader(loader), budgetBytes(budgetBytes) {
+  loader->setStreamingTail(tailSize);
+}
+
+float TextureStreamer::texcoordDensity(const Model* model) {
+  auto iter = densities.find(model);
+  if (iter != densities.end()) return iter->second;
+
+  double surfaceArea = 0.0, texcoordArea = 0.0;
+  if (model->drawMode == GL_TRIANGLES && !model->texcoords.empty()) {
+    size_t first = 0, count = model->numIndex > 0 ? model->numIndex : model->numVertex;
+    if (!model->lods.empty()) first = model->lods[0].firstIndex, count = model->lods[0].numIndex;
+    auto vertex = [&](size_t i) -> size_t { return model->numIndex > 0 ? model->indices[first + i] : first + i; };
+    auto position = [&](size_t v) {
+      return glm::vec3(model->positions[v * 3], model->positions[v * 3 + 1], model->positions[v * 3 + 2]);
+    };
+    auto texcoord = [&](size_t v) { return glm::vec2(model->texcoords[v * 2], model->texcoords[v * 2 + 1]); };
+    for (size_t i = 0; i + 2 < count; i += 3) {
+      size_t a = vertex(i), b = vertex(i + 1), c = vertex(i + 2);
+      surfaceArea += 0.5 * glm::length(glm::cross(position(b) - position(a), position(c) - position(a)));
+      glm::vec2 u = texcoord(b) - texcoord(a), v = texcoord(c) - texcoord(a);
+      texcoordArea += 0.5 * std::abs(u.x * v.y - u.y * v.x);
+    }
+  }
+  float density = surfaceArea > 0.0 ? (float)std::sqrt(texcoordArea / surfaceArea) : 0.0f;
+  densities[model] = density;
+  return density;
+}
+
+void TextureStreamer::request(GLuint texture, const Model* model, const glm::mat4& worldMatrix,
+                              const glm::vec3& cameraPosition, float projectionScale) {
+  const TextureLoader::StreamedTexture* streamed = loader->findStreamed(texture);
+  if (streamed == nullptr) return;
+  float density = texcoordDensity(model);
+  if (density <= 0.0f) return;
+
+  // Closest point of the bounding sphere, as in selectLod
+  glm::vec3 center = (model->boundsMin + model->boundsMax) * 0.5f;
+  float radius = glm::length(model->boundsMax - model->boundsMin) * 0.5f;
+  glm::vec3 worldCenter = glm::vec3(worldMatrix * glm::vec4(center, 1.0f));
+  float scale = std::max(std::max(glm::length(glm::vec3(worldMatrix[0])), glm::length(glm::vec3(worldMatrix[1]))),
+                         glm::length(glm::vec3(worldMatrix[2])));
+  float distance = std::max(glm::length(worldCenter - cameraPosition) - radius * scale, 1e-3f);
+
+  // Level 0 texels per pixel there, the screen space texcoord derivative of a
+  // surface facing the camera. Mip level n halves it n times.
+  float size = (float)std::max(streamed->view.header->width, streamed->view.header->height);
+  float texelsPerPixel = size * density * distance / (scale * projectionScale);
+  float level = std::log2(std::max(texelsPerPixel, 1e-6f));
+
+  Entry& entry = entries[texture];
+  if (entry.lastRequested != frame) {
+    entry.wantedLevel = level;
+    entry.lastRequested = frame;
+  } else {
+    entry.wantedLevel = std::min(entry.wantedLevel, level);
+  }
+}
+
+void TextureStreamer::update() {
+  // Ids only: streamOut reports the new size to the cache, which may evict a
+  // texture and with it the loader's StreamedTexture
+  struct Target {
+    GLuint id;
+    int level;
+    bool idle;
+  };
+  std::vector<Target> targets;
+  size_t residentBytes = 0;
+  for (auto iter = entries.begin(); iter != entries.end();) {
+    const TextureLoader::StreamedTexture* streamed = loader->findStreamed(iter->first);
+    // Evicted from the cache
+    if (streamed == nullptr) {
+      iter = entries.erase(iter);
+      continue;
+    }
+    const Entry& entry = iter->second;
+    bool idle = frame - entry.lastRequested > kIdleFrames;
+    // Round down, a level too sharp is better than a blurry one
+    int level = idle ? streamed->tailLevel : std::clamp((int)std::floor(entry.wantedLevel), 0, streamed->tailLevel);
+    targets.push_back(Target{iter->first, level, idle});
+    residentBytes += streamed->bytesFrom(streamed->baseLevel);
+    ++iter;
+  }
+
+  auto wantedBytes = [&](int levelBias) {
+    size_t bytes = 0;
+    for (const Target& target : targets) {
+      const TextureLoader::StreamedTexture* streamed = loader->findStreamed(target.id);
+      bytes += streamed->bytesFrom(std::min(target.level + levelBias, streamed->tailLevel));
+    }
+    return bytes;
+  };
+  bias = 0;
+  while (bias < kMaxBias && wantedBytes(bias) > budgetBytes) bias++;
+
+  bool overBudget = residentBytes > budgetBytes;
+  for (const Target& target : targets) {
+    const TextureLoader::StreamedTexture* streamed = loader->findStreamed(target.id);
+    if (streamed == nullptr) continue;
+    int level = std::min(target.level + bias, streamed->tailLevel);
+    int baseLevel = streamed->baseLevel;
+    if (level < baseLevel) {
+      loader->streamIn(target.id, level);
+    } else if (level > baseLevel + 1 || (level > baseLevel && (target.idle || overBudget))) {
+      // One level of slack keeps objects near a threshold from thrashing
+      loader->streamOut(target.id, level);
+    }
+  }
+
+  streamedBytes = 0;
+  for (const Target& target : targets) {
+    const TextureLoader::StreamedTexture* streamed = loader->findStreamed(target.id);
+    if (streamed != nullptr) streamedBytes += streamed->bytesFrom(streamed->baseLevel);
+  }
+  frame++;
+}
+
+void TextureStreamer::printReport() const {
+  std::cout << "Texture streamer: " << entries.size() << " textures, " << streamedBytes / 1024 << " KB of "
+            << budgetBytes / 1024 << " KB budget, level bias " << bias << std::endl;
+}
@@ -0,0 +1,165 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "model.h"
+
+namespace {
+struct FloatVertex {
+  float position[3];
+  float normal[3];
+  float texcoord[2];
+  float tangent[4];
+};
+static_assert(sizeof(FloatVertex) == 48, "FloatVertex must be tightly packed");
+
+struct QuantizedVertex {
+  // Fourth component is padding so the vertex stays 4-byte aligned
+  uint16_t position[4];
+  int16_t normal[2];
+  uint16_t texcoord[2];
+  // GL_INT_2_10_10_10_REV, w holds the bitangent sign
+  uint32_t tangent;
+};
+static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex must be tightly packed");
+
+int16_t toSnorm16(float v) { return (int16_t)std::lround(glm::clamp(v, -1.0f, 1.0f) * 32767.0f); }
+
+uint16_t toUnorm16(float v) { return (uint16_t)std::lround(glm::clamp(v, 0.0f, 1.0f) * 65535.0f); }
+
+// Signed normalized 10-10-10-2 in the bit order of GL_INT_2_10_10_10_REV
+uint32_t toSnorm1010102(const glm::vec4& v) {
+  auto field = [](float f, float range, uint32_t mask) {
+    return (uint32_t)(int32_t)std::lround(glm::clamp(f, -1.0f, 1.0f) * range) & mask;
+  };
+  return field(v.x, 511.0f, 0x3ff) | field(v.y, 511.0f, 0x3ff) << 10 | field(v.z, 511.0f, 0x3ff) << 20 |
+         field(v.w, 1.0f, 0x3) << 30;
+}
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2
+glm::vec2 octEncode(glm::vec3 n) {
+  n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  glm::vec2 e(n.x, n.y);
+  if (n.z < 0.0f) {
+    e = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                  (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+  }
+  return e;
+}
+
+glm::vec3 attribute3(const std::vector<float>& stream, int index, glm::vec3 fallback) {
+  if (stream.empty()) return fallback;
+  return glm::vec3(stream[index * 3], stream[index * 3 + 1], stream[index * 3 + 2]);
+}
+
+glm::vec2 attribute2(const std::vector<float>& stream, int index) {
+  if (stream.empty()) return glm::vec2(0.0f);
+  return glm::vec2(stream[index * 2], stream[index * 2 + 1]);
+}
+
+glm::vec4 attribute4(const std::vector<float>& stream, int index, glm::vec4 fallback) {
+  if (stream.empty()) return fallback;
+  return glm::vec4(stream[index * 4], stream[index * 4 + 1], stream[index * 4 + 2], stream[index * 4 + 3]);
+}
+}  // namespace
+
+GLsizei vertexStride(VertexFormat format) {
+  switch (format) {
+    case VertexFormat::Quantized:
+      return sizeof(QuantizedVertex);
+    case VertexFormat::Float:
+    default:
+      return sizeof(FloatVertex);
+  }
+}
+
+std::vector<unsigned char> packVertices(Model* model) {
+  std::vector<unsigned char> data(vertexStride(model->vertexFormat) * model->numVertex);
+  const glm::vec3 up(0.0f, 1.0f, 0.0f);
+  const glm::vec4 right(1.0f, 0.0f, 0.0f, 1.0f);
+
+  if (model->vertexFormat == VertexFormat::Float) {
+    model->positionScale = glm::vec3(1.0f);
+    model->positionOffset = glm::vec3(0.0f);
+    FloatVertex* vertices = reinterpret_cast<FloatVertex*>(data.data());
+    for (int i = 0; i < model->numVertex; i++) {
+      glm::vec3 p = attribute3(model->positions, i, glm::vec3(0.0f));
+      glm::vec3 n = attribute3(model->normals, i, up);
+      glm::vec2 t = attribute2(model->texcoords, i);
+      glm::vec4 tangent = attribute4(model->tangents, i, right);
+      vertices[i] =
+          FloatVertex{{p.x, p.y, p.z}, {n.x, n.y, n.z}, {t.x, t.y}, {tangent.x, tangent.y, tangent.z, tangent.w}};
+    }
+    return data;
+  }
+
+  // Positions are stored relative to the bounding box of the mesh
+  glm::vec3 minBound(0.0f), maxBound(0.0f);
+  for (int i = 0; i < model->numVertex; i++) {
+    glm::vec3 p = attribute3(model->positions, i, glm::vec3(0.0f));
+    minBound = i == 0 ? p : glm::min(minBound, p);
+    maxBound = i == 0 ? p : glm::max(maxBound, p);
+  }
+  glm::vec3 extent = maxBound - minBound;
+  for (int axis = 0; axis < 3; axis++) {
+    if (extent[axis] <= 0.0f) extent[axis] = 1.0f;
+  }
+  model->positionScale = extent;
+  model->positionOffset = minBound;
+
+  QuantizedVertex* vertices = reinterpret_cast<QuantizedVertex*>(data.data());
+  for (int i = 0; i < model->numVertex; i++) {
+    glm::vec3 p = attribute3(model->positions, i, glm::vec3(0.0f));
+    glm::vec3 n = attribute3(model->normals, i, up);
+    glm::vec2 t = attribute2(model->texcoords, i);
+    glm::vec3 unit = (p - minBound) / extent;
+    glm::vec2 oct = octEncode(n);
+    QuantizedVertex& v = vertices[i];
+    v.position[0] = toUnorm16(unit.x);
+    v.position[1] = toUnorm16(unit.y);
+    v.position[2] = toUnorm16(unit.z);
+    v.position[3] = 0;
+    v.normal[0] = toSnorm16(oct.x);
+    v.normal[1] = toSnorm16(oct.y);
+    v.texcoord[0] = glm::packHalf1x16(t.x);
+    v.texcoord[1] = glm::packHalf1x16(t.y);
+    v.tangent = toSnorm1010102(attribute4(model->tangents, i, right));
+  }
+  return data;
+}
+
+void setupVertexAttributes(VertexFormat format, size_t offset) {
+  GLsizei stride = vertexStride(format);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+  glEnableVertexAttribArray(3);
+  if (format == VertexFormat::Quantized) {
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          (void*)(offset + offsetof(QuantizedVertex, position)));
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)(offset + offsetof(QuantizedVertex, normal)));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                          (void*)(offset + offsetof(QuantizedVertex, texcoord)));
+    glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride,
+                          (void*)(offset + offsetof(QuantizedVertex, tangent)));
+  } else {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(FloatVertex, position)));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(FloatVertex, normal)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(FloatVertex, texcoord)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(FloatVertex, tangent)));
+  }
+}
+
+void setDequantizeUniforms(const DequantizeUniforms& uniforms, const Model* model) {
+  glUniform3fv(uniforms.positionScale, 1, glm::value_ptr(model->positionScale));
+  glUniform3fv(uniforms.positionOffset, 1, glm::value_ptr(model->positionOffset));
+  glUniform1i(uniforms.octNormals, model->vertexFormat == VertexFormat::Quantized);
+}
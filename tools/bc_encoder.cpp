@@ -0,0 +1,140 @@
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+uint16_t packRGB565(const float color[3]) {
+  int r = (int)std::lround(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f);
+  int g = (int)std::lround(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f);
+  int b = (int)std::lround(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f);
+  return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+void unpackRGB565(uint16_t packed, float color[3]) {
+  color[0] = (float)((packed >> 11) & 31) * 255.0f / 31.0f;
+  color[1] = (float)((packed >> 5) & 63) * 255.0f / 63.0f;
+  color[2] = (float)(packed & 31) * 255.0f / 31.0f;
+}
+
+float distanceSquared(const float a[3], const uint8_t b[4]) {
+  float dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+  return dr * dr + dg * dg + db * db;
+}
+
+// Range fit: project the pixels on their principal axis and use the extremes
+// (inset by 1/16 of the range, which lowers the average error) as endpoints
+void encodeColorBlock(const uint8_t pixels[64], uint8_t block[8]) {
+  float mean[3] = {0, 0, 0};
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 3; c++) mean[c] += pixels[i * 4 + c] / 16.0f;
+  }
+  float covariance[6] = {0, 0, 0, 0, 0, 0};
+  for (int i = 0; i < 16; i++) {
+    float d[3] = {pixels[i * 4] - mean[0], pixels[i * 4 + 1] - mean[1], pixels[i * 4 + 2] - mean[2]};
+    covariance[0] += d[0] * d[0], covariance[1] += d[0] * d[1], covariance[2] += d[0] * d[2];
+    covariance[3] += d[1] * d[1], covariance[4] += d[1] * d[2], covariance[5] += d[2] * d[2];
+  }
+  // Power iteration for the dominant eigenvector, seeded with the covariance
+  // column of the channel that varies most; (1, 1, 1) fails on anti-correlated channels
+  const int column[3][3] = {{0, 1, 2}, {1, 3, 4}, {2, 4, 5}};
+  int seed = 0;
+  for (int c = 1; c < 3; c++) {
+    if (covariance[column[c][c]] > covariance[column[seed][seed]]) seed = c;
+  }
+  float axis[3] = {covariance[column[seed][0]], covariance[column[seed][1]], covariance[column[seed][2]]};
+  if (covariance[column[seed][seed]] < 1e-6f) axis[0] = axis[1] = axis[2] = 1;
+  for (int iteration = 0; iteration < 8; iteration++) {
+    float next[3] = {covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                     covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                     covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+    if (length < 1e-6f) break;
+    for (int c = 0; c < 3; c++) axis[c] = next[c] / length;
+  }
+
+  float minProjection = 1e9f, maxProjection = -1e9f;
+  for (int i = 0; i < 16; i++) {
+    float projection = 0;
+    for (int c = 0; c < 3; c++) projection += (pixels[i * 4 + c] - mean[c]) * axis[c];
+    minProjection = std::min(minProjection, projection);
+    maxProjection = std::max(maxProjection, projection);
+  }
+  float inset = (maxProjection - minProjection) / 16.0f;
+  float high[3], low[3];
+  for (int c = 0; c < 3; c++) {
+    high[c] = mean[c] + axis[c] * (maxProjection - inset);
+    low[c] = mean[c] + axis[c] * (minProjection + inset);
+  }
+
+  uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+  // color0 > color1 selects the four color mode
+  if (color0 < color1) std::swap(color0, color1);
+  float palette[4][3];
+  unpackRGB565(color0, palette[0]);
+  unpackRGB565(color1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+    palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+  }
+
+  uint32_t indices = 0;
+  if (color0 != color1) {
+    for (int i = 0; i < 16; i++) {
+      int best = 0;
+      float bestDistance = distanceSquared(palette[0], &pixels[i * 4]);
+      for (int p = 1; p < 4; p++) {
+        float distance = distanceSquared(palette[p], &pixels[i * 4]);
+        if (distance < bestDistance) best = p, bestDistance = distance;
+      }
+      indices |= (uint32_t)best << (i * 2);
+    }
+  }
+  block[0] = color0 & 0xff, block[1] = color0 >> 8;
+  block[2] = color1 & 0xff, block[3] = color1 >> 8;
+  std::memcpy(block + 4, &indices, 4);
+}
+
+// BC4: two 8-bit endpoints and 3-bit indices into the 8 value ramp
+void encodeChannelBlock(const uint8_t pixels[64], int channel, uint8_t block[8]) {
+  int minValue = 255, maxValue = 0;
+  for (int i = 0; i < 16; i++) {
+    minValue = std::min(minValue, (int)pixels[i * 4 + channel]);
+    maxValue = std::max(maxValue, (int)pixels[i * 4 + channel]);
+  }
+  // endpoint0 > endpoint1 selects the eight value mode
+  block[0] = (uint8_t)maxValue;
+  block[1] = (uint8_t)minValue;
+
+  uint64_t indices = 0;
+  if (maxValue > minValue) {
+    float ramp[8];
+    ramp[0] = (float)maxValue;
+    ramp[1] = (float)minValue;
+    for (int k = 1; k < 7; k++) ramp[k + 1] = ((7 - k) * maxValue + k * minValue) / 7.0f;
+    for (int i = 0; i < 16; i++) {
+      int best = 0;
+      float bestDistance = std::abs(ramp[0] - pixels[i * 4 + channel]);
+      for (int k = 1; k < 8; k++) {
+        float distance = std::abs(ramp[k] - pixels[i * 4 + channel]);
+        if (distance < bestDistance) best = k, bestDistance = distance;
+      }
+      indices |= (uint64_t)best << (i * 3);
+    }
+  }
+  for (int b = 0; b < 6; b++) block[2 + b] = (uint8_t)(indices >> (b * 8));
+}
+}  // namespace
+
+void encodeBC1(const uint8_t pixels[64], uint8_t block[8]) { encodeColorBlock(pixels, block); }
+
+void encodeBC3(const uint8_t pixels[64], uint8_t block[16]) {
+  encodeChannelBlock(pixels, 3, block);
+  encodeColorBlock(pixels, block + 8);
+}
+
+void encodeBC5(const uint8_t pixels[64], uint8_t block[16]) {
+  encodeChannelBlock(pixels, 0, block);
+  encodeChannelBlock(pixels, 1, block + 8);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+// Block compressors used by texconv. Every function encodes one 4x4 block of
+// RGBA8 pixels (64 bytes, row major) into `block`.
+
+// BC1 / DXT1: RGB endpoints in 5:6:5 and 2-bit indices, 8 bytes
+void encodeBC1(const uint8_t pixels[64], uint8_t block[8]);
+// BC3 / DXT5: BC4 alpha followed by a BC1 color block, 16 bytes
+void encodeBC3(const uint8_t pixels[64], uint8_t block[16]);
+// BC5 / RGTC2: red and green as two BC4 blocks, 16 bytes
+void encodeBC5(const uint8_t pixels[64], uint8_t block[16]);
@@ -0,0 +1,191 @@
+// Offline converter from JPEG / PNG to the texture file format read by
+// TextureLoader (see texture_container.h): builds the full mip chain and
+// optionally block compresses every level.
+//
+// Usage: texconv [options] input output.tex
+//   --format auto|bc1|bc3|bc5|rgba8|rgb8   default auto: bc5 for normal maps,
+//                                          bc3 with alpha, bc1 otherwise
+//   --linear / --srgb                      color space, default sRGB except normal maps
+//   --no-mips                              only store level 0
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "bc_encoder.h"
+#include "texture_container.h"
+
+namespace {
+struct Image {
+  int width = 0, height = 0;
+  // Always RGBA8
+  std::vector<uint8_t> pixels;
+};
+
+float srgbToLinear(float c) { return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f); }
+
+float linearToSrgb(float c) { return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f; }
+
+// 2x2 box filter; sRGB colors are averaged in linear space so mips do not darken
+Image downsample(const Image& source, bool srgb) {
+  Image result;
+  result.width = std::max(1, source.width / 2);
+  result.height = std::max(1, source.height / 2);
+  result.pixels.resize((size_t)result.width * result.height * 4);
+  for (int y = 0; y < result.height; y++) {
+    for (int x = 0; x < result.width; x++) {
+      for (int c = 0; c < 4; c++) {
+        float sum = 0;
+        for (int dy = 0; dy < 2; dy++) {
+          for (int dx = 0; dx < 2; dx++) {
+            int sx = std::min(x * 2 + dx, source.width - 1), sy = std::min(y * 2 + dy, source.height - 1);
+            float value = source.pixels[((size_t)sy * source.width + sx) * 4 + c] / 255.0f;
+            sum += srgb && c < 3 ? srgbToLinear(value) : value;
+          }
+        }
+        float average = sum / 4.0f;
+        if (srgb && c < 3) average = linearToSrgb(average);
+        result.pixels[((size_t)y * result.width + x) * 4 + c] = (uint8_t)std::lround(average * 255.0f);
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<unsigned char> encodeLevel(const Image& image, TextureFileFormat format) {
+  std::vector<unsigned char> data(textureLevelSize(format, image.width, image.height));
+  if (!isCompressed(format)) {
+    int channels = format == TextureFileFormat::RGB8 ? 3 : 4;
+    for (size_t i = 0; i < (size_t)image.width * image.height; i++) {
+      std::memcpy(&data[i * channels], &image.pixels[i * 4], channels);
+    }
+    return data;
+  }
+
+  size_t blockSize = format == TextureFileFormat::BC1 ? 8 : 16;
+  int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+  for (int by = 0; by < blocksY; by++) {
+    for (int bx = 0; bx < blocksX; bx++) {
+      // Edge blocks repeat the last row / column
+      uint8_t block[64];
+      for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+          int sx = std::min(bx * 4 + x, image.width - 1), sy = std::min(by * 4 + y, image.height - 1);
+          std::memcpy(&block[(y * 4 + x) * 4], &image.pixels[((size_t)sy * image.width + sx) * 4], 4);
+        }
+      }
+      unsigned char* out = &data[((size_t)by * blocksX + bx) * blockSize];
+      if (format == TextureFileFormat::BC1) {
+        encodeBC1(block, out);
+      } else if (format == TextureFileFormat::BC3) {
+        encodeBC3(block, out);
+      } else {
+        encodeBC5(block, out);
+      }
+    }
+  }
+  return data;
+}
+
+std::string lowercase(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+  return text;
+}
+
+void printUsage() {
+  std::cout << "Usage: texconv [--format auto|bc1|bc3|bc5|rgba8|rgb8] [--linear|--srgb] [--no-mips] input output.tex"
+            << std::endl;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string formatName = "auto", input, output;
+  int colorSpace = -1;  // -1 auto, 0 linear, 1 sRGB
+  bool mips = true;
+  for (int i = 1; i < argc; i++) {
+    std::string argument = argv[i];
+    if (argument == "--format" && i + 1 < argc) {
+      formatName = lowercase(argv[++i]);
+    } else if (argument == "--linear") {
+      colorSpace = 0;
+    } else if (argument == "--srgb") {
+      colorSpace = 1;
+    } else if (argument == "--no-mips") {
+      mips = false;
+    } else if (input.empty()) {
+      input = argument;
+    } else if (output.empty()) {
+      output = argument;
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (input.empty() || output.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  // Same orientation as the runtime loader, which flips on load
+  stbi_set_flip_vertically_on_load(true);
+  int channels;
+  Image image;
+  uint8_t* pixels = stbi_load(input.c_str(), &image.width, &image.height, &channels, 4);
+  if (!pixels) {
+    std::cout << "Failed to load " << input << ": " << stbi_failure_reason() << std::endl;
+    return 1;
+  }
+  image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+  stbi_image_free(pixels);
+
+  bool normalMap = lowercase(input).find("normal") != std::string::npos;
+  bool hasAlpha = false;
+  for (size_t i = 0; i < (size_t)image.width * image.height && channels == 4; i++) {
+    hasAlpha |= image.pixels[i * 4 + 3] < 255;
+  }
+
+  TextureFileFormat format;
+  if (formatName == "bc1") {
+    format = TextureFileFormat::BC1;
+  } else if (formatName == "bc3") {
+    format = TextureFileFormat::BC3;
+  } else if (formatName == "bc5") {
+    format = TextureFileFormat::BC5;
+  } else if (formatName == "rgba8") {
+    format = TextureFileFormat::RGBA8;
+  } else if (formatName == "rgb8") {
+    format = TextureFileFormat::RGB8;
+  } else if (formatName == "auto") {
+    format = normalMap ? TextureFileFormat::BC5 : hasAlpha ? TextureFileFormat::BC3 : TextureFileFormat::BC1;
+  } else {
+    printUsage();
+    return 1;
+  }
+  bool srgb = colorSpace == -1 ? !normalMap && format != TextureFileFormat::BC5 : colorSpace == 1;
+
+  int width = image.width, height = image.height;
+  std::vector<std::vector<unsigned char>> levels;
+  size_t totalBytes = 0;
+  while (true) {
+    levels.push_back(encodeLevel(image, format));
+    totalBytes += levels.back().size();
+    if (!mips || (image.width == 1 && image.height == 1)) break;
+    image = downsample(image, srgb);
+  }
+  if (!writeTextureFile(output, format, srgb ? kTextureFileSrgb : 0, width, height, levels)) return 1;
+
+  const char* formatNames[] = {"R8", "RG8", "RGB8", "RGBA8", "BC1", "BC3", "BC5"};
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  std::cout << input << " -> " << output << ": " << width << "x" << height << " " << formatNames[(int)format]
+            << (srgb ? " sRGB" : " linear") << ", " << levels.size() << " levels, " << totalBytes / 1024 << " KB in "
+            << seconds << " s" << std::endl;
+  return 0;
+}